@@ -0,0 +1,419 @@
+/*
+ * bench_execution_tracer.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ * Host micro-benchmarks of the trace hot path. Each executable is built for
+ * one configuration (see bench/CMakeLists.txt) and appends one JSON object
+ * per measurement to the results file given on the command line, or to
+ * stdout.
+ *
+ * Instruction counts come from the Linux perf_event_open() interface. Where
+ * it isn't available (other hosts, containers, perf_event_paranoid) they are
+ * reported as null and only the time is measured.
+ */
+
+#define _GNU_SOURCE
+
+/* Include files ----------------------------------------------------------- */
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "execution_tracer.h"
+
+/* Private macros ---------------------------------------------------------- */
+#if DUMP_FORMAT == DUMP_FORMAT_RAW_BINARY
+#define DUMP_FORMAT_NAME        "RAW_BINARY"
+#elif DUMP_FORMAT == DUMP_FORMAT_BASE64_TEXT
+#define DUMP_FORMAT_NAME        "BASE64_TEXT"
+#else
+#define DUMP_FORMAT_NAME        "HEX_TEXT"
+#endif
+
+/* Ops per measurement. Puts and gets are timed a buffer's worth at a time, so
+ * this is rounded to a multiple of BUFFER_MAX_CAPACITY. */
+#define NUM_OPS                 (1U << 20)
+#define NUM_DUMPS               (1U << 10)
+#define MAX_PRODUCERS           4
+
+#define BENCH_VALUE             0x00ABCDEF
+
+/* Private types ----------------------------------------------------------- */
+typedef struct {
+    uint64_t    ns;
+    uint64_t    instructions;
+    bool        have_instructions;
+} Sample_t;
+
+typedef struct {
+    int         fd;
+} Counter_t;
+
+typedef struct {
+    pthread_t   thread;
+    uint32_t    num_ops;
+    Sample_t    sample;
+} Producer_t;
+
+/* Private variables ------------------------------------------------------- */
+static FILE *           m_results;
+static atomic_int       m_producers_ready;
+static atomic_bool      m_start;
+static atomic_int       m_producers_running;
+
+/* Private functions ------------------------------------------------------- */
+static void bench_Function(void)
+{
+}
+
+static void null_write(uint8_t * p_data, uint16_t size)
+{
+    (void)p_data;
+    (void)size;
+}
+
+static ExecTraceCallbacks_t m_callbacks = {
+        .write = null_write,
+        .lock = NULL,
+        .unlock = NULL
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/* Counts user-space instructions retired by the calling thread */
+static void counter_Open(Counter_t * p_counter)
+{
+    p_counter->fd = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    p_counter->fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static void counter_Close(Counter_t * p_counter)
+{
+#ifdef __linux__
+    if (p_counter->fd >= 0)
+    {
+        close(p_counter->fd);
+    }
+#endif
+}
+
+static void sample_Start(Counter_t * p_counter, uint64_t * p_start_ns)
+{
+#ifdef __linux__
+    if (p_counter->fd >= 0)
+    {
+        ioctl(p_counter->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    *p_start_ns = now_ns();
+}
+
+static void sample_Stop(Counter_t * p_counter, uint64_t start_ns, Sample_t * p_sample)
+{
+    p_sample->ns += now_ns() - start_ns;
+#ifdef __linux__
+    if (p_counter->fd >= 0)
+    {
+        uint64_t count;
+        ioctl(p_counter->fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(p_counter->fd, &count, sizeof(count)) == sizeof(count))
+        {
+            /* The counter isn't reset, so this is the running total */
+            p_sample->instructions = count;
+            p_sample->have_instructions = true;
+        }
+    }
+#endif
+}
+
+static void report(const char * p_benchmark, int num_producers, uint64_t num_ops,
+        const Sample_t * p_sample)
+{
+    fprintf(m_results,
+            "{\"benchmark\": \"%s\", \"allow_overwrite\": %d, \"buffer_length\": %d, "
+            "\"dump_format\": \"%s\", \"runtime_filter\": %d, \"producers\": %d, \"ops\": %" PRIu64 ", "
+            "\"ns_per_op\": %.3f, \"instructions_per_op\": ",
+            p_benchmark, ALLOW_OVERWRITE, BUFFER_LENGTH_IN_WORDS,
+            DUMP_FORMAT_NAME, RUNTIME_FILTER,
+            num_producers, num_ops, (double)p_sample->ns / (double)num_ops);
+    if (p_sample->have_instructions)
+    {
+        fprintf(m_results, "%.3f}\n", (double)p_sample->instructions / (double)num_ops);
+    }
+    else
+    {
+        fprintf(m_results, "null}\n");
+    }
+}
+
+/* Single producer ---------------------------------------------------------- */
+/* Puts are timed into an empty buffer, a buffer's worth at a time, so they
+ * measure a successful put whatever the overwrite setting. The full-buffer
+ * path (dropping or overwriting) is measured separately. */
+#define BENCH_PUTS_INTO_EMPTY_BUFFER(name, put)                                 \
+static void name(void)                                                          \
+{                                                                               \
+    Sample_t sample = {0};                                                      \
+    Counter_t counter;                                                          \
+    uint64_t start;                                                             \
+    uint32_t num_ops = 0;                                                       \
+                                                                                \
+    counter_Open(&counter);                                                     \
+    while (num_ops < NUM_OPS)                                                   \
+    {                                                                           \
+        TRACE_Clear();                                                          \
+        sample_Start(&counter, &start);                                         \
+        for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY; i++)                      \
+        {                                                                       \
+            put;                                                                \
+        }                                                                       \
+        sample_Stop(&counter, start, &sample);                                  \
+        num_ops += BUFFER_MAX_CAPACITY;                                         \
+    }                                                                           \
+    counter_Close(&counter);                                                    \
+    report(#name + sizeof("bench_") - 1, 1, num_ops, &sample);                  \
+}
+
+BENCH_PUTS_INTO_EMPTY_BUFFER(bench_put, TRACE_Put(BENCH_VALUE))
+BENCH_PUTS_INTO_EMPTY_BUFFER(bench_function_entry, TRACE_FunctionEntry(bench_Function))
+BENCH_PUTS_INTO_EMPTY_BUFFER(bench_instrumented_entry, __cyg_profile_func_enter((void *)bench_Function, NULL))
+
+#if RUNTIME_FILTER
+/* The cost of a trace point whose ID code is disabled */
+static void bench_function_entry_filtered(void)
+{
+    Sample_t sample = {0};
+    Counter_t counter;
+    uint64_t start;
+
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL & ~(1 << TRACE_IDCODE_FUNC_ENTRY));
+    TRACE_Clear();
+    counter_Open(&counter);
+    sample_Start(&counter, &start);
+    for (uint32_t i = 0; i < NUM_OPS; i++)
+    {
+        TRACE_FunctionEntry(bench_Function);
+    }
+    sample_Stop(&counter, start, &sample);
+    counter_Close(&counter);
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL);
+    if (!TRACE_IsEmpty())
+    {
+        fprintf(stderr, "function_entry_filtered: disabled entries were traced\n");
+    }
+    report("function_entry_filtered", 1, NUM_OPS, &sample);
+}
+#endif
+
+static void bench_put_full(void)
+{
+    Sample_t sample = {0};
+    Counter_t counter;
+    uint64_t start;
+
+    TRACE_Clear();
+    for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY; i++)
+    {
+        TRACE_Put(BENCH_VALUE);
+    }
+
+    counter_Open(&counter);
+    sample_Start(&counter, &start);
+    for (uint32_t i = 0; i < NUM_OPS; i++)
+    {
+        TRACE_Put(BENCH_VALUE);
+    }
+    sample_Stop(&counter, start, &sample);
+    counter_Close(&counter);
+    report("put_full", 1, NUM_OPS, &sample);
+}
+
+static void bench_get(void)
+{
+    Sample_t sample = {0};
+    Counter_t counter;
+    uint64_t start;
+    uint32_t num_ops = 0;
+    uint32_t sum = 0;
+
+    counter_Open(&counter);
+    while (num_ops < NUM_OPS)
+    {
+        TRACE_Clear();
+        for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY; i++)
+        {
+            TRACE_Put(BENCH_VALUE);
+        }
+        sample_Start(&counter, &start);
+        for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY; i++)
+        {
+            sum += TRACE_Get();
+        }
+        sample_Stop(&counter, start, &sample);
+        num_ops += BUFFER_MAX_CAPACITY;
+    }
+    counter_Close(&counter);
+    if (sum != num_ops * BENCH_VALUE)
+    {
+        fprintf(stderr, "get: unexpected values read\n");
+        exit(EXIT_FAILURE);
+    }
+    report("get", 1, num_ops, &sample);
+}
+
+/* Reported per dumped entry, not per call */
+static void bench_dump(void)
+{
+    Sample_t sample = {0};
+    Counter_t counter;
+    uint64_t start;
+
+    counter_Open(&counter);
+    for (uint32_t n = 0; n < NUM_DUMPS; n++)
+    {
+        TRACE_Clear();
+        for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY; i++)
+        {
+            TRACE_Put(BENCH_VALUE);
+        }
+        sample_Start(&counter, &start);
+        DumpExecTraceLog();
+        sample_Stop(&counter, start, &sample);
+    }
+    counter_Close(&counter);
+    report("dump", 1, (uint64_t)NUM_DUMPS * BUFFER_MAX_CAPACITY, &sample);
+}
+
+/* Contended producers ------------------------------------------------------ */
+/* Producers put as fast as they can while this thread drains the buffer, as
+ * a background dump would. Without overwrite, puts into a full buffer are
+ * dropped, so the mix of stored and dropped puts depends on how well the
+ * consumer keeps up. */
+static void * producer_thread(void * arg)
+{
+    Producer_t * p_producer = (Producer_t *)arg;
+    Counter_t counter;
+    uint64_t start;
+
+    counter_Open(&counter);
+    atomic_fetch_add(&m_producers_ready, 1);
+    while (!atomic_load(&m_start))
+    {
+    }
+
+    sample_Start(&counter, &start);
+    for (uint32_t i = 0; i < p_producer->num_ops; i++)
+    {
+        TRACE_Put(BENCH_VALUE);
+    }
+    sample_Stop(&counter, start, &p_producer->sample);
+
+    counter_Close(&counter);
+    atomic_fetch_sub(&m_producers_running, 1);
+    return NULL;
+}
+
+static void bench_put_contended(int num_producers)
+{
+    Producer_t producers[MAX_PRODUCERS];
+    Sample_t total = {0};
+    uint32_t ops_per_producer = NUM_OPS / (uint32_t)num_producers;
+
+    TRACE_Clear();
+    atomic_store(&m_producers_ready, 0);
+    atomic_store(&m_start, false);
+    atomic_store(&m_producers_running, num_producers);
+    for (int i = 0; i < num_producers; i++)
+    {
+        memset(&producers[i], 0, sizeof(producers[i]));
+        producers[i].num_ops = ops_per_producer;
+        if (pthread_create(&producers[i].thread, NULL, producer_thread, &producers[i]) != 0)
+        {
+            fprintf(stderr, "put_contended: pthread_create failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    while (atomic_load(&m_producers_ready) < num_producers)
+    {
+    }
+    atomic_store(&m_start, true);
+
+    while (atomic_load(&m_producers_running) > 0)
+    {
+        (void)TRACE_Get();
+    }
+
+    /* Average cost of one put as seen by the producer that made it */
+    total.have_instructions = true;
+    for (int i = 0; i < num_producers; i++)
+    {
+        pthread_join(producers[i].thread, NULL);
+        total.ns += producers[i].sample.ns;
+        total.instructions += producers[i].sample.instructions;
+        total.have_instructions &= producers[i].sample.have_instructions;
+    }
+    report("put_contended", num_producers, (uint64_t)ops_per_producer * num_producers, &total);
+}
+
+/* Public functions --------------------------------------------------------- */
+int main(int argc, char * argv[])
+{
+    m_results = stdout;
+    if (argc > 1)
+    {
+        m_results = fopen(argv[1], "a");
+        if (m_results == NULL)
+        {
+            perror(argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    TRACE_Init(&m_callbacks);
+
+    bench_put();
+    bench_function_entry();
+    bench_instrumented_entry();
+#if RUNTIME_FILTER
+    bench_function_entry_filtered();
+#endif
+    bench_put_full();
+    bench_get();
+    bench_dump();
+    for (int num_producers = 2; num_producers <= MAX_PRODUCERS; num_producers *= 2)
+    {
+        bench_put_contended(num_producers);
+    }
+
+    if (m_results != stdout)
+    {
+        fclose(m_results);
+    }
+    return EXIT_SUCCESS;
+}
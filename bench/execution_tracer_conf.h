@@ -0,0 +1,29 @@
+/*
+ * execution_tracer_conf.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BENCH_EXECUTION_TRACER_CONF_H_
+#define BENCH_EXECUTION_TRACER_CONF_H_
+
+/* All BENCH_ settings come from bench/CMakeLists.txt, one set per benchmark
+ * executable. Everything else is fixed to the library defaults. */
+
+#define FLASH_BASE                      0
+#define RAM_BASE                        0
+#define SFR_BASE                        0
+
+#define STOP_TRACING_AFTER_RESET        0
+#define USE_NOINIT_RAM_FOR_TRACING      0
+#define ALLOW_OVERWRITE                 BENCH_ALLOW_OVERWRITE
+#define BUFFER_LENGTH_IN_WORDS          BENCH_BUFFER_LENGTH
+#define DUMP_FORMAT                     BENCH_DUMP_FORMAT
+#define COMPACT_ENCODING                0
+#define USE_TIMESTAMPS                  0
+#define TIMESTAMP_SYNC_INTERVAL         16
+/* The -finstrument-functions hooks are benchmarked by calling them directly */
+#define INSTRUMENT_FUNCTIONS            1
+#define RUNTIME_FILTER                  BENCH_RUNTIME_FILTER
+
+#endif /* BENCH_EXECUTION_TRACER_CONF_H_ */
@@ -10,75 +10,313 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include "execution_tracer_conf.h"
 #include "execution_tracer_protocol.h"
 
+/*
+ * The trace buffer is made of slots. Each slot holds one word, or with
+ * COMPACT_ENCODING, one halfword. head, tail, reserve and the masks below
+ * all count slots.
+ */
+#if COMPACT_ENCODING
+#define BUFFER_SLOTS_PER_WORD   2
+typedef uint16_t TraceSlot_t;
+#else
+#define BUFFER_SLOTS_PER_WORD   1
+typedef uint32_t TraceSlot_t;
+#endif
+
 /* Check whether BUFFER_LENGTH_IN_WORDS is a power of 2 is in .c file */
-#define BUFFER_INDEX_MASK       (BUFFER_LENGTH_IN_WORDS - 1)
-#define BUFFER_MAX_CAPACITY     (BUFFER_LENGTH_IN_WORDS - 1)
+#define BUFFER_LENGTH_IN_SLOTS  (BUFFER_LENGTH_IN_WORDS * BUFFER_SLOTS_PER_WORD)
+#define BUFFER_INDEX_MASK       (BUFFER_LENGTH_IN_SLOTS - 1)
+#define BUFFER_MAX_CAPACITY     (BUFFER_LENGTH_IN_SLOTS - 1)
+#define BUFFER_COMMIT_FLAG_WORDS    ((BUFFER_LENGTH_IN_SLOTS + 31) / 32)
+
+/*
+ * Marks m_exec_trace as initialized, so that with USE_NOINIT_RAM_FOR_TRACING
+ * its contents are kept through a reset. The magic encodes the layout of
+ * ExecTracer_t, so that a block left in noinit RAM by a build with another
+ * layout or configuration is cleared rather than misread. Bump
+ * EXEC_TRACE_LAYOUT_VERSION whenever ExecTracer_t changes.
+ */
+#define EXEC_TRACE_LAYOUT_VERSION   3
+#define EXEC_TRACE_INIT_MAGIC                                                   \
+    (0x5A000000UL | ((uint32_t)EXEC_TRACE_LAYOUT_VERSION << 20) |               \
+    ((uint32_t)BUFFER_SLOTS_PER_WORD << 16) |                                   \
+    (((uint32_t)sizeof(ExecTracer_t) / sizeof(uint32_t)) & 0xFFFF))
+
+/*
+ * TRACE_Put() relies on compare-and-swap to claim buffer slots from any
+ * context. On Arm this means LDREX/STREX (ARMv7-M and later).
+ * Cores without exclusive access instructions (e.g. Cortex-M0 and M0+) only
+ * have atomic loads and stores. There, each read-modify-write of the put
+ * path is a load and a store between TRACE_ENTER_CRITICAL() and
+ * TRACE_EXIT_CRITICAL(), which the client may define in
+ * execution_tracer_conf.h. Without them, tracing is NOT ISR-safe: only one
+ * context at a time may trace, call TRACE_Get() or dump the log.
+ */
+#ifndef TRACE_LOCK_FREE
+#define TRACE_LOCK_FREE         (ATOMIC_INT_LOCK_FREE == 2)
+#endif
+#ifndef TRACE_ENTER_CRITICAL
+#define TRACE_ENTER_CRITICAL()
+#define TRACE_EXIT_CRITICAL()
+#endif
+
+/*
+ * Test hook that lets host stress tests force a context switch at the points
+ * in the put path where preemption is most likely to expose a race.
+ * Leave undefined on target builds.
+ */
+#ifndef TRACE_PREEMPTION_POINT
+#define TRACE_PREEMPTION_POINT()
+#endif
+
+/*
+ * Keeps a function out of -finstrument-functions instrumentation. The put
+ * path below is marked with it so that TRACE_ macros in instrumented modules
+ * don't trace the tracer, and so that the hooks don't recurse.
+ */
+#if defined(__GNUC__)
+#define TRACE_NO_INSTRUMENT     __attribute__((no_instrument_function))
+#else
+#define TRACE_NO_INSTRUMENT
+#endif
+
+/*
+ * Read-modify-write operations on the tracer's atomic variables. They are
+ * sequentially consistent, like the stdatomic.h functions they stand for.
+ */
+#if TRACE_LOCK_FREE
+#define _TRACE_CAS_WEAK(p_obj, p_expected, desired)                             \
+    atomic_compare_exchange_weak((p_obj), (p_expected), (desired))
+#define _TRACE_CAS_STRONG(p_obj, p_expected, desired)                           \
+    atomic_compare_exchange_strong((p_obj), (p_expected), (desired))
+#define _TRACE_EXCHANGE(p_obj, value)       atomic_exchange((p_obj), (value))
+#define _TRACE_FETCH_ADD(p_obj, value)      atomic_fetch_add((p_obj), (value))
+#define _TRACE_FETCH_AND(p_obj, value)      atomic_fetch_and((p_obj), (value))
+#define _TRACE_FETCH_OR(p_obj, value)       atomic_fetch_or((p_obj), (value))
+#else
+#define _TRACE_CAS_WEAK(p_obj, p_expected, desired)                             \
+    _TRACE_CompareExchange((p_obj), (p_expected), (desired))
+#define _TRACE_CAS_STRONG(p_obj, p_expected, desired)                           \
+    _TRACE_CompareExchange((p_obj), (p_expected), (desired))
+#define _TRACE_EXCHANGE(p_obj, value)       _TRACE_FetchOp((p_obj), 0, (value))
+#define _TRACE_FETCH_ADD(p_obj, value)      _TRACE_FetchOp((p_obj), 1, (value))
+#define _TRACE_FETCH_AND(p_obj, value)      _TRACE_FetchOp((p_obj), 2, (value))
+#define _TRACE_FETCH_OR(p_obj, value)       _TRACE_FetchOp((p_obj), 3, (value))
+
+TRACE_NO_INSTRUMENT static inline bool _TRACE_CompareExchange(
+        volatile _Atomic uint32_t * p_obj, uint32_t * p_expected, uint32_t desired)
+{
+    uint32_t value;
+    bool exchanged;
+
+    TRACE_ENTER_CRITICAL();
+    value = atomic_load(p_obj);
+    exchanged = (value == *p_expected);
+    if (exchanged)
+    {
+        atomic_store(p_obj, desired);
+    }
+    TRACE_EXIT_CRITICAL();
+    *p_expected = value;
+    return exchanged;
+}
+
+/* op is a constant, so when inlined only one case is left */
+TRACE_NO_INSTRUMENT static inline uint32_t _TRACE_FetchOp(
+        volatile _Atomic uint32_t * p_obj, int op, uint32_t operand)
+{
+    uint32_t value;
+
+    TRACE_ENTER_CRITICAL();
+    value = atomic_load(p_obj);
+    atomic_store(p_obj, (op == 0) ? operand :
+                        (op == 1) ? (value + operand) :
+                        (op == 2) ? (value & operand) : (value | operand));
+    TRACE_EXIT_CRITICAL();
+    return value;
+}
+#endif
+
+/**
+ * Output formats for DumpExecTraceLog(). Select one with DUMP_FORMAT in
+ * execution_tracer_conf.h.
+ */
+#define DUMP_FORMAT_HEX_TEXT    0
+#define DUMP_FORMAT_RAW_BINARY  1
+#define DUMP_FORMAT_FRAMED      2
+#define DUMP_FORMAT_BASE64_TEXT 3
+
+/**
+ * Pass to DumpExecTraceLogBounded() to dump without an entry count limit.
+ */
+#define DUMP_NO_LIMIT           UINT32_MAX
+
+/**
+ * Trace levels for compiling trace points out. Select one with TRACE_LEVEL in
+ * execution_tracer_conf.h. Each level includes the ones above it.
+ * - TRACE_LEVEL_NONE: No trace points.
+ * - TRACE_LEVEL_STARTUP: TRACE_ExecTracerVersion(), TRACE_ProcessorReset().
+ * - TRACE_LEVEL_MESSAGES: TRACE_Printf().
+ * - TRACE_LEVEL_FUNCTIONS: TRACE_FunctionEntry(), TRACE_FunctionExit() and
+ *   the -finstrument-functions hooks.
+ * - TRACE_LEVEL_LINES: TRACE_Line().
+ * - TRACE_LEVEL_ALL: TRACE_VariableValue(), TRACE_SFRValue().
+ */
+#define TRACE_LEVEL_NONE        0
+#define TRACE_LEVEL_STARTUP     1
+#define TRACE_LEVEL_MESSAGES    2
+#define TRACE_LEVEL_FUNCTIONS   3
+#define TRACE_LEVEL_LINES       4
+#define TRACE_LEVEL_ALL         5
+
+/* For configuration files written before compile-time filtering existed */
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL             TRACE_LEVEL_ALL
+#endif
+#ifndef TRACE_COMPILED_IDCODES
+#define TRACE_COMPILED_IDCODES  0xFFFFFFFF
+#endif
+
+/*
+ * A source file may define TRACE_MODULE_LEVEL before including this header
+ * (see exec_trace_module_level() in lib/CMakeLists.txt) to use another level
+ * than TRACE_LEVEL. Trace points are compiled in when the level includes them
+ * and TRACE_COMPILED_IDCODES includes their ID code. VERSION and RESET are
+ * kept whatever the mask says, so that the analyzer can decode the log.
+ * Compiled out trace points generate no code or data and don't evaluate their
+ * arguments, so they cost nothing in hot loops.
+ */
+#ifndef TRACE_MODULE_LEVEL
+#define TRACE_MODULE_LEVEL      TRACE_LEVEL
+#endif
+#define _TRACE_COMPILED_IDCODES                                                 \
+    (TRACE_COMPILED_IDCODES | (1 << TRACE_IDCODE_VERSION) | (1 << TRACE_IDCODE_RESET))
+#define _TRACE_IS_COMPILED(level, idcode)                                       \
+    ((TRACE_MODULE_LEVEL >= (level)) && ((_TRACE_COMPILED_IDCODES >> (idcode)) & 1))
 
-#define EXEC_TRACE_INIT_MAGIC   (0xA5B4C123)
+/* Still uses the arguments, so that variables only traced don't warn */
+#define _TRACE_COMPILED_OUT(arg)    do { (void)sizeof(arg); } while (0)
+
+/*
+ * With USE_TIMESTAMPS, every entry and record is prefixed with a timestamp
+ * record header, so one more slot is reserved and committed.
+ * With COMPACT_ENCODING, records are prefixed with an escape halfword and
+ * each word takes two slots.
+ * Otherwise the slots are reserved and committed directly and neither option
+ * costs anything.
+ */
+#if USE_TIMESTAMPS && COMPACT_ENCODING
+#error "USE_TIMESTAMPS is not supported with COMPACT_ENCODING"
+#elif USE_TIMESTAMPS
+#define _TRACE_RESERVE(num_words, p_index)  _TRACE_ReserveTimestamped((num_words), (p_index))
+#define _TRACE_COMMIT(index, num_words)     _TRACE_Commit((index) - 1, (num_words) + 1)
+#elif COMPACT_ENCODING
+#define _TRACE_RESERVE(num_words, p_index)  _TRACE_ReserveEscaped((num_words), (p_index))
+#define _TRACE_COMMIT(index, num_words)     _TRACE_Commit((index) - 1, 2 * (num_words) + 1)
+#else
+#define _TRACE_RESERVE(num_words, p_index)  _TRACE_Reserve((num_words), (p_index))
+#define _TRACE_COMMIT(index, num_words)     _TRACE_Commit((index), (num_words))
+#endif
 
 /**
  * Convenience functions for checking buffer status.
  * Note: It is not necessary to call TRACE_IsEmpty() in your idle handler.
  * Simply checking whether TRACE_Get() returned 0 is equivalent.
  */
-#define TRACE_IsEmpty()         (m_exec_trace.head == m_exec_trace.tail)
-#define TRACE_IsFull()          (((m_exec_trace.head + 1) & BUFFER_INDEX_MASK) == m_exec_trace.tail)
-#define TRACE_GetNumEntries()   ((m_exec_trace.head - m_exec_trace.tail) & BUFFER_INDEX_MASK)
+#define TRACE_IsEmpty()         (TRACE_GetNumEntries() == 0)
+#define TRACE_IsFull()          (_TRACE_GetNumBufferedSlots() >= BUFFER_MAX_CAPACITY)
 
 /**
- * @brief       Reset the execution trace buffer to zero entries.
+ * @brief       Add one entry to the execution trace buffer.
+ *              This is safe to call from any thread or ISR, including ones
+ *              that preempt another TRACE_Put() or DumpExecTraceLog(). It
+ *              never disables interrupts or waits on another context.
+ * Note:        Entries become visible to TRACE_Get() in the order their slots
+ *              were claimed. An entry traced by an ISR that preempts another
+ *              put is published once the preempted put finishes.
+ * Note:        With COMPACT_ENCODING, function entry and exit entries for the
+ *              first 64 KB of flash take one halfword slot. Bit 0 of their
+ *              flash offset (the Thumb bit) is not kept.
+ * Note:        With RUNTIME_FILTER, entries whose ID code is disabled are
+ *              dropped (see TRACE_SetIdCodeMask()).
  */
-#define TRACE_Clear()                                           \
-    do {                                                        \
-        m_exec_trace.head = 0;                                  \
-        m_exec_trace.tail = 0;                                  \
-    } while (0)
-
-#if ALLOW_OVERWRITE
-#define TRACE_Put(n)                                            \
-    do {                                                        \
-        if (TRACE_IsFull()) {                                   \
-            m_exec_trace.tail++;                                \
-            m_exec_trace.tail &= BUFFER_INDEX_MASK;             \
-        }                                                       \
-        m_exec_trace.trace_buffer[m_exec_trace.head++] = n;     \
-        m_exec_trace.head &= BUFFER_INDEX_MASK;                 \
-    } while (0)
+#if COMPACT_ENCODING
+#define TRACE_Put(n)    _TRACE_PutCompact(n)
 #else
-#define TRACE_Put(n)                                            \
-    do {                                                        \
-        if (!TRACE_IsFull()) {                                  \
-            m_exec_trace.trace_buffer[m_exec_trace.head++] = n; \
-            m_exec_trace.head &= BUFFER_INDEX_MASK;             \
-        }                                                       \
+#define TRACE_Put(n)                                                            \
+    do {                                                                        \
+        uint32_t _trace_index;                                                  \
+        uint32_t _trace_value = (n);                                            \
+        if (_TRACE_IS_ENABLED(_trace_value) &&                                  \
+                _TRACE_RESERVE(1, &_trace_index)) {                             \
+            TRACE_WriteRecord(_trace_index, 0, _trace_value);                   \
+            _TRACE_COMMIT(_trace_index, 1);                                     \
+        }                                                                       \
     } while (0)
 #endif
 
 /**
- * @brief       Retrieve one entry from the execution trace buffer.
- *              Call this function periodically in a background or idle handler
- *              to feed execution trace data to your desired backend.
- * @return      Nonzero - The next trace value from the buffer.
- *              Zero - Invalid; the buffer is empty.
+ * @brief       Trace a record that spans several words of the trace buffer.
+ *              The words of a record always stay together: ISRs can't insert
+ *              entries between them, and with ALLOW_OVERWRITE the oldest
+ *              records are discarded whole.
+ *              - TRACE_ReserveRecord() claims num_words contiguous slots. If it
+ *                returns false, the record must be dropped.
+ *              - TRACE_WriteRecord() fills in word offset of the record.
+ *              - TRACE_CommitRecord() publishes all words together. It must be
+ *                called exactly once for every successful reservation.
+ * Note:        The first word is the record header and must describe the
+ *              record's length (see TRACE_RecordLength()). num_words must not
+ *              exceed TRACE_MAX_RECORD_WORDS, or TRACE_MAX_RECORD_WORDS - 1
+ *              with USE_TIMESTAMPS.
+ *
+ * Example usage:
+ * uint32_t index;
+ * if (TRACE_ReserveRecord(2, &index))
+ * {
+ *     TRACE_WriteRecord(index, 0, header);
+ *     TRACE_WriteRecord(index, 1, value);
+ *     TRACE_CommitRecord(index, 2);
+ * }
+ */
+#define TRACE_ReserveRecord(num_words, p_index)     _TRACE_RESERVE((num_words), (p_index))
+#define TRACE_WriteRecord(index, offset, value)     \
+    _TRACE_WriteWord((index) + (offset) * BUFFER_SLOTS_PER_WORD, (value))
+#define TRACE_CommitRecord(index, num_words)        _TRACE_COMMIT((index), (num_words))
+
+/**
+ * @brief       Trace a two-word record in one step.
  */
-#define TRACE_Get() TRACE_IsEmpty() ? 0 :                       \
-    (m_exec_trace.last_value = m_exec_trace.trace_buffer[m_exec_trace.tail++],   \
-    m_exec_trace.tail &= BUFFER_INDEX_MASK,                     \
-    m_exec_trace.last_value)
+#define TRACE_PutRecord2(header, value)                                         \
+    do {                                                                        \
+        uint32_t _trace_index;                                                  \
+        uint32_t _trace_header = (header);                                      \
+        if (_TRACE_IS_ENABLED(_trace_header) &&                                 \
+                _TRACE_RESERVE(2, &_trace_index)) {                             \
+            TRACE_WriteRecord(_trace_index, 0, _trace_header);                  \
+            TRACE_WriteRecord(_trace_index, 1, (value));                        \
+            _TRACE_COMMIT(_trace_index, 2);                                     \
+        }                                                                       \
+    } while (0)
 
 /**
  * @brief       Traces the protocol version of the execution tracer
  *              Call this once during system startup.
  */
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_STARTUP, TRACE_IDCODE_VERSION)
 #define TRACE_ExecTracerVersion()   TRACE_Put(                                      \
     ((TRACE_IDCODE_VERSION << TRACE_IDCODE_Pos) & TRACE_IDCODE_Msk) |               \
     ((TRACE_VERSION_V_Val << TRACE_VERSION_V_Pos) & TRACE_VERSION_V_Msk) |          \
     ((TRACE_PROTOCOL_MAJOR << TRACE_VERSION_MAJOR_Pos) & TRACE_VERSION_MAJOR_Msk) | \
     ((TRACE_PROTOCOL_MINOR << TRACE_VERSION_MINOR_Pos) & TRACE_VERSION_MINOR_Msk))
+#else
+#define TRACE_ExecTracerVersion()   do { } while (0)
+#endif
 
 /**
  * @brief       Traces information about the processor reset
@@ -88,9 +326,13 @@
  *              (E.g. RCC->CSR).  Shift and mask the register value to include
  *              only the relevant bits and avoid writing bits 31 through 28.
  */
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_STARTUP, TRACE_IDCODE_RESET)
 #define TRACE_ProcessorReset(reset_reg) TRACE_Put(                      \
     ((TRACE_IDCODE_RESET << TRACE_IDCODE_Pos) & TRACE_IDCODE_Msk) |     \
     ((reset_reg << TRACE_DATA_Pos) & TRACE_DATA_Msk))
+#else
+#define TRACE_ProcessorReset(reset_reg) _TRACE_COMPILED_OUT(reset_reg)
+#endif
 
 /**
  * @brief       Trace function entry and exit
@@ -115,58 +357,169 @@
  * automatically.  Hence why it is necessary to provide the pointers manually.
  * https://stackoverflow.com/questions/64261016/is-it-possible-to-unstringify-func-in-c
  */
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_FUNCTIONS, TRACE_IDCODE_FUNC_ENTRY)
 #define TRACE_FunctionEntry(funcAddr)   TRACE_Put(                              \
     ((TRACE_IDCODE_FUNC_ENTRY << TRACE_IDCODE_Pos) & TRACE_IDCODE_Msk) |        \
     ((((uintptr_t)funcAddr - FLASH_BASE) << TRACE_DATA_Pos) & TRACE_DATA_Msk))
+#else
+#define TRACE_FunctionEntry(funcAddr)   _TRACE_COMPILED_OUT((uintptr_t)funcAddr)
+#endif
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_FUNCTIONS, TRACE_IDCODE_FUNC_EXIT)
 #define TRACE_FunctionExit(funcAddr)    TRACE_Put(                              \
     ((TRACE_IDCODE_FUNC_EXIT << TRACE_IDCODE_Pos) & TRACE_IDCODE_Msk) |         \
     ((((uintptr_t)funcAddr - FLASH_BASE) << TRACE_DATA_Pos) & TRACE_DATA_Msk))
+#else
+#define TRACE_FunctionExit(funcAddr)    _TRACE_COMPILED_OUT((uintptr_t)funcAddr)
+#endif
 
 /**
  * @brief       Trace file and line number
  * Note:        The file name itself is not traced. Instead the user must pass
  *              a "module identifier" that will be masked into the value.
+ * Note:        Sources of a target passed to exec_trace_module_ids() in CMake
+ *              are compiled with TRACE_MODULE_ID set to a 12-bit identifier
+ *              derived from their path. The build writes the identifiers and
+ *              paths to a manifest that the trace tools read to print file
+ *              names (see lib/CMakeLists.txt).
+ * Note:        With RUNTIME_FILTER, lines of disabled modules are dropped (see
+ *              TRACE_SetModuleEnabled()). This check comes on top of the ID
+ *              code check, so it costs one more load and branch.
  * param[in]    module - An integer identifier used to identify the file when
- *              analyzing the trace buffer.
+ *              analyzing the trace buffer, such as TRACE_MODULE_ID.
+ *
+ * Example usage:
+ * TRACE_Line(TRACE_MODULE_ID);
  */
-#define TRACE_Line(module)  TRACE_Put(                                          \
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_LINES, TRACE_IDCODE_FILE_AND_LINE)
+#define TRACE_Line(module)                                                      \
+    do {                                                                        \
+        if (_TRACE_IS_MODULE_ENABLED(module)) {                                 \
+            TRACE_Put(_TRACE_LINE_ENTRY((module), __LINE__));                   \
+        }                                                                       \
+    } while (0)
+#else
+#define TRACE_Line(module)      _TRACE_COMPILED_OUT(module)
+#endif
+#define _TRACE_LINE_ENTRY(module, line)                                         \
     ((TRACE_IDCODE_FILE_AND_LINE << TRACE_IDCODE_Pos) & TRACE_IDCODE_Msk) |     \
-    ((TRACE_MODULE << TRACE_FANDL_MODULE_Pos) & TRACE_FANDL_MODULE_Msk) |       \
-    ((__LINE__ << TRACE_FANDL_LINE_Pos) & TRACE_FANDL_LINE_Msk))
+    (((module) << TRACE_FANDL_MODULE_Pos) & TRACE_FANDL_MODULE_Msk) |           \
+    (((line) << TRACE_FANDL_LINE_Pos) & TRACE_FANDL_LINE_Msk)
 
 /**
  * @brief       Trace a variable value
  * Note:        This macro takes two entries in the buffer, one for the variables
- *              address and one for its value.
+ *              address and one for its value. They are traced as one record.
  * Note:        A variable must be global and non-static for it to appear in a
  *              gcc map file. Without this, the analyzer cannot name a variable
  *              explicitly when decoding the buffer. Instead, it will say
  *              Stack + N, Heap + N or similar or UNKNOWN.
  */
-#define TRACE_VariableValue(var)    TRACE_Put(                                  \
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_ALL, TRACE_IDCODE_VARIABLE_VALUE)
+#define TRACE_VariableValue(var)    TRACE_PutRecord2(                           \
     ((TRACE_IDCODE_VARIABLE_VALUE << TRACE_IDCODE_Pos) & TRACE_IDCODE_Msk) |    \
-    ((((uintptr_t)(&var) - RAM_BASE) << TRACE_DATA_Pos) & TRACE_DATA_Msk));     \
-    TRACE_Put((uint32_t)var)
+    ((((uintptr_t)(&var) - RAM_BASE) << TRACE_DATA_Pos) & TRACE_DATA_Msk),      \
+    (uint32_t)var)
+#else
+#define TRACE_VariableValue(var)    _TRACE_COMPILED_OUT(var)
+#endif
 
 /**
  * @brief       Trace a memory mapped peripheral register value
  * Note:        This macro takes two entries in the buffer, one for the variables
- *              address and one for its value.
+ *              address and one for its value. They are traced as one record.
  * Note:        Analysis of SFR traces requires the SVD file for your MCU.
  */
-#define TRACE_SFRValue(reg)     TRACE_Put(                                      \
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_ALL, TRACE_IDCODE_SFR_VALUE)
+#define TRACE_SFRValue(reg)     TRACE_PutRecord2(                               \
     ((TRACE_IDCODE_SFR_VALUE << TRACE_IDCODE_Pos) & TRACE_IDCODE_Msk) |         \
-    ((((uintptr_t)(&reg) - RAM_BASE) << TRACE_DATA_Pos) & TRACE_DATA_Msk));     \
-    TRACE_Put(reg)
+    ((((uintptr_t)(&reg) - RAM_BASE) << TRACE_DATA_Pos) & TRACE_DATA_Msk),      \
+    (uint32_t)(reg))
+#else
+#define TRACE_SFRValue(reg)     _TRACE_COMPILED_OUT(reg)
+#endif
 
+/**
+ * @brief       Trace a printf-style message without formatting it on target.
+ *              Only the address of the format string and the arguments are
+ *              traced. The format string is kept in the TRACE_FORMAT_SECTION
+ *              section of the ELF file, and the analyzer formats the message
+ *              from there.
+ * Note:        The section must be linked at address 0 and not loaded onto
+ *              the target. With GNU ld, add this to the SECTIONS of the
+ *              linker script:
+ *                  .trace_fmt 0 (INFO) : { KEEP(*(.trace_fmt)) }
+ *                  ASSERT(SIZEOF(.trace_fmt) <= 0x10000,
+ *                         "TRACE_Printf format strings exceed 64 KB")
+ *              Only the low 16 bits of the address are traced, so the format
+ *              strings must fit in the first 64 KB of the section. The
+ *              analyzer refuses sections that don't.
+ * Note:        Each argument is converted to uint32_t and traced as one word,
+ *              so up to TRACE_PRINTF_MAX_ARGS integers, characters or
+ *              pointers (cast to uintptr_t) can be traced. The analyzer
+ *              supports the conversions of printf() for these, except %s
+ *              and %n. Floating point arguments are not supported.
+ * Note:        The arguments are traced as one record. It is dropped whole if
+ *              the buffer is full.
+ * Note:        Requires GCC or Clang.
+ *
+ * Example usage:
+ * TRACE_Printf("Retry %u of %u, status 0x%08X", retry, max_retries, status);
+ */
+#define TRACE_PRINTF_MAX_ARGS   (TRACE_MAX_RECORD_WORDS - 2)
+
+#if _TRACE_IS_COMPILED(TRACE_LEVEL_MESSAGES, TRACE_IDCODE_EXTENDED)
+#define TRACE_Printf(format, ...)                                               \
+    do {                                                                        \
+        static const char _trace_format[]                                       \
+                __attribute__((section(TRACE_FORMAT_SECTION))) = format;        \
+        if (_TRACE_IS_IDCODE_ENABLED(TRACE_IDCODE_EXTENDED)) {                  \
+            const uint32_t _trace_args[] = { 0, ##__VA_ARGS__ };                \
+            _Static_assert(sizeof(_trace_args) / sizeof(uint32_t) - 1 <=        \
+                    TRACE_PRINTF_MAX_ARGS, "Too many TRACE_Printf() arguments"); \
+            _TRACE_PutPrintf((uint32_t)(uintptr_t)_trace_format,                \
+                    &_trace_args[1], sizeof(_trace_args) / sizeof(uint32_t) - 1); \
+        }                                                                       \
+    } while (0)
+#else
+/* Never defined. Only its type is used, to keep the arguments referenced
+ * without evaluating them. The argument count is not checked, as the array
+ * for it would still take stack space at -O0. */
+int _TRACE_PrintfArgs(int first, ...);
 
+#define TRACE_Printf(format, ...)                                               \
+    do {                                                                        \
+        (void)sizeof(format);                                                   \
+        (void)sizeof(_TRACE_PrintfArgs(0, ##__VA_ARGS__));                      \
+    } while (0)
+#endif
+
+
+/**
+ * head, tail and reserve are free-running slot counts. They are masked with
+ * BUFFER_INDEX_MASK only when indexing trace_buffer.
+ * - reserve: Slots claimed by producers, including puts still in progress.
+ * - head: Entries published to the consumer.
+ * - tail: Entries removed by the consumer or discarded by overwrite.
+ * commit_flags holds one bit per slot, marking that the slot has been written
+ * and may be published. See _TRACE_IsCommitted().
+ * entries_lost is set when a put drops its record or discards an older one to
+ * make room, and cleared when a dump reports it as a BUFFER_FULL entry.
+ * last_timestamp and timestamp_count track the timestamp delta encoding. See
+ * _TRACE_ReserveTimestamped().
+ */
 typedef struct {
-    uint32_t        magic;
-    uint32_t        reset_count;
-    uint32_t        head;
-    uint32_t        tail;
-    uint32_t        trace_buffer[BUFFER_LENGTH_IN_WORDS];
-    uint32_t        last_value;
+    uint32_t            magic;
+    uint32_t            reset_count;
+    _Atomic uint32_t    head;
+    _Atomic uint32_t    tail;
+    _Atomic uint32_t    reserve;
+    _Atomic uint32_t    entries_lost;
+    _Atomic uint32_t    commit_flags[BUFFER_COMMIT_FLAG_WORDS];
+#if USE_TIMESTAMPS
+    _Atomic uint32_t    last_timestamp;
+    _Atomic uint32_t    timestamp_count;
+#endif
+    TraceSlot_t         trace_buffer[BUFFER_LENGTH_IN_SLOTS];
 } ExecTracer_t;
 
 typedef struct {
@@ -197,6 +550,363 @@ typedef struct {
 
 extern volatile ExecTracer_t m_exec_trace;
 
+#if RUNTIME_FILTER
+/**
+ * Runtime filter state. A set bit disables the ID code or module, so that
+ * everything is traced until told otherwise, even before TRACE_Init().
+ * - disabled_idcodes: Bit N for ID code N.
+ * - disabled_modules: Bit N % 32 of word N / 32 for TRACE_Line() module N.
+ * Change it with TRACE_SetIdCodeMask() and TRACE_SetModuleEnabled(), or by
+ * writing it from a debugger.
+ */
+#define TRACE_MODULE_MAX        (TRACE_FANDL_MODULE_Msk >> TRACE_FANDL_MODULE_Pos)
+
+typedef struct {
+    _Atomic uint32_t    disabled_idcodes;
+    _Atomic uint32_t    disabled_modules[TRACE_MODULE_MAX / 32 + 1];
+} TraceFilter_t;
+
+extern TraceFilter_t m_trace_filter;
+
+#define _TRACE_IS_IDCODE_ENABLED(idcode)                                        \
+    (!((atomic_load_explicit(&m_trace_filter.disabled_idcodes,                  \
+            memory_order_relaxed) >> (idcode)) & 1))
+#define _TRACE_IS_MODULE_ENABLED(module)                                        \
+    (!((atomic_load_explicit(&m_trace_filter.disabled_modules[                  \
+            ((uint32_t)(module) & TRACE_MODULE_MAX) / 32],                      \
+            memory_order_relaxed) >> ((uint32_t)(module) % 32)) & 1))
+#else
+#define _TRACE_IS_IDCODE_ENABLED(idcode)    (true)
+#define _TRACE_IS_MODULE_ENABLED(module)    (true)
+#endif
+#define _TRACE_IS_ENABLED(entry)                                                \
+    _TRACE_IS_IDCODE_ENABLED((uint32_t)(entry) >> TRACE_IDCODE_Pos)
+
+#if USE_TIMESTAMPS
+/**
+ * @brief       Read the timestamp source.
+ *              Implemented by the client when TRACE_GET_TIMESTAMP() is left
+ *              at its default in execution_tracer_conf.h.
+ */
+uint32_t TRACE_GetTimestamp(void);
+#endif
+
+/* Private inline functions ------------------------------------------------ */
+/* These implement the TRACE_ macros above and are not meant to be called
+ * directly. */
+
+TRACE_NO_INSTRUMENT static inline uint32_t _TRACE_GetNumBufferedSlots(void)
+{
+    /* Load tail first. head never trails tail, so this can't underflow. */
+    uint32_t tail = atomic_load(&m_exec_trace.tail);
+    return atomic_load(&m_exec_trace.head) - tail;
+}
+
+/**
+ * @brief       Number of words in the record that starts with header.
+ *              Used to keep records whole when they are removed from the
+ *              buffer.
+ */
+TRACE_NO_INSTRUMENT static inline uint32_t TRACE_RecordLength(uint32_t header)
+{
+    switch (header >> TRACE_IDCODE_Pos)
+    {
+    case TRACE_IDCODE_VARIABLE_VALUE:
+    case TRACE_IDCODE_SFR_VALUE:
+        return 2;
+    case TRACE_IDCODE_EXTENDED:
+        return 1 + ((header & TRACE_EXT_LENGTH_Msk) >> TRACE_EXT_LENGTH_Pos);
+    default:
+        return 1;
+    }
+}
+
+TRACE_NO_INSTRUMENT static inline void _TRACE_WriteWord(uint32_t index, uint32_t value)
+{
+#if COMPACT_ENCODING
+    /* Low half first, so an aligned word reads back in native order on
+     * little-endian targets */
+    m_exec_trace.trace_buffer[index & BUFFER_INDEX_MASK] = (uint16_t)value;
+    m_exec_trace.trace_buffer[(index + 1) & BUFFER_INDEX_MASK] = (uint16_t)(value >> 16);
+#else
+    m_exec_trace.trace_buffer[index & BUFFER_INDEX_MASK] = value;
+#endif
+}
+
+TRACE_NO_INSTRUMENT static inline uint32_t _TRACE_ReadWord(uint32_t index)
+{
+#if COMPACT_ENCODING
+    return m_exec_trace.trace_buffer[index & BUFFER_INDEX_MASK] |
+            ((uint32_t)m_exec_trace.trace_buffer[(index + 1) & BUFFER_INDEX_MASK] << 16);
+#else
+    return m_exec_trace.trace_buffer[index & BUFFER_INDEX_MASK];
+#endif
+}
+
+/**
+ * @brief       Number of slots in the record that starts at the free-running
+ *              index tail, given that head has been published.
+ * Note:        Published records are always complete, so clamping to head
+ *              only matters for words that were not traced through the
+ *              TRACE_ macros.
+ */
+TRACE_NO_INSTRUMENT static inline uint32_t _TRACE_RecordLengthAt(uint32_t tail, uint32_t head)
+{
+#if COMPACT_ENCODING
+    uint32_t length = 1;
+    if (m_exec_trace.trace_buffer[tail & BUFFER_INDEX_MASK] == TRACE_COMPACT_ESCAPE)
+    {
+        length += 2 * TRACE_RecordLength(_TRACE_ReadWord(tail + 1));
+    }
+#else
+    uint32_t length = TRACE_RecordLength(m_exec_trace.trace_buffer[tail & BUFFER_INDEX_MASK]);
+#endif
+    return (length < (head - tail)) ? length : (head - tail);
+}
+
+/**
+ * @brief       Check whether the slot for a free-running index has been written.
+ * Note:        Rather than being cleared when the slot is read, a slot's commit
+ *              flag is inverted each time the slot is written. A slot is
+ *              committed when its flag is 1 on even laps through the buffer and
+ *              0 on odd laps. Flags start at 0, meaning nothing is committed.
+ */
+TRACE_NO_INSTRUMENT static inline bool _TRACE_IsCommitted(uint32_t index)
+{
+    uint32_t slot = index & BUFFER_INDEX_MASK;
+    uint32_t flags = atomic_load(&m_exec_trace.commit_flags[slot / 32]);
+    bool odd_lap = ((index & BUFFER_LENGTH_IN_SLOTS) != 0);
+    return (((flags >> (slot % 32)) & 1) != odd_lap);
+}
+
+/**
+ * @brief       Claim the next num_slots contiguous slots in the trace buffer.
+ *              Claimed slots must be written and then passed to
+ *              _TRACE_Commit().
+ * @param[out]  p_index Free-running index of the first claimed slot.
+ * @return      True if the slots were claimed. False if the entry or record
+ *              must be dropped.
+ */
+TRACE_NO_INSTRUMENT static inline bool _TRACE_Reserve(uint32_t num_slots, uint32_t * p_index)
+{
+    uint32_t tail;
+    uint32_t reserve;
+
+    for (;;)
+    {
+        /* Load tail first so that reserve - tail can't underflow. */
+        tail = atomic_load(&m_exec_trace.tail);
+        reserve = atomic_load(&m_exec_trace.reserve);
+        TRACE_PREEMPTION_POINT();
+        if ((reserve - tail + num_slots) <= BUFFER_MAX_CAPACITY)
+        {
+            if (_TRACE_CAS_WEAK(&m_exec_trace.reserve, &reserve, reserve + num_slots))
+            {
+                *p_index = reserve;
+                return true;
+            }
+        }
+#if ALLOW_OVERWRITE
+        else if ((num_slots <= BUFFER_MAX_CAPACITY) && (tail != atomic_load(&m_exec_trace.head)))
+        {
+            /* Discard the oldest published record. The consumer claims
+             * records with the same compare-and-swap, so each record is
+             * either read or discarded whole, never both. */
+            atomic_store(&m_exec_trace.entries_lost, 1);
+            _TRACE_CAS_WEAK(&m_exec_trace.tail, &tail,
+                    tail + _TRACE_RecordLengthAt(tail, atomic_load(&m_exec_trace.head)));
+        }
+#endif
+        else
+        {
+            /* Buffer is full (or, with overwrite, every slot is held by a
+             * put that has not finished yet) */
+            atomic_store(&m_exec_trace.entries_lost, 1);
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief       Mark claimed slots as written and publish them.
+ *              head advances over every consecutive committed slot. If an
+ *              earlier slot is still being written, the put that owns it
+ *              publishes these when it commits.
+ */
+TRACE_NO_INSTRUMENT static inline void _TRACE_Commit(uint32_t index, uint32_t num_slots)
+{
+    uint32_t head;
+    uint32_t new_head;
+
+    /* Commit the header last. Every other slot of the record is then already
+     * committed when head reaches the header, so head only ever moves past
+     * whole records. */
+    while (num_slots-- > 0)
+    {
+        uint32_t slot = (index + num_slots) & BUFFER_INDEX_MASK;
+        uint32_t bit = 1UL << (slot % 32);
+        if ((index + num_slots) & BUFFER_LENGTH_IN_SLOTS)
+        {
+            _TRACE_FETCH_AND(&m_exec_trace.commit_flags[slot / 32], ~bit);
+        }
+        else
+        {
+            _TRACE_FETCH_OR(&m_exec_trace.commit_flags[slot / 32], bit);
+        }
+    }
+
+    /* The flags must be set before head is loaded. Either this put sees the
+     * earlier slot committed and publishes both, or the earlier put sees this
+     * slot committed when it advances head. */
+    head = atomic_load(&m_exec_trace.head);
+    TRACE_PREEMPTION_POINT();
+    do
+    {
+        new_head = head;
+        while (_TRACE_IsCommitted(new_head))
+        {
+            new_head++;
+        }
+        if (new_head == head)
+        {
+            return;
+        }
+    } while (!_TRACE_CAS_WEAK(&m_exec_trace.head, &head, new_head));
+}
+
+#if COMPACT_ENCODING
+/**
+ * @brief       Claim slots for a record of num_words words and write the
+ *              escape halfword that marks it as full width.
+ * @param[out]  p_index Free-running index of the slot after the escape.
+ */
+TRACE_NO_INSTRUMENT static inline bool _TRACE_ReserveEscaped(uint32_t num_words, uint32_t * p_index)
+{
+    if (!_TRACE_Reserve(1 + 2 * num_words, p_index))
+    {
+        return false;
+    }
+    m_exec_trace.trace_buffer[*p_index & BUFFER_INDEX_MASK] = TRACE_COMPACT_ESCAPE;
+    (*p_index)++;
+    return true;
+}
+
+/**
+ * @brief       Trace one entry, in a single halfword slot if it is a function
+ *              entry or exit that fits, or escaped at full width otherwise.
+ */
+TRACE_NO_INSTRUMENT static inline void _TRACE_PutCompact(uint32_t value)
+{
+    uint32_t index;
+    uint32_t idcode = value >> TRACE_IDCODE_Pos;
+    uint32_t offset = (value & TRACE_DATA_Msk) >> (TRACE_DATA_Pos + 1);
+
+    if (!_TRACE_IS_ENABLED(value))
+    {
+        return;
+    }
+    if (((idcode == TRACE_IDCODE_FUNC_ENTRY) || (idcode == TRACE_IDCODE_FUNC_EXIT)) &&
+        (offset < TRACE_COMPACT_OFFSET_Msk))
+    {
+        if (_TRACE_Reserve(1, &index))
+        {
+            m_exec_trace.trace_buffer[index & BUFFER_INDEX_MASK] = (uint16_t)(offset |
+                    ((idcode == TRACE_IDCODE_FUNC_EXIT) ? TRACE_COMPACT_EXIT_Msk : 0));
+            _TRACE_Commit(index, 1);
+        }
+    }
+    else if (_TRACE_ReserveEscaped(1, &index))
+    {
+        _TRACE_WriteWord(index, value);
+        _TRACE_Commit(index - 1, 3);
+    }
+}
+#endif
+
+#if USE_TIMESTAMPS
+/**
+ * @brief       Trace a timestamp sync record holding the full timestamp.
+ *              Called by _TRACE_ReserveTimestamped() only.
+ * @return      False if the buffer had no room for the record.
+ */
+bool _TRACE_PutTimestampSync(uint32_t timestamp) TRACE_NO_INSTRUMENT;
+
+/**
+ * @brief       Claim slots for a record and write its timestamp prefix.
+ *              The prefix is an extended record header whose payload is the
+ *              record being traced and whose data is the number of ticks
+ *              since the previous timestamp. A sync record with the full
+ *              timestamp is traced first every TIMESTAMP_SYNC_INTERVAL
+ *              records, when the delta doesn't fit in 16 bits, and after a
+ *              record is dropped, so the analyzer can recover absolute time
+ *              after old records are overwritten. A dropped or overwritten
+ *              record sets the lost entries flag like any other, so the dump
+ *              starts with a BUFFER_FULL entry and the analyzer treats time
+ *              as unknown until the next sync record.
+ * Note:        The prefix doubles the size of one-word entries, and the
+ *              exchange and add below are two more atomic operations per put.
+ *              See USE_TIMESTAMPS in execution_tracer_conf.h for why the delta
+ *              is not packed into the entry.
+ * Note:        A context that preempts this between reading the timestamp and
+ *              reserving slots can end up ahead of it in the buffer. Both
+ *              records are then shown with each other's timestamps, but time
+ *              is correct again from the next record.
+ * @param[out]  p_index Free-running index of the slot after the prefix.
+ */
+TRACE_NO_INSTRUMENT static inline bool _TRACE_ReserveTimestamped(uint32_t num_words, uint32_t * p_index)
+{
+    uint32_t now = TRACE_GET_TIMESTAMP();
+    uint32_t delta = now - _TRACE_EXCHANGE(&m_exec_trace.last_timestamp, now);
+
+    if ((delta > (TRACE_EXT_DATA_Msk >> TRACE_EXT_DATA_Pos)) ||
+        ((_TRACE_FETCH_ADD(&m_exec_trace.timestamp_count, 1) % TIMESTAMP_SYNC_INTERVAL) == 0))
+    {
+        if (!_TRACE_PutTimestampSync(now))
+        {
+            atomic_store(&m_exec_trace.timestamp_count, 0);
+            return false;
+        }
+        delta = 0;
+    }
+
+    if (!_TRACE_Reserve(num_words + 1, p_index))
+    {
+        /* The delta is lost with the record, so resync on the next one */
+        atomic_store(&m_exec_trace.timestamp_count, 0);
+        return false;
+    }
+    TRACE_WriteRecord(*p_index, 0,
+            ((uint32_t)TRACE_IDCODE_EXTENDED << TRACE_IDCODE_Pos) |
+            (num_words << TRACE_EXT_LENGTH_Pos) |
+            (TRACE_EXT_TYPE_TIMESTAMP << TRACE_EXT_TYPE_Pos) |
+            (delta << TRACE_EXT_DATA_Pos));
+    (*p_index)++;
+    return true;
+}
+#endif
+
+/**
+ * @brief       Trace the record of a TRACE_Printf() call.
+ *              num_args is a constant, so when inlined the loop is unrolled.
+ */
+TRACE_NO_INSTRUMENT static inline void _TRACE_PutPrintf(uint32_t format, const uint32_t * p_args, uint32_t num_args)
+{
+    uint32_t index;
+
+    if (_TRACE_RESERVE(1 + num_args, &index))
+    {
+        TRACE_WriteRecord(index, 0,
+                ((uint32_t)TRACE_IDCODE_EXTENDED << TRACE_IDCODE_Pos) |
+                (num_args << TRACE_EXT_LENGTH_Pos) |
+                (TRACE_EXT_TYPE_PRINTF << TRACE_EXT_TYPE_Pos) |
+                ((format << TRACE_EXT_DATA_Pos) & TRACE_EXT_DATA_Msk));
+        for (uint32_t i = 0; i < num_args; i++)
+        {
+            TRACE_WriteRecord(index, 1 + i, p_args[i]);
+        }
+        _TRACE_COMMIT(index, 1 + num_args);
+    }
+}
 
 /**
  * @brief       Initializes the trace buffer correctly for both power on and reset.
@@ -209,9 +919,49 @@ extern volatile ExecTracer_t m_exec_trace;
  */
 void TRACE_Init(ExecTraceCallbacks_t * p_callbacks);
 
+/**
+ * @brief       Discard all entries in the trace buffer.
+ * Note:        Must not be called while another context may be tracing.
+ */
+void TRACE_Clear(void);
+
+/**
+ * @brief       Remove the oldest word from the trace buffer.
+ * Note:        Words are removed a whole record at a time. The rest of the
+ *              record is held back and returned by the following calls, so a
+ *              record is never split by an overwriting put.
+ * Note:        Only one context may consume entries at a time.
+ * @return      The oldest word, or 0 if the buffer is empty.
+ */
+uint32_t TRACE_Get(void);
+
+/**
+ * @brief       Number of words that TRACE_Get() can still return.
+ * Note:        With COMPACT_ENCODING, entries still in the trace buffer are
+ *              counted in halfword slots. An escaped record of N words takes
+ *              2N + 1 slots, so the count is an upper bound on the number of
+ *              words. 0 still means the buffer is empty.
+ */
+uint32_t TRACE_GetNumEntries(void);
+
 /**
  * @brief       Dump all log entries to the backend using the user-provided write
  *              function.
+ *              The dump starts with a BUFFER_FULL entry if the buffer is full
+ *              or if any entry was dropped or overwritten since the last dump.
+ * Note:        The output format is selected by DUMP_FORMAT. With
+ *              DUMP_FORMAT_HEX_TEXT, write is called once per entry. With
+ *              DUMP_FORMAT_RAW_BINARY, write is called at most twice (plus once
+ *              for the buffer full indication) and is handed a pointer directly
+ *              into the trace buffer. With ALLOW_OVERWRITE, puts that overwrite
+ *              the entries being written corrupt them. This can't be detected
+ *              until the writes are done, so the dump then ends with a
+ *              BUFFER_FULL entry and the reader must treat all entries of that
+ *              dump as suspect. Dump the raw format while producers are quiet,
+ *              or with enough free space that they won't fill the buffer
+ *              meanwhile. With DUMP_FORMAT_FRAMED, write is
+ *              called once per frame, and with DUMP_FORMAT_BASE64_TEXT once
+ *              per line of up to TRACE_BASE64_LINE_WORDS entries.
  * Note:        Call this function in some kind of background loop, preferably
  *              in the idle thread.
  * Note:        When using NOINIT configuration, it also useful to call this
@@ -220,4 +970,80 @@ void TRACE_Init(ExecTraceCallbacks_t * p_callbacks);
  */
 void DumpExecTraceLog(void);
 
+/**
+ * @brief       Dump log entries to the backend, stopping once a budget is
+ *              used up so that the caller's worst-case latency is bounded.
+ *              The lock is released before returning. Call again later to
+ *              continue where this left off.
+ * Note:        With DUMP_FORMAT_RAW_BINARY, entries are counted in buffer slots
+ *              (halfwords with COMPACT_ENCODING). The dump stops at the last
+ *              whole record within the budget, but at least one record is
+ *              always written. The deadline is only checked before writing,
+ *              because the entries are then written in at most two calls.
+ * Note:        With DUMP_FORMAT_FRAMED, the deadline and budget are checked
+ *              before each record, and a record that was started is always
+ *              finished.
+ * Note:        The other formats count words as returned by TRACE_Get(),
+ *              also with COMPACT_ENCODING.
+ * @param       max_entries Maximum number of entries to write, or
+ *              DUMP_NO_LIMIT.
+ * @param       deadline_reached Called before each write; Return true to stop
+ *              dumping. Optional - Set to NULL if not used.
+ * @return      Number of entries still waiting to be dumped, counted as by
+ *              TRACE_GetNumEntries().
+ */
+uint32_t DumpExecTraceLogBounded(uint32_t max_entries, bool (*deadline_reached)(void));
+
+#if RUNTIME_FILTER
+/**
+ * @brief       Select the ID codes that are traced. Entries and records with
+ *              other ID codes are dropped by the TRACE_ macros, at the cost of
+ *              one load and branch each.
+ * Note:        TRACE_IDCODE_VERSION and TRACE_IDCODE_RESET are always traced,
+ *              so that the analyzer can decode what follows them.
+ * Note:        Records traced with TRACE_ReserveRecord() are not filtered.
+ * @param       mask Bit N enables ID code N, e.g.
+ *              (1 << TRACE_IDCODE_FUNC_ENTRY) | (1 << TRACE_IDCODE_FUNC_EXIT).
+ *              TRACE_IDCODE_MASK_ALL enables all of them.
+ */
+void TRACE_SetIdCodeMask(uint32_t mask);
+
+/**
+ * @brief       Return the mask of ID codes that are traced.
+ */
+uint32_t TRACE_GetIdCodeMask(void);
+
+/**
+ * @brief       Enable or disable the TRACE_Line() entries of one module.
+ * @param       module Module identifier, such as TRACE_MODULE_ID, or
+ *              TRACE_ALL_MODULES.
+ */
+void TRACE_SetModuleEnabled(uint32_t module, bool enabled);
+
+/**
+ * @brief       Return whether the TRACE_Line() entries of module are traced.
+ */
+bool TRACE_IsModuleEnabled(uint32_t module);
+
+#define TRACE_IDCODE_MASK_ALL   (0xFFFFFFFF)
+#define TRACE_ALL_MODULES       (0xFFFFFFFF)
+#endif
+
+#if INSTRUMENT_FUNCTIONS
+/**
+ * @brief       Hooks called on entry to and exit from every function compiled
+ *              with -finstrument-functions. They trace the same entries as
+ *              TRACE_FunctionEntry() and TRACE_FunctionExit(), including on
+ *              early returns.
+ * Note:        Select the sources to instrument with
+ *              exec_trace_instrument_functions() in CMake. Mark functions that
+ *              must not be traced with TRACE_NO_INSTRUMENT.
+ * Note:        The ExecTraceCallbacks_t functions and the timestamp source
+ *              must not be instrumented. A traced write callback adds entries
+ *              as fast as DumpExecTraceLog() removes them, so it never ends.
+ */
+void __cyg_profile_func_enter(void * this_fn, void * call_site) TRACE_NO_INSTRUMENT;
+void __cyg_profile_func_exit(void * this_fn, void * call_site) TRACE_NO_INSTRUMENT;
+#endif
+
 #endif /* LIB_INCLUDE_EXECUTION_TRACER_H_ */
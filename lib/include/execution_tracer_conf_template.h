@@ -60,14 +60,127 @@
  * - If disabled, the requested trace will not be performed.
  * Regardless of this setting, DumpExecTraceLog() will indicate that the
  * buffer reached maximum capacity.  This should be taken as indication
- * that entries were dropped.
+ * that entries were dropped.  Records of several slots may leave a few slots
+ * free when one is dropped or overwritten, so the indication is also given
+ * whenever an entry was lost since the previous dump, full or not.
  */
 #define ALLOW_OVERWRITE                 (@EXEC_TRACE_ALLOW_OVERWRITE@)
 
+/**
+ * Critical section for cores without lock-free 32-bit atomics, such as
+ * Cortex-M0 and M0+. Each read-modify-write of the put path is done between
+ * TRACE_ENTER_CRITICAL() and TRACE_EXIT_CRITICAL(), which makes tracing safe
+ * from ISRs at the cost of masking interrupts for a few instructions at a
+ * time. Left empty, tracing on those cores is only safe from one context at
+ * a time. Not used on cores with lock-free atomics (ARMv7-M and later).
+ * Whatever they call must be declared before execution_tracer.h is included.
+ * Example with CMSIS:
+ *   TRACE_ENTER_CRITICAL(): uint32_t primask = __get_PRIMASK(); __disable_irq()
+ *   TRACE_EXIT_CRITICAL():  __set_PRIMASK(primask)
+ */
+#define TRACE_ENTER_CRITICAL()          @EXEC_TRACE_ENTER_CRITICAL@
+#define TRACE_EXIT_CRITICAL()           @EXEC_TRACE_EXIT_CRITICAL@
+
 /**
  * The number of trace entries that can be held in the trace buffer at once.
  * MUST BE A POWER OF 2.
  */
 #define BUFFER_LENGTH_IN_WORDS          (@EXEC_TRACE_NUM_TRACE_ENTRIES@)
 
+/**
+ * Selects the format DumpExecTraceLog() uses when writing to the backend.
+ * - DUMP_FORMAT_HEX_TEXT: Each entry is written as "0xXXXXXXXX\n".
+ * - DUMP_FORMAT_RAW_BINARY: The occupied region of the trace buffer is
+ *   written as raw 32-bit words in native byte order, in at most two writes
+ *   (one for each side of the wraparound). The writes read the trace buffer
+ *   directly, so with ALLOW_OVERWRITE, producers must not fill the buffer
+ *   while a dump is in progress; If they do, the dump ends with a
+ *   BUFFER_FULL entry and any of the words written before it may be corrupt.
+ * - DUMP_FORMAT_FRAMED: Entries are written in checksummed, sequence
+ *   numbered frames (see execution_tracer_protocol.h) so that the reader can
+ *   detect lost entries and resynchronize. Typically a third of the size of
+ *   DUMP_FORMAT_HEX_TEXT or less.
+ * - DUMP_FORMAT_BASE64_TEXT: Entries are written as lines of base64 text
+ *   (see execution_tracer_protocol.h), for backends that only pass
+ *   printable text. Half the size of DUMP_FORMAT_HEX_TEXT.
+ */
+#define DUMP_FORMAT                     (DUMP_FORMAT_@EXEC_TRACE_DUMP_FORMAT@)
+
+/**
+ * When enabled, the trace buffer is divided into halfword slots. Function
+ * entry and exit traces within the first 64 KB of flash take one halfword,
+ * which nearly doubles the history held in the same RAM. All other entries
+ * take a halfword escape code plus their full width.
+ * DUMP_FORMAT_RAW_BINARY then writes halfwords; DUMP_FORMAT_HEX_TEXT
+ * and DUMP_FORMAT_BASE64_TEXT write full-width entries.
+ * Not supported together with USE_TIMESTAMPS.
+ */
+#define COMPACT_ENCODING                (@EXEC_TRACE_COMPACT_ENCODING@)
+
+/**
+ * When enabled, every trace entry is prefixed with the time elapsed since the
+ * previous entry, and a full timestamp is traced periodically so the analyzer
+ * can rebuild absolute time even after old entries are overwritten.
+ * Cost: Each entry or record takes one more word in the trace buffer, which
+ * halves the history held for one-word entries such as function entry and
+ * exit. Each put also does an atomic exchange (last timestamp) and an atomic
+ * add (sync interval count) on top of the usual reservation.
+ * The delta can't share the entry's word, as entries use all 28 data bits.
+ * It can't share a word with other entries' deltas either, as overwrite
+ * discards the oldest record whole and producers may interleave. The prefix
+ * keeps each delta in its own record's reservation instead.
+ * When disabled, none of the timestamp code is compiled.
+ */
+#define USE_TIMESTAMPS                  (@EXEC_TRACE_USE_TIMESTAMPS@)
+
+/**
+ * Expression that reads a free-running 32-bit timestamp, such as the
+ * Cortex-M cycle counter (DWT->CYCCNT) or a timer's count register. Deltas
+ * of more than 65535 ticks cost a sync record, so scale down fast counters
+ * if entries are usually further apart than that.
+ * By default the client implements uint32_t TRACE_GetTimestamp(void).
+ */
+#define TRACE_GET_TIMESTAMP()           (@EXEC_TRACE_TIMESTAMP_SOURCE@)
+
+/**
+ * Number of timestamped entries between full timestamp sync records.
+ * Keep this well below BUFFER_LENGTH_IN_WORDS / 2 so that a sync record
+ * survives in the buffer when it is overwriting itself.
+ */
+#define TIMESTAMP_SYNC_INTERVAL         (@EXEC_TRACE_TIMESTAMP_SYNC_INTERVAL@)
+
+/**
+ * When enabled, the library implements the -finstrument-functions hooks
+ * __cyg_profile_func_enter() and __cyg_profile_func_exit(), which trace
+ * function entry and exit for every function in the instrumented sources.
+ * Select those sources with exec_trace_instrument_functions() in CMake.
+ * Each instrumented call costs two hook calls of one TRACE_Put() each.
+ */
+#define INSTRUMENT_FUNCTIONS            (@EXEC_TRACE_INSTRUMENT_FUNCTIONS@)
+
+/**
+ * When enabled, ID codes and TRACE_Line() modules can be disabled while
+ * running with TRACE_SetIdCodeMask() and TRACE_SetModuleEnabled(), so that
+ * noisy sources don't push older history out of the buffer. Each trace point
+ * then loads and tests one bit of the filter before tracing (TRACE_Line()
+ * two). The filter takes 516 bytes of RAM.
+ * When disabled, none of the filter code is compiled.
+ */
+#define RUNTIME_FILTER                  (@EXEC_TRACE_RUNTIME_FILTER@)
+
+/**
+ * Trace points that TRACE_LEVEL does not include are compiled out, leaving
+ * no code or data behind. See TRACE_LEVEL_ in execution_tracer.h for what
+ * each level includes. Sources given their own level with
+ * exec_trace_module_level() in CMake use that instead.
+ */
+#define TRACE_LEVEL                     (TRACE_LEVEL_@EXEC_TRACE_LEVEL@)
+
+/**
+ * ID codes whose trace points are compiled in, bit N for ID code N. Trace
+ * points of the other ID codes are compiled out, whatever TRACE_LEVEL is.
+ * VERSION and RESET entries are always compiled in.
+ */
+#define TRACE_COMPILED_IDCODES          (@EXEC_TRACE_COMPILED_IDCODES@)
+
 #endif /* LIB_INCLUDE_EXECUTION_TRACER_CONF_H_ */
@@ -13,7 +13,7 @@
  * compatibility for the analyzer even for breaking changes.
  */
 #define TRACE_PROTOCOL_MAJOR        1       /* Update for breaking changes */
-#define TRACE_PROTOCOL_MINOR        0       /* Update for non-breaking changes */
+#define TRACE_PROTOCOL_MINOR        5       /* Update for non-breaking changes */
 
 /**
  * ID codes occupy the top 4 bits of each trace entry and identify
@@ -27,6 +27,7 @@
 #define TRACE_IDCODE_FILE_AND_LINE	    5
 #define TRACE_IDCODE_VARIABLE_VALUE	    6
 #define TRACE_IDCODE_SFR_VALUE		    7
+#define TRACE_IDCODE_EXTENDED           8       /**< Variable length record; See TRACE_EXT_ fields */
 
 #define TRACE_IDCODE_BUFFER_FULL        15      /**< Traced when the buffer fills before calling the log dump routine */
 
@@ -52,4 +53,90 @@
 #define TRACE_FANDL_LINE_Pos            (0U)
 #define TRACE_FANDL_LINE_Msk            (0xFFFF << TRACE_FANDL_LINE_Pos)
 
+/**
+ * Extended records (protocol 1.1 and later) are a header word followed by
+ * up to 15 payload words. The header carries the number of payload words so
+ * that an analyzer can skip record types it does not know about without
+ * losing its place in the trace.
+ */
+#define TRACE_EXT_LENGTH_Pos            (24U)
+#define TRACE_EXT_LENGTH_Msk            (0xF << TRACE_EXT_LENGTH_Pos)
+#define TRACE_EXT_TYPE_Pos              (16U)
+#define TRACE_EXT_TYPE_Msk              (0xFF << TRACE_EXT_TYPE_Pos)
+#define TRACE_EXT_DATA_Pos              (0U)
+#define TRACE_EXT_DATA_Msk              (0xFFFF << TRACE_EXT_DATA_Pos)
+
+/**
+ * Extended record types (protocol 1.2 and later).
+ * - TIMESTAMP: Prefixes a timestamped entry or record, which is its payload.
+ *   DATA holds the ticks elapsed since the previous timestamp.
+ * - TIMESTAMP_SYNC: The payload is one word holding the full timestamp. The
+ *   next timestamp's delta is relative to it.
+ * - PRINTF (protocol 1.5 and later): DATA holds the address of the format
+ *   string in the TRACE_FORMAT_SECTION section, which is linked at address 0.
+ *   The payload holds the arguments, one word each.
+ */
+#define TRACE_EXT_TYPE_TIMESTAMP        1
+#define TRACE_EXT_TYPE_TIMESTAMP_SYNC   2
+#define TRACE_EXT_TYPE_PRINTF           3
+
+/**
+ * Non-loaded ELF section holding the format strings of TRACE_Printf().
+ */
+#define TRACE_FORMAT_SECTION            ".trace_fmt"
+
+/**
+ * Compact encoding (COMPACT_ENCODING) stores the trace buffer as halfwords.
+ * - Function entry and exit are one halfword: bit 15 is set for exit, and
+ *   bits 14:0 hold the flash offset divided by 2.
+ * - TRACE_COMPACT_ESCAPE is followed by a record in the usual format, each
+ *   word stored as two halfwords, low half first.
+ */
+#define TRACE_COMPACT_ESCAPE            0xFFFF
+#define TRACE_COMPACT_EXIT_Msk          (0x8000)
+#define TRACE_COMPACT_OFFSET_Msk        (0x7FFF)
+
+/**
+ * Longest record, in words, including its header.
+ */
+#define TRACE_MAX_RECORD_WORDS          16
+
+/**
+ * Framed dump format (DUMP_FORMAT_FRAMED, protocol 1.3 and later). Each frame
+ * is COBS encoded and followed by a TRACE_FRAME_DELIMITER byte, so a reader
+ * that loses bytes finds its place again at the next delimiter. Before
+ * encoding, a frame is:
+ * - Sequence number: 32 bits, little-endian. The number of entries sent in
+ *   earlier frames, so that a gap tells the reader how many were lost.
+ * - Entries, one token each. Records are never split across frames.
+ * - CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF) of all
+ *   bytes before it, 16 bits, little-endian.
+ * Tokens are LEB128 encoded (7 bits per byte, least significant first, bit 7
+ * set on all but the last byte):
+ * - TRACE_FRAME_TOKEN_EXIT: Function exit from the innermost function
+ *   entry still open in this frame.
+ * - Any other token is the entry rotated left by 4 bits, times 2, plus 1.
+ *   Rotating puts the ID code in the low bits, so small offsets stay short.
+ * Up to TRACE_FRAME_STACK_DEPTH open function entries are tracked. They are
+ * forgotten at the end of each frame so that frames decode on their own.
+ */
+#define TRACE_FRAME_DELIMITER           0x00
+#define TRACE_FRAME_SEQ_SIZE            4
+#define TRACE_FRAME_CRC_SIZE            2
+#define TRACE_FRAME_MAX_PAYLOAD         240     /**< Bytes of tokens */
+#define TRACE_FRAME_MAX_TOKEN_SIZE      5
+#define TRACE_FRAME_STACK_DEPTH         16
+#define TRACE_FRAME_TOKEN_EXIT          0
+
+/**
+ * Base64 text dump format (DUMP_FORMAT_BASE64_TEXT, protocol 1.4 and later),
+ * for backends that only pass printable text. Each line is
+ * TRACE_BASE64_LINE_START, then up to TRACE_BASE64_LINE_WORDS entries as
+ * 32-bit little-endian words in base64 (RFC 4648, padded with '='), then
+ * '\n'. A full line of 12 entries is 66 bytes, half the size of
+ * DUMP_FORMAT_HEX_TEXT. Records may continue on the next line.
+ */
+#define TRACE_BASE64_LINE_START         '$'
+#define TRACE_BASE64_LINE_WORDS         12      /**< A multiple of 3, so full lines need no padding */
+
 #endif /* LIB_INCLUDE_EXECUTION_TRACER_PROTOCOL_H_ */
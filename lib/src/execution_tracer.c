@@ -10,6 +10,22 @@
 #include "execution_tracer_private.h"
 
 _Static_assert(IS_POWER_OF_2(BUFFER_LENGTH_IN_WORDS), "BUFFER_LENGTH_IN_WORDS must be a power of 2");
+#if USE_TIMESTAMPS
+_Static_assert(TIMESTAMP_SYNC_INTERVAL > 0, "TIMESTAMP_SYNC_INTERVAL must be at least 1");
+#endif
+#if DUMP_FORMAT == DUMP_FORMAT_RAW_BINARY
+_Static_assert(BUFFER_LENGTH_IN_WORDS * sizeof(uint32_t) <= UINT16_MAX,
+        "Trace buffer is too large to be written to the backend in one span");
+#endif
+#if DUMP_FORMAT == DUMP_FORMAT_FRAMED
+_Static_assert(TRACE_FRAME_SEQ_SIZE + TRACE_FRAME_MAX_PAYLOAD + TRACE_FRAME_CRC_SIZE < 0xFF,
+        "Frames must be short enough to need only one COBS overhead byte");
+_Static_assert(TRACE_MAX_RECORD_WORDS * TRACE_FRAME_MAX_TOKEN_SIZE <= TRACE_FRAME_MAX_PAYLOAD,
+        "The longest record must fit in one frame");
+#endif
+#if DUMP_FORMAT == DUMP_FORMAT_BASE64_TEXT
+_Static_assert(TRACE_BASE64_LINE_WORDS % 3 == 0, "Full base64 lines must not need padding");
+#endif
 
 /* Private variables ------------------------------------------------------- */
 /**
@@ -17,11 +33,28 @@ _Static_assert(IS_POWER_OF_2(BUFFER_LENGTH_IN_WORDS), "BUFFER_LENGTH_IN_WORDS mu
  */
 __NO_INIT ExecTracer_t volatile m_exec_trace;
 
+#if RUNTIME_FILTER
+/**
+ * ID codes and modules that are not traced. Zero initialized, so everything
+ * is traced until the filter is changed.
+ */
+TraceFilter_t m_trace_filter;
+#endif
+
 /**
  * Callbacks for implementation defined by the client.
  */
 static ExecTraceCallbacks_t m_exec_trace_callbacks = {0};
 
+/**
+ * A record claimed from the trace buffer by TRACE_Get() whose words have not
+ * all been returned yet. Records are claimed whole so that an overwriting put
+ * can never discard the rest of a record that is partway through being read.
+ */
+static uint32_t m_get_record[TRACE_MAX_RECORD_WORDS];
+static uint32_t m_get_record_length;
+static uint32_t m_get_record_pos;
+
 /**
  * Array to simplify conversion of uints to ASCII (e.g. %x formatting) without
  * relying on heavyweight printf function.
@@ -30,8 +63,67 @@ static const char m_hex_to_ascii[16] = {
         '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
 };
 
+#if DUMP_FORMAT == DUMP_FORMAT_FRAMED
+/**
+ * The frame being filled by _DumpFramed(), before COBS encoding. The space
+ * for the sequence number is reserved at the start and filled when the frame
+ * is sent.
+ */
+static struct {
+    uint8_t     data[TRACE_FRAME_SEQ_SIZE + TRACE_FRAME_MAX_PAYLOAD + TRACE_FRAME_CRC_SIZE];
+    uint32_t    length;
+    uint32_t    num_entries;
+    uint32_t    open_entries[TRACE_FRAME_STACK_DEPTH];
+    uint32_t    num_open_entries;
+} m_frame;
+
+/**
+ * The sequence number of the next frame; the number of entries sent so far.
+ */
+static uint32_t m_frame_seq;
+#endif
+
+#if DUMP_FORMAT == DUMP_FORMAT_BASE64_TEXT
+/**
+ * Base64 alphabet (RFC 4648), indexed by 6-bit group.
+ */
+static const char m_base64_alphabet[64] = {
+        'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+        'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
+        'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+        'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'
+};
+
+/**
+ * The entries of the line being filled by _DumpBase64Text(), before encoding.
+ */
+static struct {
+    uint8_t     data[TRACE_BASE64_LINE_WORDS * sizeof(uint32_t)];
+    uint32_t    length;
+} m_base64_line;
+#endif
+
 /* Private function prototypes --------------------------------------------- */
+uint32_t _CopyRecord(uint32_t index, uint32_t num_slots);
 void _ConvertUint32ToHexString(uint32_t value, char * out_buffer);
+void _DumpHexText(uint32_t max_entries, bool (*deadline_reached)(void));
+void _DumpRawBinary(uint32_t max_entries, bool (*deadline_reached)(void));
+#if DUMP_FORMAT == DUMP_FORMAT_FRAMED
+void _DumpFramed(uint32_t max_entries, bool (*deadline_reached)(void));
+void _FrameStart(void);
+void _FrameAddEntry(uint32_t value);
+void _FrameSend(void);
+uint16_t _Crc16(const uint8_t * p_data, uint32_t length);
+uint32_t _CobsEncode(const uint8_t * p_data, uint32_t length, uint8_t * p_out);
+#endif
+#if DUMP_FORMAT == DUMP_FORMAT_BASE64_TEXT
+void _DumpBase64Text(uint32_t max_entries, bool (*deadline_reached)(void));
+void _Base64AddEntry(uint32_t value);
+void _Base64SendLine(void);
+uint32_t _Base64Encode(const uint8_t * p_data, uint32_t length, char * p_out);
+#endif
+void _AbandonUnpublishedSlots(void);
+bool _TakeEntriesLost(void);
 
 /* Public functions -------------------------------------------------------- */
 void TRACE_Init(ExecTraceCallbacks_t * p_callbacks)
@@ -41,46 +133,622 @@ void TRACE_Init(ExecTraceCallbacks_t * p_callbacks)
     if (m_exec_trace.magic != EXEC_TRACE_INIT_MAGIC)
     {
         m_exec_trace.reset_count = 0;
-        m_exec_trace.head = 0;
-        m_exec_trace.tail = 0;
+        TRACE_Clear();
         m_exec_trace.magic = EXEC_TRACE_INIT_MAGIC;
     }
     else
     {
         m_exec_trace.reset_count++;
+        _AbandonUnpublishedSlots();
+#if USE_TIMESTAMPS
+        /* The timestamp source likely restarted with the processor */
+        m_exec_trace.timestamp_count = 0;
+#endif
     }
     TRACE_ExecTracerVersion();
 }
 
+void TRACE_Clear(void)
+{
+    for (int i = 0; i < BUFFER_COMMIT_FLAG_WORDS; i++)
+    {
+        m_exec_trace.commit_flags[i] = 0;
+    }
+    m_exec_trace.head = 0;
+    m_exec_trace.tail = 0;
+    m_exec_trace.reserve = 0;
+    m_exec_trace.entries_lost = 0;
+#if USE_TIMESTAMPS
+    m_exec_trace.last_timestamp = 0;
+    m_exec_trace.timestamp_count = 0;
+#endif
+    m_get_record_length = 0;
+    m_get_record_pos = 0;
+}
+
+uint32_t TRACE_Get(void)
+{
+    uint32_t tail;
+    uint32_t head;
+    uint32_t num_slots;
+    uint32_t length;
+
+    if (m_get_record_pos < m_get_record_length)
+    {
+        return m_get_record[m_get_record_pos++];
+    }
+
+    tail = atomic_load(&m_exec_trace.tail);
+    do
+    {
+        head = atomic_load(&m_exec_trace.head);
+        if (tail == head)
+        {
+            m_get_record_length = 0;
+            m_get_record_pos = 0;
+            return 0;
+        }
+        num_slots = _TRACE_RecordLengthAt(tail, head);
+        length = _CopyRecord(tail, num_slots);
+        TRACE_PREEMPTION_POINT();
+        /* If an overwriting put discarded this record while it was being
+         * copied, tail has moved and the record at the new tail is copied
+         * instead. Only a claimed record may be returned from m_get_record,
+         * so its length is kept once the claim succeeds. */
+    } while (!_TRACE_CAS_WEAK(&m_exec_trace.tail, &tail, tail + num_slots));
+
+    m_get_record_length = length;
+    m_get_record_pos = 1;
+    return m_get_record[0];
+}
+
+uint32_t TRACE_GetNumEntries(void)
+{
+    return (m_get_record_length - m_get_record_pos) + _TRACE_GetNumBufferedSlots();
+}
+
+#if USE_TIMESTAMPS
+bool _TRACE_PutTimestampSync(uint32_t timestamp)
+{
+    uint32_t index;
+
+    if (!_TRACE_Reserve(2, &index))
+    {
+        return false;
+    }
+    TRACE_WriteRecord(index, 0,
+            ((uint32_t)TRACE_IDCODE_EXTENDED << TRACE_IDCODE_Pos) |
+            (1 << TRACE_EXT_LENGTH_Pos) |
+            (TRACE_EXT_TYPE_TIMESTAMP_SYNC << TRACE_EXT_TYPE_Pos));
+    TRACE_WriteRecord(index, 1, timestamp);
+    _TRACE_Commit(index, 2);
+    return true;
+}
+#endif
+
 void DumpExecTraceLog(void)
 {
-    static char out_buffer[] = "0x00000000\n";
-    uint32_t trace_value;
+    (void)DumpExecTraceLogBounded(DUMP_NO_LIMIT, NULL);
+}
+
+uint32_t DumpExecTraceLogBounded(uint32_t max_entries, bool (*deadline_reached)(void))
+{
+    uint32_t num_remaining;
 
     if (m_exec_trace_callbacks.lock)
     {
         m_exec_trace_callbacks.lock();
     }
 
-    if (TRACE_IsFull())
+#if DUMP_FORMAT == DUMP_FORMAT_RAW_BINARY
+    _DumpRawBinary(max_entries, deadline_reached);
+#elif DUMP_FORMAT == DUMP_FORMAT_FRAMED
+    _DumpFramed(max_entries, deadline_reached);
+#elif DUMP_FORMAT == DUMP_FORMAT_BASE64_TEXT
+    _DumpBase64Text(max_entries, deadline_reached);
+#else
+    _DumpHexText(max_entries, deadline_reached);
+#endif
+    num_remaining = TRACE_GetNumEntries();
+
+    if (m_exec_trace_callbacks.unlock)
+    {
+        m_exec_trace_callbacks.unlock();
+    }
+    return num_remaining;
+}
+
+#if RUNTIME_FILTER
+void TRACE_SetIdCodeMask(uint32_t mask)
+{
+    mask |= (1 << TRACE_IDCODE_VERSION) | (1 << TRACE_IDCODE_RESET);
+    atomic_store_explicit(&m_trace_filter.disabled_idcodes, ~mask, memory_order_relaxed);
+}
+
+uint32_t TRACE_GetIdCodeMask(void)
+{
+    return ~atomic_load_explicit(&m_trace_filter.disabled_idcodes, memory_order_relaxed);
+}
+
+void TRACE_SetModuleEnabled(uint32_t module, bool enabled)
+{
+    if (module == TRACE_ALL_MODULES)
+    {
+        for (uint32_t i = 0; i < ARRAY_SIZE(m_trace_filter.disabled_modules); i++)
+        {
+            atomic_store_explicit(&m_trace_filter.disabled_modules[i], enabled ? 0 : UINT32_MAX,
+                    memory_order_relaxed);
+        }
+    }
+    else if (enabled)
+    {
+        _TRACE_FETCH_AND(&m_trace_filter.disabled_modules[(module & TRACE_MODULE_MAX) / 32],
+                ~(1UL << (module % 32)));
+    }
+    else
+    {
+        _TRACE_FETCH_OR(&m_trace_filter.disabled_modules[(module & TRACE_MODULE_MAX) / 32],
+                1UL << (module % 32));
+    }
+}
+
+bool TRACE_IsModuleEnabled(uint32_t module)
+{
+    return _TRACE_IS_MODULE_ENABLED(module);
+}
+#endif
+
+#if INSTRUMENT_FUNCTIONS
+void __cyg_profile_func_enter(void * this_fn, void * call_site)
+{
+    (void)call_site;
+    TRACE_FunctionEntry(this_fn);
+}
+
+void __cyg_profile_func_exit(void * this_fn, void * call_site)
+{
+    (void)call_site;
+    TRACE_FunctionExit(this_fn);
+}
+#endif
+
+/* Private functions ------------------------------------------------------- */
+/**
+ * A reset may occur in the middle of a put. Slots that were claimed but not
+ * yet published are given back, and their commit flags are returned to the
+ * uncommitted state so that they aren't published before being written again.
+ */
+void _AbandonUnpublishedSlots(void)
+{
+    uint32_t head = m_exec_trace.head;
+    uint32_t reserve = m_exec_trace.reserve;
+
+    if (((reserve - head) > BUFFER_MAX_CAPACITY) ||
+        ((head - m_exec_trace.tail) > BUFFER_MAX_CAPACITY))
+    {
+        /* Control structure is not consistent; Start over */
+        TRACE_Clear();
+        return;
+    }
+
+    for (uint32_t index = head; index != reserve; index++)
+    {
+        if (_TRACE_IsCommitted(index))
+        {
+            m_exec_trace.commit_flags[(index & BUFFER_INDEX_MASK) / 32] ^=
+                    1UL << ((index & BUFFER_INDEX_MASK) % 32);
+        }
+    }
+    if (reserve != head)
+    {
+        /* The records being traced at the reset are lost */
+        m_exec_trace.entries_lost = 1;
+    }
+    m_exec_trace.reserve = head;
+}
+
+/**
+ * Whether the next dump must start with a BUFFER_FULL entry: the buffer is
+ * full, or an entry was dropped or overwritten since the last dump. Clears
+ * the record of lost entries, so each loss is reported once.
+ */
+bool _TakeEntriesLost(void)
+{
+    bool entries_lost = (_TRACE_EXCHANGE(&m_exec_trace.entries_lost, 0) != 0);
+    return entries_lost || TRACE_IsFull();
+}
+
+/**
+ * Copy the record in num_slots slots starting at index to m_get_record.
+ * With COMPACT_ENCODING, halfword entries are expanded to full words.
+ * Returns the record's length in words.
+ */
+uint32_t _CopyRecord(uint32_t index, uint32_t num_slots)
+{
+#if COMPACT_ENCODING
+    uint16_t slot = m_exec_trace.trace_buffer[index & BUFFER_INDEX_MASK];
+
+    if (slot != TRACE_COMPACT_ESCAPE)
+    {
+        m_get_record[0] =
+                ((uint32_t)((slot & TRACE_COMPACT_EXIT_Msk) ?
+                        TRACE_IDCODE_FUNC_EXIT : TRACE_IDCODE_FUNC_ENTRY) << TRACE_IDCODE_Pos) |
+                ((uint32_t)(slot & TRACE_COMPACT_OFFSET_Msk) << (TRACE_DATA_Pos + 1));
+        return 1;
+    }
+    for (uint32_t i = 0; i < (num_slots - 1) / 2; i++)
+    {
+        m_get_record[i] = _TRACE_ReadWord(index + 1 + 2 * i);
+    }
+    return (num_slots - 1) / 2;
+#else
+    for (uint32_t i = 0; i < num_slots; i++)
+    {
+        m_get_record[i] = m_exec_trace.trace_buffer[(index + i) & BUFFER_INDEX_MASK];
+    }
+    return num_slots;
+#endif
+}
+
+void _DumpHexText(uint32_t max_entries, bool (*deadline_reached)(void))
+{
+    static char out_buffer[] = "0x00000000\n";
+    uint32_t trace_value;
+
+    if (_TakeEntriesLost())
     {
         memset(&out_buffer[2], m_hex_to_ascii[TRACE_IDCODE_BUFFER_FULL], 8);
         m_exec_trace_callbacks.write((uint8_t*)out_buffer, 11);
     }
-    while (!TRACE_IsEmpty())
+    for (; (max_entries > 0) && !TRACE_IsEmpty(); max_entries--)
     {
+        if (deadline_reached && deadline_reached())
+        {
+            break;
+        }
         trace_value = TRACE_Get();
         _ConvertUint32ToHexString(trace_value, &out_buffer[2]);
         m_exec_trace_callbacks.write((uint8_t*)out_buffer, 11);
     }
+}
+
+void _DumpRawBinary(uint32_t max_entries, bool (*deadline_reached)(void))
+{
+#if COMPACT_ENCODING
+    static uint16_t buffer_full_value[] = {TRACE_COMPACT_ESCAPE, 0xFFFF, 0xFFFF};
+#else
+    static uint32_t buffer_full_value[] = {
+            ((uint32_t)TRACE_IDCODE_BUFFER_FULL << TRACE_IDCODE_Pos) | TRACE_DATA_Msk
+    };
+#endif
+    uint32_t head;
+    uint32_t tail;
+    uint32_t end;
+    uint32_t index;
+    uint32_t end_index;
+    bool entries_lost;
+
+    /* Both spans are written back to back, so the deadline can only be
+     * honored before starting. */
+    if (deadline_reached && deadline_reached())
+    {
+        return;
+    }
+    entries_lost = _TakeEntriesLost();
 
-    if (m_exec_trace_callbacks.unlock)
+    /* Finish any record that was partly returned by TRACE_Get(). The rest of
+     * a record can't be framed in the compact format, so it is dropped, and
+     * the loss is flagged like a full buffer. */
+    if (m_get_record_pos < m_get_record_length)
     {
-        m_exec_trace_callbacks.unlock();
+#if COMPACT_ENCODING
+        entries_lost = true;
+#else
+        m_exec_trace_callbacks.write((uint8_t*)&m_get_record[m_get_record_pos],
+                (m_get_record_length - m_get_record_pos) * sizeof(uint32_t));
+#endif
+    }
+    m_get_record_pos = m_get_record_length;
+
+    if (entries_lost)
+    {
+        m_exec_trace_callbacks.write((uint8_t*)buffer_full_value, sizeof(buffer_full_value));
+    }
+
+    /* Take a snapshot of head so that entries traced while writing to the
+     * backend are left for the next dump. */
+    tail = atomic_load(&m_exec_trace.tail);
+    head = atomic_load(&m_exec_trace.head);
+
+    /* Stop at the last whole record within the budget, but always make
+     * progress by writing at least one record. */
+    end = tail;
+    while (end != head)
+    {
+        uint32_t length = _TRACE_RecordLengthAt(end, head);
+        if ((end != tail) && (length > max_entries))
+        {
+            break;
+        }
+        max_entries = (length < max_entries) ? (max_entries - length) : 0;
+        end += length;
+    }
+    head = end;
+
+    index = tail & BUFFER_INDEX_MASK;
+    end_index = head & BUFFER_INDEX_MASK;
+    if ((head != tail) && (end_index <= index))
+    {
+        /* First span runs from tail to the end of the buffer */
+        m_exec_trace_callbacks.write((uint8_t*)&m_exec_trace.trace_buffer[index],
+                (BUFFER_LENGTH_IN_SLOTS - index) * sizeof(TraceSlot_t));
+        index = 0;
+    }
+    if (end_index > index)
+    {
+        m_exec_trace_callbacks.write((uint8_t*)&m_exec_trace.trace_buffer[index],
+                (end_index - index) * sizeof(TraceSlot_t));
+    }
+
+    if (!_TRACE_CAS_STRONG(&m_exec_trace.tail, &tail, head))
+    {
+        /* An overwriting put discarded entries while they were being written,
+         * so any of the words just written may have been replaced with newer
+         * entries. There's no telling which, so flag the whole dump as
+         * suspect and skip what was written. See DumpExecTraceLog(). This
+         * reports the entries those puts discarded. */
+        m_exec_trace_callbacks.write((uint8_t*)buffer_full_value, sizeof(buffer_full_value));
+        atomic_store(&m_exec_trace.entries_lost, 0);
+        while (((int32_t)(head - tail) > 0) &&
+                !_TRACE_CAS_WEAK(&m_exec_trace.tail, &tail, head))
+        {
+        }
     }
 }
 
-/* Private functions ------------------------------------------------------- */
+#if DUMP_FORMAT == DUMP_FORMAT_FRAMED
+void _DumpFramed(uint32_t max_entries, bool (*deadline_reached)(void))
+{
+    uint32_t length;
+
+    /* The rest of a record that was partly returned by TRACE_Get() can't be
+     * told apart from a record header by the reader, so it is dropped. */
+    m_get_record_pos = m_get_record_length;
+
+    _FrameStart();
+    if (_TakeEntriesLost())
+    {
+        _FrameAddEntry(((uint32_t)TRACE_IDCODE_BUFFER_FULL << TRACE_IDCODE_Pos) | TRACE_DATA_Msk);
+    }
+    while ((max_entries > 0) && !TRACE_IsEmpty())
+    {
+        if (deadline_reached && deadline_reached())
+        {
+            break;
+        }
+        /* Claims the whole record; Its other words are in m_get_record */
+        (void)TRACE_Get();
+        length = m_get_record_length;
+        if (length == 0)
+        {
+            /* Emptied by an overwriting put between the checks */
+            break;
+        }
+        if (m_frame.length + length * TRACE_FRAME_MAX_TOKEN_SIZE >
+                TRACE_FRAME_SEQ_SIZE + TRACE_FRAME_MAX_PAYLOAD)
+        {
+            _FrameSend();
+            _FrameStart();
+        }
+        _FrameAddEntry(m_get_record[0]);
+        while (m_get_record_pos < m_get_record_length)
+        {
+            _FrameAddEntry(m_get_record[m_get_record_pos++]);
+        }
+        max_entries = (length < max_entries) ? (max_entries - length) : 0;
+    }
+    if (m_frame.num_entries > 0)
+    {
+        _FrameSend();
+    }
+}
+
+void _FrameStart(void)
+{
+    m_frame.length = TRACE_FRAME_SEQ_SIZE;
+    m_frame.num_entries = 0;
+    m_frame.num_open_entries = 0;
+}
+
+void _FrameAddEntry(uint32_t value)
+{
+    uint32_t idcode = (value & TRACE_IDCODE_Msk) >> TRACE_IDCODE_Pos;
+    uint32_t offset = value & TRACE_DATA_Msk;
+    uint64_t token;
+    uint8_t byte;
+
+    if ((idcode == TRACE_IDCODE_FUNC_EXIT) && (m_frame.num_open_entries > 0) &&
+        (m_frame.open_entries[m_frame.num_open_entries - 1] == offset))
+    {
+        m_frame.num_open_entries--;
+        token = TRACE_FRAME_TOKEN_EXIT;
+    }
+    else
+    {
+        if ((idcode == TRACE_IDCODE_FUNC_ENTRY) && (m_frame.num_open_entries < TRACE_FRAME_STACK_DEPTH))
+        {
+            m_frame.open_entries[m_frame.num_open_entries++] = offset;
+        }
+        token = ((uint64_t)((value << 4) | (value >> 28)) << 1) | 1;
+    }
+
+    do
+    {
+        byte = token & 0x7F;
+        token >>= 7;
+        m_frame.data[m_frame.length++] = byte | (token ? 0x80 : 0);
+    } while (token);
+    m_frame.num_entries++;
+}
+
+void _FrameSend(void)
+{
+    /* COBS adds one byte per 254, plus the delimiter */
+    static uint8_t out_buffer[sizeof(m_frame.data) + 2];
+    uint16_t crc;
+    uint32_t out_length;
+
+    for (uint32_t i = 0; i < TRACE_FRAME_SEQ_SIZE; i++)
+    {
+        m_frame.data[i] = (uint8_t)(m_frame_seq >> (8 * i));
+    }
+    crc = _Crc16(m_frame.data, m_frame.length);
+    m_frame.data[m_frame.length++] = (uint8_t)crc;
+    m_frame.data[m_frame.length++] = (uint8_t)(crc >> 8);
+
+    out_length = _CobsEncode(m_frame.data, m_frame.length, out_buffer);
+    out_buffer[out_length++] = TRACE_FRAME_DELIMITER;
+    m_exec_trace_callbacks.write(out_buffer, out_length);
+    m_frame_seq += m_frame.num_entries;
+}
+
+/**
+ * CRC-16/CCITT-FALSE, computed bitwise; Frames are short and dumping is
+ * not time critical, so a lookup table isn't worth the flash.
+ */
+uint16_t _Crc16(const uint8_t * p_data, uint32_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)p_data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * Consistent overhead byte stuffing: Encode length bytes from p_data to
+ * p_out so that the result contains no zero bytes.
+ * Returns the encoded length (at most length + 1 + length / 254).
+ */
+uint32_t _CobsEncode(const uint8_t * p_data, uint32_t length, uint8_t * p_out)
+{
+    uint32_t code_index = 0;
+    uint32_t out_index = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (p_data[i] == 0)
+        {
+            p_out[code_index] = code;
+            code_index = out_index++;
+            code = 1;
+        }
+        else
+        {
+            p_out[out_index++] = p_data[i];
+            if (++code == 0xFF)
+            {
+                p_out[code_index] = code;
+                code_index = out_index++;
+                code = 1;
+            }
+        }
+    }
+    p_out[code_index] = code;
+    return out_index;
+}
+#endif
+
+#if DUMP_FORMAT == DUMP_FORMAT_BASE64_TEXT
+void _DumpBase64Text(uint32_t max_entries, bool (*deadline_reached)(void))
+{
+    m_base64_line.length = 0;
+    if (_TakeEntriesLost())
+    {
+        _Base64AddEntry(((uint32_t)TRACE_IDCODE_BUFFER_FULL << TRACE_IDCODE_Pos) | TRACE_DATA_Msk);
+    }
+    for (; (max_entries > 0) && !TRACE_IsEmpty(); max_entries--)
+    {
+        if (deadline_reached && deadline_reached())
+        {
+            break;
+        }
+        _Base64AddEntry(TRACE_Get());
+    }
+    if (m_base64_line.length > 0)
+    {
+        _Base64SendLine();
+    }
+}
+
+void _Base64AddEntry(uint32_t value)
+{
+    uint8_t * p_data = &m_base64_line.data[m_base64_line.length];
+
+    p_data[0] = (uint8_t)value;
+    p_data[1] = (uint8_t)(value >> 8);
+    p_data[2] = (uint8_t)(value >> 16);
+    p_data[3] = (uint8_t)(value >> 24);
+    m_base64_line.length += sizeof(uint32_t);
+    if (m_base64_line.length == sizeof(m_base64_line.data))
+    {
+        _Base64SendLine();
+        m_base64_line.length = 0;
+    }
+}
+
+void _Base64SendLine(void)
+{
+    /* 4 characters per 3 bytes, plus the line start and end */
+    static char out_buffer[sizeof(m_base64_line.data) / 3 * 4 + 2];
+    uint32_t out_length;
+
+    out_buffer[0] = TRACE_BASE64_LINE_START;
+    out_length = 1 + _Base64Encode(m_base64_line.data, m_base64_line.length, &out_buffer[1]);
+    out_buffer[out_length++] = '\n';
+    m_exec_trace_callbacks.write((uint8_t*)out_buffer, out_length);
+}
+
+/**
+ * Encode length bytes from p_data to p_out as base64, padded with '='.
+ * Returns the encoded length (4 characters per 3 bytes, rounded up).
+ */
+uint32_t _Base64Encode(const uint8_t * p_data, uint32_t length, char * p_out)
+{
+    char * p_start = p_out;
+    uint32_t group;
+
+    for (; length >= 3; length -= 3, p_data += 3)
+    {
+        group = ((uint32_t)p_data[0] << 16) | ((uint32_t)p_data[1] << 8) | p_data[2];
+        *p_out++ = m_base64_alphabet[group >> 18];
+        *p_out++ = m_base64_alphabet[(group >> 12) & 0x3F];
+        *p_out++ = m_base64_alphabet[(group >> 6) & 0x3F];
+        *p_out++ = m_base64_alphabet[group & 0x3F];
+    }
+    if (length > 0)
+    {
+        group = (uint32_t)p_data[0] << 16;
+        if (length > 1)
+        {
+            group |= (uint32_t)p_data[1] << 8;
+        }
+        *p_out++ = m_base64_alphabet[group >> 18];
+        *p_out++ = m_base64_alphabet[(group >> 12) & 0x3F];
+        *p_out++ = (length > 1) ? m_base64_alphabet[(group >> 6) & 0x3F] : '=';
+        *p_out++ = '=';
+    }
+    return (uint32_t)(p_out - p_start);
+}
+#endif
+
 void _ConvertUint32ToHexString(uint32_t value, char * out_buffer)
 {
     char * p_out = out_buffer;
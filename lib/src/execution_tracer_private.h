@@ -18,5 +18,6 @@
 #endif
 
 #define IS_POWER_OF_2(n)        ((n & (n - 1)) == 0)
+#define ARRAY_SIZE(a)           (sizeof(a) / sizeof((a)[0]))
 
 #endif /* LIB_SRC_EXECUTION_TRACER_PRIVATE_H_ */
@@ -18,5 +18,48 @@
 #define USE_NOINIT_RAM_FOR_TRACING      CONFIG_USE_NO_INIT
 #define ALLOW_OVERWRITE                 CONFIG_ALLOW_OVERWRITE
 #define BUFFER_LENGTH_IN_WORDS          CONFIG_BUFFER_LENGTH
+#define DUMP_FORMAT                     CONFIG_DUMP_FORMAT
+#define COMPACT_ENCODING                CONFIG_COMPACT_ENCODING
+#define USE_TIMESTAMPS                  CONFIG_USE_TIMESTAMPS
+#define TIMESTAMP_SYNC_INTERVAL         CONFIG_TIMESTAMP_SYNC_INTERVAL
+
+/* Timestamp tests provide a fake timestamp source */
+#if CONFIG_USE_TIMESTAMPS
+uint32_t fake_GetTimestamp(void);
+#define TRACE_GET_TIMESTAMP()           fake_GetTimestamp()
+#endif
+
+/* Runtime filter tests turn the filter on */
+#ifdef CONFIG_RUNTIME_FILTER
+#define RUNTIME_FILTER                  1
+#endif
+
+/* Compile-time filter tests compile some trace points out */
+#ifdef CONFIG_TRACE_LEVEL
+#define TRACE_LEVEL                     CONFIG_TRACE_LEVEL
+#endif
+#ifdef CONFIG_COMPILED_IDCODES
+#define TRACE_COMPILED_IDCODES          CONFIG_COMPILED_IDCODES
+#endif
+
+/* Instrumentation tests call the -finstrument-functions hooks directly */
+#ifdef CONFIG_INSTRUMENT_FUNCTIONS
+#define INSTRUMENT_FUNCTIONS            1
+#endif
+
+/* Critical section tests use the put path of cores without lock-free atomics */
+#ifdef CONFIG_CRITICAL_SECTION
+void fake_EnterCritical(void);
+void fake_ExitCritical(void);
+#define TRACE_LOCK_FREE                 0
+#define TRACE_ENTER_CRITICAL()          fake_EnterCritical()
+#define TRACE_EXIT_CRITICAL()           fake_ExitCritical()
+#endif
+
+/* Stress tests force context switches inside the put path */
+#ifdef CONFIG_STRESS_PREEMPTION
+void stress_PreemptionPoint(void);
+#define TRACE_PREEMPTION_POINT()        stress_PreemptionPoint()
+#endif
 
 #endif /* LIB_INCLUDE_EXECUTION_TRACER_CONF_H_ */
@@ -0,0 +1,158 @@
+/*
+ * stress_helpers.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "stress_helpers.h"
+
+typedef struct {
+    int         producer_num;
+    uint32_t    num_entries;
+    bool        throttle;
+} ProducerArgs_t;
+
+static atomic_int m_producers_running;
+static _Thread_local uint32_t m_preemption_count;
+
+void stress_PreemptionPoint(void)
+{
+    /* Yield at an irregular interval so that threads don't fall into step */
+    m_preemption_count++;
+    if (((m_preemption_count * 2654435761U) >> 28) == 0)
+    {
+        sched_yield();
+    }
+}
+
+static void * producer_thread(void * arg)
+{
+    ProducerArgs_t * p_args = (ProducerArgs_t *)arg;
+    uint32_t producer_bits = (uint32_t)p_args->producer_num << STRESS_PRODUCER_Pos;
+
+    for (uint32_t seq = 0; seq < p_args->num_entries; seq++)
+    {
+        if (p_args->throttle)
+        {
+            /* Leave room for every producer to have one put in progress.
+             * Claimed slots count against capacity even before they're published. */
+            for (;;)
+            {
+                uint32_t tail = atomic_load(&m_exec_trace.tail);
+                if ((atomic_load(&m_exec_trace.reserve) - tail) <
+                        (BUFFER_MAX_CAPACITY - 2 * STRESS_MAX_PRODUCERS))
+                {
+                    break;
+                }
+                sched_yield();
+            }
+        }
+        if (seq & 1)
+        {
+            uint32_t header = ((uint32_t)TRACE_IDCODE_VARIABLE_VALUE << TRACE_IDCODE_Pos) |
+                    producer_bits | seq;
+            TRACE_PutRecord2(header, ~header);
+        }
+        else
+        {
+            TRACE_Put(producer_bits | seq);
+        }
+    }
+
+    atomic_fetch_sub(&m_producers_running, 1);
+    return NULL;
+}
+
+static void check_value(uint32_t value, int num_producers, uint32_t entries_per_producer,
+        int64_t * p_last_seq, StressResults_t * p_results)
+{
+    int producer_num = (int)((value & STRESS_PRODUCER_Msk) >> STRESS_PRODUCER_Pos);
+    int64_t seq = value & STRESS_SEQUENCE_Msk;
+
+    p_results->num_received++;
+    if ((value >> TRACE_IDCODE_Pos) == TRACE_IDCODE_VARIABLE_VALUE)
+    {
+        /* The payload must be next, even if the rest of the buffer was
+         * overwritten since the header was read */
+        if (TRACE_Get() != ~value)
+        {
+            p_results->num_torn_records++;
+        }
+    }
+    else if ((value >> TRACE_IDCODE_Pos) != 0)
+    {
+        p_results->num_invalid++;
+        return;
+    }
+    if ((producer_num < 1) || (producer_num > num_producers) || (seq >= entries_per_producer))
+    {
+        p_results->num_invalid++;
+        return;
+    }
+
+    int64_t * p_last = &p_last_seq[producer_num - 1];
+    if (seq == *p_last)
+    {
+        p_results->num_duplicated++;
+    }
+    else if (seq < *p_last)
+    {
+        p_results->num_out_of_order++;
+    }
+    else
+    {
+        p_results->num_missing += (uint32_t)(seq - *p_last - 1);
+        *p_last = seq;
+    }
+}
+
+void stress_RunProducersAndConsumer(int num_producers, uint32_t entries_per_producer,
+        bool throttle, StressResults_t * p_results)
+{
+    pthread_t threads[STRESS_MAX_PRODUCERS];
+    ProducerArgs_t args[STRESS_MAX_PRODUCERS];
+    int64_t last_seq[STRESS_MAX_PRODUCERS];
+    uint32_t value;
+
+    TEST_ASSERT_TRUE(num_producers <= STRESS_MAX_PRODUCERS);
+    TEST_ASSERT_TRUE(entries_per_producer <= STRESS_SEQUENCE_Msk);
+    memset(p_results, 0, sizeof(*p_results));
+
+    atomic_store(&m_producers_running, num_producers);
+    for (int i = 0; i < num_producers; i++)
+    {
+        last_seq[i] = -1;
+        args[i].producer_num = i + 1;
+        args[i].num_entries = entries_per_producer;
+        args[i].throttle = throttle;
+        TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, producer_thread, &args[i]));
+    }
+
+    /* Drain until all producers are done and everything they put is read */
+    for (;;)
+    {
+        bool producers_done = (atomic_load(&m_producers_running) == 0);
+        value = TRACE_Get();
+        if (value != 0)
+        {
+            check_value(value, num_producers, entries_per_producer, last_seq, p_results);
+        }
+        else if (producers_done)
+        {
+            break;
+        }
+    }
+
+    for (int i = 0; i < num_producers; i++)
+    {
+        pthread_join(threads[i], NULL);
+        /* Entries lost from the end of a sequence are missing too */
+        p_results->num_missing += (uint32_t)(entries_per_producer - 1 - last_seq[i]);
+    }
+}
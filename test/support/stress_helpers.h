@@ -0,0 +1,54 @@
+/*
+ * stress_helpers.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef TEST_SUPPORT_STRESS_HELPERS_H_
+#define TEST_SUPPORT_STRESS_HELPERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STRESS_MAX_PRODUCERS            8
+
+/**
+ * Stress test entries encode the producer number in bits 27:24 and a
+ * per-producer sequence number in the bottom 24 bits. Producer numbers start
+ * at 1 so that no entry is ever zero.
+ * Odd sequence numbers are traced as two-word records: the entry with a
+ * variable value ID code as the header, followed by its inverse.
+ */
+#define STRESS_PRODUCER_Pos             (24U)
+#define STRESS_PRODUCER_Msk             (0xF << STRESS_PRODUCER_Pos)
+#define STRESS_SEQUENCE_Msk             (0xFFFFFF)
+
+typedef struct {
+    uint32_t    num_received;
+    uint32_t    num_invalid;        /**< Values that no producer wrote */
+    uint32_t    num_duplicated;     /**< Values received more than once */
+    uint32_t    num_out_of_order;   /**< Values older than a value already received */
+    uint32_t    num_missing;        /**< Gaps in a producer's sequence */
+    uint32_t    num_torn_records;   /**< Record headers not followed by their payload */
+} StressResults_t;
+
+/**
+ * @brief       Called by TRACE_PREEMPTION_POINT() inside the put path.
+ *              Occasionally yields so that, even on a single core, other
+ *              producers and the consumer run in the middle of a put.
+ */
+void stress_PreemptionPoint(void);
+
+/**
+ * @brief       Run producer threads that trace entries and records as fast as possible
+ *              while the calling thread drains the buffer with TRACE_Get().
+ * @param       num_producers Number of producer threads.
+ * @param       entries_per_producer Number of entries each producer traces.
+ * @param       throttle When true, producers wait for room in the buffer
+ *              before each put so that no entry is dropped for being full.
+ * @param       p_results Receives the consumer's accounting of all entries.
+ */
+void stress_RunProducersAndConsumer(int num_producers, uint32_t entries_per_producer,
+        bool throttle, StressResults_t * p_results);
+
+#endif /* TEST_SUPPORT_STRESS_HELPERS_H_ */
@@ -0,0 +1,219 @@
+/*
+ * test_compact_encoding.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include <string.h>
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Private macros ---------------------------------------------------------- */
+#define MAX_WRITES          4
+
+#define FUNC_ENTRY(offset)  (((uint32_t)TRACE_IDCODE_FUNC_ENTRY << TRACE_IDCODE_Pos) | (offset))
+#define FUNC_EXIT(offset)   (((uint32_t)TRACE_IDCODE_FUNC_EXIT << TRACE_IDCODE_Pos) | (offset))
+
+#define TEST_VALUE_1        0x11111111
+#define TEST_VALUE_2        0x22222222
+
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
+/* Private variables ------------------------------------------------------- */
+static int        m_num_writes;
+static uint16_t   m_written_values[BUFFER_LENGTH_IN_SLOTS + 3];
+static int        m_num_written_values;
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    m_num_writes = 0;
+    m_num_written_values = 0;
+    TRACE_Clear();
+}
+
+void tearDown(void)
+{
+}
+
+/* Helper functions -------------------------------------------------------- */
+void write(uint8_t * p_data, uint16_t size)
+{
+    TEST_ASSERT_TRUE(m_num_writes < MAX_WRITES);
+    TEST_ASSERT_EQUAL(0, size % sizeof(uint16_t));
+    m_num_writes++;
+    memcpy(&m_written_values[m_num_written_values], p_data, size);
+    m_num_written_values += size / sizeof(uint16_t);
+}
+ExecTraceCallbacks_t test_callbacks = {
+        .write = write,
+        .lock = NULL,
+        .unlock = NULL
+};
+
+/* Test functions ---------------------------------------------------------- */
+void test_FunctionEntryAndExitTakeOneSlot(void)
+{
+    TRACE_Put(FUNC_ENTRY(0x1234));
+    TRACE_Put(FUNC_EXIT(0xFFFC));
+    TEST_ASSERT_EQUAL_UINT32(2, m_exec_trace.head);
+    TEST_ASSERT_EQUAL_HEX16(0x1234 >> 1, m_exec_trace.trace_buffer[0]);
+    TEST_ASSERT_EQUAL_HEX16(TRACE_COMPACT_EXIT_Msk | (0xFFFC >> 1), m_exec_trace.trace_buffer[1]);
+
+    TEST_ASSERT_EQUAL_HEX32(FUNC_ENTRY(0x1234), TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(FUNC_EXIT(0xFFFC), TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_ThumbBitIsNotKept(void)
+{
+    TRACE_Put(FUNC_ENTRY(0x1235));
+    TEST_ASSERT_EQUAL_HEX32(FUNC_ENTRY(0x1234), TRACE_Get());
+}
+
+void test_OtherEntriesAreEscaped(void)
+{
+    TRACE_Put(TEST_VALUE_1);
+    /* Beyond the offsets a halfword can hold */
+    TRACE_Put(FUNC_ENTRY(0x10000));
+    TEST_ASSERT_EQUAL_UINT32(6, m_exec_trace.head);
+    TEST_ASSERT_EQUAL_HEX16(TRACE_COMPACT_ESCAPE, m_exec_trace.trace_buffer[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x1111, m_exec_trace.trace_buffer[1]);
+    TEST_ASSERT_EQUAL_HEX16(0x1111, m_exec_trace.trace_buffer[2]);
+
+    TEST_ASSERT_EQUAL_HEX32(TEST_VALUE_1, TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(FUNC_ENTRY(0x10000), TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RecordIsEscapedAndReadWhole(void)
+{
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_2);
+    TEST_ASSERT_EQUAL_UINT32(5, m_exec_trace.head);
+
+    TEST_ASSERT_EQUAL_HEX32(TEST_RECORD_HEADER, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(0, _TRACE_GetNumBufferedSlots());
+    TEST_ASSERT_EQUAL_HEX32(TEST_VALUE_2, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_BufferHoldsTwiceAsManyFunctionTraces(void)
+{
+    for (uint32_t i = 0; i < 2 * BUFFER_LENGTH_IN_WORDS - 1; i++)
+    {
+        TRACE_Put(FUNC_ENTRY(i * 2));
+    }
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.tail);
+
+    for (uint32_t i = 0; i < 2 * BUFFER_LENGTH_IN_WORDS - 1; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(FUNC_ENTRY(i * 2), TRACE_Get());
+    }
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_OverwriteDiscardsEscapedEntryWhole(void)
+{
+    TRACE_Put(TEST_VALUE_1);
+    for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY - 3; i++)
+    {
+        TRACE_Put(FUNC_EXIT(0x100));
+    }
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+
+    /* All three slots of the escaped entry are freed */
+    TRACE_Put(FUNC_ENTRY(0x200));
+    TEST_ASSERT_EQUAL_UINT32(3, m_exec_trace.tail);
+
+    for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY - 3; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(FUNC_EXIT(0x100), TRACE_Get());
+    }
+    TEST_ASSERT_EQUAL_HEX32(FUNC_ENTRY(0x200), TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RawDumpWritesHalfwords(void)
+{
+    uint16_t expected_values[] = {
+            0x0010 >> 1,
+            TRACE_COMPACT_ESCAPE, 0x1111, 0x1111,
+            TRACE_COMPACT_EXIT_Msk | (0x0010 >> 1),
+    };
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(FUNC_ENTRY(0x10));
+    TRACE_Put(TEST_VALUE_1);
+    TRACE_Put(FUNC_EXIT(0x10));
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(1, m_num_writes);
+    TEST_ASSERT_EQUAL(5, m_num_written_values);
+    TEST_ASSERT_EQUAL_HEX16_ARRAY(expected_values, m_written_values, 5);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RawDumpBufferFullIndicationIsEscaped(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    for (uint32_t i = 0; i < BUFFER_MAX_CAPACITY; i++)
+    {
+        TRACE_Put(FUNC_ENTRY(0x20));
+    }
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(BUFFER_MAX_CAPACITY + 3, m_num_written_values);
+    TEST_ASSERT_EQUAL_HEX16(TRACE_COMPACT_ESCAPE, m_written_values[0]);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, m_written_values[1]);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, m_written_values[2]);
+    TEST_ASSERT_EQUAL_HEX16(0x20 >> 1, m_written_values[3]);
+}
+
+void test_RawDumpFlagsRestOfPartlyReadRecord(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_2);
+    TRACE_Put(FUNC_ENTRY(0x20));
+    TEST_ASSERT_EQUAL_HEX32(TEST_RECORD_HEADER, TRACE_Get());
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(4, m_num_written_values);
+    TEST_ASSERT_EQUAL_HEX16(TRACE_COMPACT_ESCAPE, m_written_values[0]);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, m_written_values[1]);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, m_written_values[2]);
+    TEST_ASSERT_EQUAL_HEX16(0x20 >> 1, m_written_values[3]);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RawDumpFlagsOverwriteThatLeavesSlotsFree(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+
+    /* Discarding a three-slot escaped entry to make room for a one-slot
+     * function trace leaves two slots free */
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        TRACE_Put(FUNC_ENTRY(0x20));
+        TRACE_Put(TEST_VALUE_1);
+    }
+    TRACE_Put(FUNC_EXIT(0x20));
+    TEST_ASSERT_FALSE(TRACE_IsFull());
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(3 + BUFFER_MAX_CAPACITY - 2, m_num_written_values);
+    TEST_ASSERT_EQUAL_HEX16(TRACE_COMPACT_ESCAPE, m_written_values[0]);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, m_written_values[1]);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, m_written_values[2]);
+    TEST_ASSERT_EQUAL_HEX16(TRACE_COMPACT_EXIT_Msk | (0x20 >> 1),
+            m_written_values[m_num_written_values - 1]);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
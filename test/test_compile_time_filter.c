@@ -0,0 +1,117 @@
+/*
+ * test_compile_time_filter.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include <string.h>
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Private macros ---------------------------------------------------------- */
+#define TRACE_MODULE        1
+
+/* Private variables ------------------------------------------------------- */
+uint32_t compiledOutVariable = 0x12345678;
+static int m_num_evaluations;
+
+/*
+ * GNU ld defines __start_ and __stop_ symbols around sections with C
+ * identifier names, which gives the size of the one function in each.
+ */
+extern const uint8_t __start_trace_compiled_out[];
+extern const uint8_t __stop_trace_compiled_out[];
+extern const uint8_t __start_trace_not_traced[];
+extern const uint8_t __stop_trace_not_traced[];
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    TRACE_Clear();
+    m_num_evaluations = 0;
+}
+
+void tearDown(void)
+{
+}
+
+/* Helper functions -------------------------------------------------------- */
+uint32_t * countedPointer(void)
+{
+    m_num_evaluations++;
+    return &compiledOutVariable;
+}
+
+/*
+ * The same loop with trace points that this configuration compiles out, and
+ * without any. Compiled out trace points must leave identical machine code.
+ */
+__attribute__((section("trace_compiled_out"), noinline))
+uint32_t compiledOutLoop(const uint32_t * p_values, uint32_t num_values)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < num_values; i++)
+    {
+        TRACE_VariableValue(p_values[i]);
+        TRACE_SFRValue(sum);
+        sum += p_values[i];
+        TRACE_FunctionExit(compiledOutLoop);
+    }
+    return sum;
+}
+
+__attribute__((section("trace_not_traced"), noinline))
+uint32_t notTracedLoop(const uint32_t * p_values, uint32_t num_values)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < num_values; i++)
+    {
+        sum += p_values[i];
+    }
+    return sum;
+}
+
+/* Test functions ---------------------------------------------------------- */
+void test_CompiledOutTracePointsLeaveNoCode(void)
+{
+    size_t compiledOutSize = (size_t)(__stop_trace_compiled_out - __start_trace_compiled_out);
+    size_t notTracedSize = (size_t)(__stop_trace_not_traced - __start_trace_not_traced);
+    const uint32_t values[] = { 1, 2, 3 };
+
+    TEST_ASSERT_EQUAL_UINT32(notTracedSize, compiledOutSize);
+    TEST_ASSERT_EQUAL_MEMORY(__start_trace_not_traced, __start_trace_compiled_out, notTracedSize);
+    TEST_ASSERT_EQUAL_UINT32(6, compiledOutLoop(values, 3));
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_CompiledOutTracePointsDoNotEvaluateArguments(void)
+{
+    TRACE_VariableValue(*countedPointer());
+    TRACE_SFRValue(*countedPointer());
+    TRACE_FunctionExit(countedPointer());
+    TEST_ASSERT_EQUAL(0, m_num_evaluations);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_TracePointsWithinLevelAndMaskAreTraced(void)
+{
+    TRACE_Line(TRACE_MODULE);
+    helper_VerifyLineTrace(TRACE_MODULE, __LINE__ - 1);
+    TRACE_FunctionEntry(compiledOutLoop);
+    TEST_ASSERT_EQUAL_UINT32(TRACE_IDCODE_FUNC_ENTRY, TRACE_Get() >> TRACE_IDCODE_Pos);
+    TRACE_Printf("%u", 1);
+    TEST_ASSERT_EQUAL_UINT32(2, TRACE_GetNumEntries());
+}
+
+void test_VersionAndResetAreAlwaysCompiledIn(void)
+{
+    TRACE_ExecTracerVersion();
+    TRACE_ProcessorReset(0x20);
+    helper_VerifyExecTracerVersionTrace();
+    helper_VerifyProcessorResetTrace(0x20);
+}
@@ -0,0 +1,49 @@
+/*
+ * test_concurrent_put_overwrite_disabled.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "stress_helpers.h"
+
+#define NUM_PRODUCERS           4
+#define ENTRIES_PER_PRODUCER    200000
+
+void setUp(void)
+{
+    TRACE_Clear();
+}
+
+void tearDown(void)
+{
+}
+
+void test_NoEntriesLostOrDuplicatedWithContendedProducers(void)
+{
+    StressResults_t results;
+
+    stress_RunProducersAndConsumer(NUM_PRODUCERS, ENTRIES_PER_PRODUCER, true, &results);
+    TEST_ASSERT_EQUAL_UINT32(NUM_PRODUCERS * ENTRIES_PER_PRODUCER, results.num_received);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_invalid);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_duplicated);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_out_of_order);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_torn_records);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_missing);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_EntriesDroppedWhenFullNeverCorruptOthers(void)
+{
+    StressResults_t results;
+
+    stress_RunProducersAndConsumer(NUM_PRODUCERS, ENTRIES_PER_PRODUCER, false, &results);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_invalid);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_duplicated);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_out_of_order);
+    TEST_ASSERT_EQUAL_UINT32(0, results.num_torn_records);
+    TEST_ASSERT_EQUAL_UINT32(NUM_PRODUCERS * ENTRIES_PER_PRODUCER,
+            results.num_received + results.num_missing);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
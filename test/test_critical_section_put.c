@@ -0,0 +1,82 @@
+/*
+ * test_critical_section_put.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Private macros ---------------------------------------------------------- */
+#define TEST_VALUE_1        0x11111111
+#define TEST_VALUE_A        0xAAAAAAAA
+
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
+/* Private variables ------------------------------------------------------- */
+static int m_critical_depth;
+static int m_num_critical_sections;
+static bool m_nested;
+
+/* Fakes ------------------------------------------------------------------- */
+void fake_EnterCritical(void)
+{
+    m_nested |= (m_critical_depth != 0);
+    m_critical_depth++;
+    m_num_critical_sections++;
+}
+
+void fake_ExitCritical(void)
+{
+    m_critical_depth--;
+}
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    TRACE_Clear();
+    m_critical_depth = 0;
+    m_num_critical_sections = 0;
+    m_nested = false;
+}
+
+void tearDown(void)
+{
+}
+
+/* Test functions ---------------------------------------------------------- */
+void test_PutUsesCriticalSections(void)
+{
+    TRACE_Put(TEST_VALUE_A);
+    TEST_ASSERT_TRUE(m_num_critical_sections > 0);
+    TEST_ASSERT_EQUAL(0, m_critical_depth);
+    TEST_ASSERT_FALSE(m_nested);
+    TEST_ASSERT_EQUAL_HEX32(TEST_VALUE_A, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RecordsStayWhole(void)
+{
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_A);
+    TRACE_Put(TEST_VALUE_1);
+    TEST_ASSERT_EQUAL_UINT32(3, TRACE_GetNumEntries());
+    TEST_ASSERT_EQUAL_HEX32(TEST_RECORD_HEADER, TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(TEST_VALUE_A, TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(TEST_VALUE_1, TRACE_Get());
+    TEST_ASSERT_EQUAL(0, m_critical_depth);
+    TEST_ASSERT_FALSE(m_nested);
+}
+
+void test_PutOverwritesOldestValueWhenQueueIsFull(void)
+{
+    TRACE_Put(TEST_VALUE_A);
+    helper_WriteNEntriesToQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY);
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+    helper_VerifyNEntriesInQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+    TEST_ASSERT_EQUAL(0, m_critical_depth);
+    TEST_ASSERT_FALSE(m_nested);
+}
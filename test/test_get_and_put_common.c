@@ -17,6 +17,9 @@
 #define TEST_VALUE_A        0xAAAAAAAA
 #define TEST_VALUE_C        0xCCCCCCCC
 
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
 void setUp(void)
 {
     TRACE_Clear();
@@ -138,3 +141,90 @@ void test_GetNumEntriesWorksForWrapAround(void)
     TRACE_Get();
     TEST_ASSERT_EQUAL_UINT32(BUFFER_MAX_CAPACITY - 3, TRACE_GetNumEntries());
 }
+
+void test_RecordWordsAreReturnedInOrder(void)
+{
+    TRACE_Put(TEST_VALUE_1);
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_2);
+    TRACE_Put(TEST_VALUE_3);
+    TEST_ASSERT_EQUAL_UINT32(4, TRACE_GetNumEntries());
+
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_1, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORD_HEADER, TRACE_Get());
+    /* The payload has left the buffer but is still counted until it's read */
+    TEST_ASSERT_EQUAL_UINT32(1, _TRACE_GetNumBufferedSlots());
+    TEST_ASSERT_EQUAL_UINT32(2, TRACE_GetNumEntries());
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_2, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_3, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_ExtendedRecordLengthComesFromHeader(void)
+{
+    uint32_t header = ((uint32_t)TRACE_IDCODE_EXTENDED << TRACE_IDCODE_Pos) |
+            (3 << TRACE_EXT_LENGTH_Pos);
+    uint32_t index;
+
+    TEST_ASSERT_EQUAL_UINT32(4, TRACE_RecordLength(header));
+    TEST_ASSERT_EQUAL_UINT32(2, TRACE_RecordLength(TEST_RECORD_HEADER));
+    TEST_ASSERT_EQUAL_UINT32(1, TRACE_RecordLength(TEST_VALUE_C));
+
+    TEST_ASSERT_TRUE(TRACE_ReserveRecord(4, &index));
+    TRACE_WriteRecord(index, 0, header);
+    TRACE_WriteRecord(index, 1, TEST_VALUE_1);
+    TRACE_WriteRecord(index, 2, TEST_VALUE_2);
+    TRACE_WriteRecord(index, 3, TEST_VALUE_3);
+    TRACE_CommitRecord(index, 4);
+
+    TEST_ASSERT_EQUAL_UINT32(header, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(0, _TRACE_GetNumBufferedSlots());
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_1, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_2, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_3, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RecordIsNotPublishedUntilCommitted(void)
+{
+    uint32_t index;
+
+    TEST_ASSERT_TRUE(TRACE_ReserveRecord(2, &index));
+    TRACE_WriteRecord(index, 0, TEST_RECORD_HEADER);
+    /* A put that interrupts the record is published after it */
+    TRACE_Put(TEST_VALUE_1);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+
+    TRACE_WriteRecord(index, 1, TEST_VALUE_2);
+    TRACE_CommitRecord(index, 2);
+    TEST_ASSERT_EQUAL_UINT32(3, TRACE_GetNumEntries());
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORD_HEADER, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_2, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_1, TRACE_Get());
+}
+
+void test_InitKeepsEntriesWithSameLayout(void)
+{
+    ExecTraceCallbacks_t callbacks = {0};
+
+    m_exec_trace.magic = EXEC_TRACE_INIT_MAGIC;
+    m_exec_trace.reset_count = 0;
+    TRACE_Put(TEST_VALUE_1);
+    TRACE_Init(&callbacks);
+    TEST_ASSERT_EQUAL_UINT32(1, m_exec_trace.reset_count);
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_1, TRACE_Get());
+    helper_VerifyExecTracerVersionTrace();
+}
+
+void test_InitClearsEntriesWithOtherLayout(void)
+{
+    ExecTraceCallbacks_t callbacks = {0};
+
+    /* Magic used before the layout was encoded in it */
+    m_exec_trace.magic = 0xA5B4C123;
+    TRACE_Put(TEST_VALUE_1);
+    TRACE_Init(&callbacks);
+    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.reset_count);
+    TEST_ASSERT_EQUAL_HEX32(EXEC_TRACE_INIT_MAGIC, m_exec_trace.magic);
+    helper_VerifyExecTracerVersionTrace();
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
@@ -17,6 +17,9 @@
 #define TEST_VALUE_A        0xAAAAAAAA
 #define TEST_VALUE_C        0xCCCCCCCC
 
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
 void setUp(void)
 {
     TRACE_Clear();
@@ -75,16 +78,30 @@ void test_PutDoesNothingWhenQueueIsFullAtWraparound(void)
     /* Oldest item in queue should be value 1 */
     TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_1, TRACE_Get());
 
-    /* Fill new slot with value 1; Head and tail both increment */
+    /* Fill new slot with value 1; Head and tail both increment.
+     * Head is a free-running count, so only its index wraps to 0. */
     TRACE_Put(TEST_VALUE_1);
-    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.head);
+    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.head & BUFFER_INDEX_MASK);
     TEST_ASSERT_EQUAL_UINT32(1, m_exec_trace.tail);
 
     /* Put of value A fails */
     TRACE_Put(TEST_VALUE_A);
-    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.head);
+    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.head & BUFFER_INDEX_MASK);
     TEST_ASSERT_EQUAL_UINT32(1, m_exec_trace.tail);
 
     /* Verify that only put 1 succeeded and put As failed */
     helper_VerifyEntireQueue(TEST_VALUE_1);
 }
+
+void test_RecordIsDroppedWholeWhenItDoesNotFit(void)
+{
+    helper_WriteNEntriesToQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY - 1);
+
+    /* Only one slot is free, so neither word of the record is traced */
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_2);
+    TEST_ASSERT_EQUAL_UINT32(BUFFER_MAX_CAPACITY - 1, TRACE_GetNumEntries());
+    TEST_ASSERT_EQUAL_UINT32(BUFFER_MAX_CAPACITY - 1, m_exec_trace.reserve);
+
+    helper_VerifyNEntriesInQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY - 1);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
@@ -17,6 +17,9 @@
 #define TEST_VALUE_A        0xAAAAAAAA
 #define TEST_VALUE_C        0xCCCCCCCC
 
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
 void setUp(void)
 {
     TRACE_Clear();
@@ -65,9 +68,10 @@ void test_PutOverwritesOldestValueWhenQueueIsFullAtWraparound(void)
     TEST_ASSERT_EQUAL_UINT32(BUFFER_MAX_CAPACITY, m_exec_trace.head);
     TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.tail);
 
-    /* Put of value A succeeds */
+    /* Put of value A succeeds.
+     * Head is a free-running count, so only its index wraps to 0. */
     TRACE_Put(TEST_VALUE_A);
-    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.head);
+    TEST_ASSERT_EQUAL_UINT32(0, m_exec_trace.head & BUFFER_INDEX_MASK);
     TEST_ASSERT_EQUAL_UINT32(1, m_exec_trace.tail);
 
     /* Oldest item in queue should be value 1 */
@@ -80,3 +84,36 @@ void test_PutOverwritesOldestValueWhenQueueIsFullAtWraparound(void)
     TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_A, TRACE_Get());
     TEST_ASSERT_TRUE(TRACE_IsEmpty());
 }
+
+void test_PutOverwritesOldestRecordWhole(void)
+{
+    /* Being the first entry, the record will get overwritten */
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_C);
+    helper_WriteNEntriesToQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY - 2);
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+
+    /* One slot is needed, but both words of the record are discarded */
+    TRACE_Put(TEST_VALUE_A);
+    TEST_ASSERT_EQUAL_UINT32(2, m_exec_trace.tail);
+    TEST_ASSERT_EQUAL_UINT32(BUFFER_MAX_CAPACITY - 1, TRACE_GetNumEntries());
+
+    helper_VerifyNEntriesInQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY - 2);
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_A, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RecordBeingReadIsNotOverwritten(void)
+{
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_C);
+    helper_WriteNEntriesToQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY - 2);
+
+    /* Reading the header claims the whole record, freeing both of its slots */
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORD_HEADER, TRACE_Get());
+    helper_WriteNEntriesToQueue(TEST_VALUE_A, 3);
+    TEST_ASSERT_EQUAL_UINT32(TEST_VALUE_C, TRACE_Get());
+
+    /* The oldest value 1 made room for the third value A */
+    helper_VerifyNEntriesInQueue(TEST_VALUE_1, BUFFER_MAX_CAPACITY - 3);
+    helper_VerifyNEntriesInQueue(TEST_VALUE_A, 3);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
@@ -0,0 +1,67 @@
+/*
+ * test_instrument_functions.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Helper functions -------------------------------------------------------- */
+/* Stands in for a function compiled with -finstrument-functions. The hooks
+ * are called directly because Ceedling would instrument the tracer too. */
+void instrumentedFunction(void)
+{
+}
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    TRACE_Clear();
+}
+
+void tearDown(void)
+{
+}
+
+/* Test functions ---------------------------------------------------------- */
+void test_EntryHookTracesSameEntryAsMacro(void)
+{
+    uint32_t expected;
+
+    TRACE_FunctionEntry(instrumentedFunction);
+    expected = TRACE_Get();
+    __cyg_profile_func_enter((void *)instrumentedFunction, (void *)test_EntryHookTracesSameEntryAsMacro);
+    TEST_ASSERT_EQUAL_HEX32(expected, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_ExitHookTracesSameEntryAsMacro(void)
+{
+    uint32_t expected;
+
+    TRACE_FunctionExit(instrumentedFunction);
+    expected = TRACE_Get();
+    __cyg_profile_func_exit((void *)instrumentedFunction, (void *)test_ExitHookTracesSameEntryAsMacro);
+    TEST_ASSERT_EQUAL_HEX32(expected, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_HooksTraceOneEntryEach(void)
+{
+    __cyg_profile_func_enter((void *)instrumentedFunction, NULL);
+    __cyg_profile_func_exit((void *)instrumentedFunction, NULL);
+    TEST_ASSERT_EQUAL_UINT32(2, TRACE_GetNumEntries());
+    TEST_ASSERT_EQUAL_UINT32(TRACE_IDCODE_FUNC_ENTRY, TRACE_Get() >> TRACE_IDCODE_Pos);
+    TEST_ASSERT_EQUAL_UINT32(TRACE_IDCODE_FUNC_EXIT, TRACE_Get() >> TRACE_IDCODE_Pos);
+}
+
+void test_HooksDropEntriesWhenBufferIsFull(void)
+{
+    helper_WriteNEntriesToQueue(0x11111111, BUFFER_MAX_CAPACITY);
+    __cyg_profile_func_enter((void *)instrumentedFunction, NULL);
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+    helper_VerifyNEntriesInQueue(0x11111111, BUFFER_MAX_CAPACITY);
+}
@@ -0,0 +1,244 @@
+/*
+ * test_log_dump_base64.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include <string.h>
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Private macros ---------------------------------------------------------- */
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof(a[0]))
+#define MAX_LINES           16
+#define FULL_LINE_LENGTH    (1 + TRACE_BASE64_LINE_WORDS * 4 / 3 * 4 + 1)
+
+#define BUFFER_FULL_VALUE   0xFFFFFFFF
+
+/* Private variables ------------------------------------------------------- */
+static const char m_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static char       m_stream[MAX_LINES * FULL_LINE_LENGTH + 1];
+static uint32_t   m_stream_length;
+static int        m_num_writes;
+static uint32_t   m_line_lengths[MAX_LINES];
+static int        m_num_lines;
+static uint32_t   m_decoded_values[BUFFER_LENGTH_IN_WORDS + 1];
+static uint32_t   m_num_decoded_values;
+static bool       m_deadline_is_reached;
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    m_stream_length = 0;
+    m_num_writes = 0;
+    m_num_lines = 0;
+    m_num_decoded_values = 0;
+    m_deadline_is_reached = false;
+    TRACE_Clear();
+}
+
+void tearDown(void)
+{
+}
+
+/* Helper functions -------------------------------------------------------- */
+void write(uint8_t * p_data, uint16_t size)
+{
+    TEST_ASSERT_TRUE(m_stream_length + size < sizeof(m_stream));
+    memcpy(&m_stream[m_stream_length], p_data, size);
+    m_stream_length += size;
+    m_stream[m_stream_length] = '\0';
+    m_num_writes++;
+}
+bool deadline_reached(void)
+{
+    return m_deadline_is_reached;
+}
+ExecTraceCallbacks_t test_callbacks = {
+        .write = write,
+        .lock = NULL,
+        .unlock = NULL
+};
+
+/**
+ * Split the written stream into lines, check each one's format, and decode
+ * their entries into m_decoded_values.
+ */
+void helper_DecodeStream(void)
+{
+    uint32_t start = 0;
+
+    TEST_ASSERT_TRUE(m_stream_length > 0);
+    TEST_ASSERT_EQUAL_HEX8('\n', m_stream[m_stream_length - 1]);
+
+    for (uint32_t end = 0; end < m_stream_length; end++)
+    {
+        uint8_t bytes[TRACE_BASE64_LINE_WORDS * 4];
+        uint32_t num_bytes = 0;
+        uint32_t num_chars;
+
+        if (m_stream[end] != '\n')
+        {
+            continue;
+        }
+        TEST_ASSERT_TRUE(m_num_lines < MAX_LINES);
+        m_line_lengths[m_num_lines++] = end + 1 - start;
+        TEST_ASSERT_EQUAL_HEX8(TRACE_BASE64_LINE_START, m_stream[start]);
+        num_chars = end - start - 1;
+        TEST_ASSERT_EQUAL(0, num_chars % 4);
+        TEST_ASSERT_TRUE(num_chars <= FULL_LINE_LENGTH - 2);
+
+        for (uint32_t i = start + 1; i < end; i += 4)
+        {
+            uint32_t group = 0;
+            int num_padding = 0;
+
+            for (int j = 0; j < 4; j++)
+            {
+                char c = m_stream[i + j];
+
+                if (c == '=')
+                {
+                    /* Padding only ends the last group of a line */
+                    TEST_ASSERT_EQUAL(end, i + 4);
+                    TEST_ASSERT_TRUE(j >= 2);
+                    num_padding++;
+                    group <<= 6;
+                }
+                else
+                {
+                    TEST_ASSERT_EQUAL(0, num_padding);
+                    TEST_ASSERT_NOT_NULL(strchr(m_alphabet, c));
+                    group = (group << 6) | (uint32_t)(strchr(m_alphabet, c) - m_alphabet);
+                }
+            }
+            for (int j = 0; j < 3 - num_padding; j++)
+            {
+                bytes[num_bytes++] = (uint8_t)(group >> (16 - 8 * j));
+            }
+        }
+
+        TEST_ASSERT_EQUAL(0, num_bytes % 4);
+        for (uint32_t i = 0; i < num_bytes; i += 4)
+        {
+            TEST_ASSERT_TRUE(m_num_decoded_values < ARRAY_SIZE(m_decoded_values));
+            m_decoded_values[m_num_decoded_values++] = bytes[i] | (bytes[i + 1] << 8) |
+                    (bytes[i + 2] << 16) | ((uint32_t)bytes[i + 3] << 24);
+        }
+        start = end + 1;
+    }
+}
+
+/* Test functions ---------------------------------------------------------- */
+void test_WriteFunctionNotCalledWhenTraceBufferIsEmpty(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(0, m_num_writes);
+}
+
+void test_EntriesAreWrittenAsOneLineOfLittleEndianWords(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(0x12345678);
+    TRACE_Put(0x0FFFFFFF);
+    TRACE_Put(0x80000000);
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(1, m_num_writes);
+    TEST_ASSERT_EQUAL_STRING("$eFY0Ev///w8AAACA\n", m_stream);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_PartialGroupsArePadded(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(0x12345678);
+    DumpExecTraceLog();
+    TRACE_Put(0x12345678);
+    TRACE_Put(0x0FFFFFFF);
+    DumpExecTraceLog();
+
+    TEST_ASSERT_EQUAL(2, m_num_writes);
+    TEST_ASSERT_EQUAL_STRING("$eFY0Eg==\n$eFY0Ev///w8=\n", m_stream);
+}
+
+void test_LargeDumpIsSplitIntoFullLines(void)
+{
+    uint32_t expected_values[2 * TRACE_BASE64_LINE_WORDS + 1];
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    for (int i = 0; i < ARRAY_SIZE(expected_values); i++)
+    {
+        expected_values[i] = 0xE7654321 - 0x01010101 * i;
+        TRACE_Put(expected_values[i]);
+    }
+
+    DumpExecTraceLog();
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL(3, m_num_writes);
+    TEST_ASSERT_EQUAL(3, m_num_lines);
+    /* Half the 11 bytes per entry of DUMP_FORMAT_HEX_TEXT */
+    TEST_ASSERT_EQUAL(TRACE_BASE64_LINE_WORDS * 11 / 2, FULL_LINE_LENGTH);
+    TEST_ASSERT_EQUAL(FULL_LINE_LENGTH, m_line_lengths[0]);
+    TEST_ASSERT_EQUAL(FULL_LINE_LENGTH, m_line_lengths[1]);
+    TEST_ASSERT_EQUAL(1 + 8 + 1, m_line_lengths[2]);
+    TEST_ASSERT_EQUAL(ARRAY_SIZE(expected_values), m_num_decoded_values);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected_values, m_decoded_values, ARRAY_SIZE(expected_values));
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_BufferFullIndicationPrecedesEntries(void)
+{
+    uint32_t expected_values[BUFFER_LENGTH_IN_WORDS];
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+
+    expected_values[0] = BUFFER_FULL_VALUE;
+    for (int i = 1; i < BUFFER_LENGTH_IN_WORDS; i++)
+    {
+        expected_values[i] = 0x10000000 + i;
+        TRACE_Put(expected_values[i]);
+    }
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+
+    DumpExecTraceLog();
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL(BUFFER_LENGTH_IN_WORDS, m_num_decoded_values);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected_values, m_decoded_values, BUFFER_LENGTH_IN_WORDS);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_BoundedDumpStopsAtBudget(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    helper_WriteNEntriesToQueue(0x11111111, 5);
+
+    TEST_ASSERT_EQUAL_UINT32(2, DumpExecTraceLogBounded(3, NULL));
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL(1, m_num_writes);
+    TEST_ASSERT_EQUAL(3, m_num_decoded_values);
+    helper_VerifyNEntriesInQueue(0x11111111, 2);
+}
+
+void test_BoundedDumpWritesNothingPastDeadline(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(0x11111111);
+    TRACE_Put(0x22222222);
+
+    m_deadline_is_reached = true;
+    TEST_ASSERT_EQUAL_UINT32(2, DumpExecTraceLogBounded(DUMP_NO_LIMIT, deadline_reached));
+    TEST_ASSERT_EQUAL(0, m_num_writes);
+}
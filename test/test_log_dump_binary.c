@@ -0,0 +1,189 @@
+/*
+ * test_log_dump_binary.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include <string.h>
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Private macros ---------------------------------------------------------- */
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof(a[0]))
+#define MAX_WRITES          4
+
+#define BUFFER_FULL_VALUE   0xFFFFFFFF
+
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
+/* Private variables ------------------------------------------------------- */
+static int        m_num_writes;
+static uint8_t *  m_write_data[MAX_WRITES];
+static uint16_t   m_write_size[MAX_WRITES];
+static uint32_t   m_written_values[BUFFER_LENGTH_IN_WORDS + 1];
+static int        m_num_written_values;
+static bool       m_deadline_is_reached;
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    m_num_writes = 0;
+    m_num_written_values = 0;
+    m_deadline_is_reached = false;
+    TRACE_Clear();
+}
+
+void tearDown(void)
+{
+}
+
+/* Helper functions -------------------------------------------------------- */
+void write(uint8_t * p_data, uint16_t size)
+{
+    TEST_ASSERT_TRUE(m_num_writes < MAX_WRITES);
+    TEST_ASSERT_EQUAL(0, size % sizeof(uint32_t));
+    m_write_data[m_num_writes] = p_data;
+    m_write_size[m_num_writes] = size;
+    m_num_writes++;
+    memcpy(&m_written_values[m_num_written_values], p_data, size);
+    m_num_written_values += size / sizeof(uint32_t);
+}
+bool deadline_reached(void)
+{
+    return m_deadline_is_reached;
+}
+ExecTraceCallbacks_t test_callbacks = {
+        .write = write,
+        .lock = NULL,
+        .unlock = NULL
+};
+
+/* Test functions ---------------------------------------------------------- */
+void test_WriteFunctionNotCalledWhenTraceBufferIsEmpty(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(0, m_num_writes);
+}
+
+void test_EntriesAreWrittenAsOneSpanWithoutWraparound(void)
+{
+    uint32_t test_values[] = {
+            0x12345678,
+            0x00000000,
+            0xFFFFFFFF,
+    };
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    for(int i = 0; i < ARRAY_SIZE(test_values); i++)
+    {
+        TRACE_Put(test_values[i]);
+    }
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(1, m_num_writes);
+    TEST_ASSERT_EQUAL(sizeof(test_values), m_write_size[0]);
+    /* The span is passed straight from the trace buffer without copying */
+    TEST_ASSERT_TRUE(m_write_data[0] == (uint8_t*)&m_exec_trace.trace_buffer[0]);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(test_values, m_written_values, ARRAY_SIZE(test_values));
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_EntriesAreWrittenAsTwoSpansAtWraparound(void)
+{
+    uint32_t test_values[] = {
+            0x11111111,
+            0x22222222,
+            0x33333333,
+            0x44444444,
+            0x55555555,
+    };
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+
+    /* Move head and tail so that the next entries wrap around */
+    helper_WriteNEntriesToQueue(0xCCCCCCCC, BUFFER_LENGTH_IN_WORDS - 2);
+    helper_EmptyQueue();
+
+    for(int i = 0; i < ARRAY_SIZE(test_values); i++)
+    {
+        TRACE_Put(test_values[i]);
+    }
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(2, m_num_writes);
+    TEST_ASSERT_EQUAL(2 * sizeof(uint32_t), m_write_size[0]);
+    TEST_ASSERT_EQUAL(3 * sizeof(uint32_t), m_write_size[1]);
+    TEST_ASSERT_TRUE(m_write_data[1] == (uint8_t*)&m_exec_trace.trace_buffer[0]);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(test_values, m_written_values, ARRAY_SIZE(test_values));
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_BufferFullIndicationPrecedesEntries(void)
+{
+    uint32_t expected_values[BUFFER_LENGTH_IN_WORDS];
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+
+    expected_values[0] = BUFFER_FULL_VALUE;
+    for(int i = 1; i < BUFFER_LENGTH_IN_WORDS; i++)
+    {
+        expected_values[i] = 0x10000000 + i;
+        TRACE_Put(expected_values[i]);
+    }
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(2, m_num_writes);
+    TEST_ASSERT_EQUAL(sizeof(uint32_t), m_write_size[0]);
+    TEST_ASSERT_EQUAL(BUFFER_LENGTH_IN_WORDS, m_num_written_values);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected_values, m_written_values, BUFFER_LENGTH_IN_WORDS);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_BoundedDumpDoesNotSplitRecords(void)
+{
+    uint32_t expected_values[] = {
+            0x11111111,
+            TEST_RECORD_HEADER,
+            0x22222222,
+            0x33333333,
+    };
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(expected_values[0]);
+    TRACE_PutRecord2(expected_values[1], expected_values[2]);
+    TRACE_Put(expected_values[3]);
+
+    /* The record doesn't fit in what is left of the budget */
+    TEST_ASSERT_EQUAL_UINT32(3, DumpExecTraceLogBounded(2, NULL));
+    TEST_ASSERT_EQUAL(1, m_num_written_values);
+
+    /* A record larger than the budget is still written whole */
+    TEST_ASSERT_EQUAL_UINT32(1, DumpExecTraceLogBounded(1, NULL));
+    TEST_ASSERT_EQUAL(3, m_num_written_values);
+
+    TEST_ASSERT_EQUAL_UINT32(0, DumpExecTraceLogBounded(DUMP_NO_LIMIT, NULL));
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected_values, m_written_values, ARRAY_SIZE(expected_values));
+}
+
+void test_BoundedDumpWritesNothingPastDeadline(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(0x11111111);
+    TRACE_Put(0x22222222);
+
+    m_deadline_is_reached = true;
+    TEST_ASSERT_EQUAL_UINT32(2, DumpExecTraceLogBounded(DUMP_NO_LIMIT, deadline_reached));
+    TEST_ASSERT_EQUAL(0, m_num_writes);
+}
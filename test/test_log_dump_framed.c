@@ -0,0 +1,353 @@
+/*
+ * test_log_dump_framed.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include <string.h>
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Private macros ---------------------------------------------------------- */
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof(a[0]))
+#define MAX_FRAMES          64
+#define MAX_FRAME_SIZE      256
+
+#define BUFFER_FULL_VALUE   0xFFFFFFFF
+
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
+#define FUNC_ENTRY(offset)  (((uint32_t)TRACE_IDCODE_FUNC_ENTRY << TRACE_IDCODE_Pos) | (offset))
+#define FUNC_EXIT(offset)   (((uint32_t)TRACE_IDCODE_FUNC_EXIT << TRACE_IDCODE_Pos) | (offset))
+
+/* Private types ----------------------------------------------------------- */
+typedef struct {
+    uint8_t     data[MAX_FRAME_SIZE];   /* COBS decoded */
+    uint32_t    length;
+    uint32_t    seq;
+    uint32_t    num_entries;
+} Frame_t;
+
+/* Private variables ------------------------------------------------------- */
+static uint8_t    m_stream[MAX_FRAMES * MAX_FRAME_SIZE];
+static uint32_t   m_stream_length;
+static int        m_num_writes;
+static Frame_t    m_frames[MAX_FRAMES];
+static int        m_num_frames;
+static uint32_t   m_decoded_values[BUFFER_LENGTH_IN_WORDS + 1];
+static uint32_t   m_num_decoded_values;
+static bool       m_deadline_is_reached;
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    m_stream_length = 0;
+    m_num_writes = 0;
+    m_num_frames = 0;
+    m_num_decoded_values = 0;
+    m_deadline_is_reached = false;
+    TRACE_Clear();
+}
+
+void tearDown(void)
+{
+}
+
+/* Helper functions -------------------------------------------------------- */
+void write(uint8_t * p_data, uint16_t size)
+{
+    TEST_ASSERT_TRUE(m_stream_length + size <= sizeof(m_stream));
+    memcpy(&m_stream[m_stream_length], p_data, size);
+    m_stream_length += size;
+    m_num_writes++;
+}
+bool deadline_reached(void)
+{
+    return m_deadline_is_reached;
+}
+ExecTraceCallbacks_t test_callbacks = {
+        .write = write,
+        .lock = NULL,
+        .unlock = NULL
+};
+
+uint16_t helper_Crc16(const uint8_t * p_data, uint32_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)p_data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * Split the written stream into frames, check each one's encoding and CRC,
+ * and decode their tokens into m_decoded_values.
+ */
+void helper_DecodeStream(void)
+{
+    uint32_t start = 0;
+    uint32_t open_entries[TRACE_FRAME_STACK_DEPTH];
+    uint32_t num_open_entries;
+
+    TEST_ASSERT_TRUE(m_stream_length > 0);
+    TEST_ASSERT_EQUAL_HEX8(TRACE_FRAME_DELIMITER, m_stream[m_stream_length - 1]);
+
+    for (uint32_t end = 0; end < m_stream_length; end++)
+    {
+        Frame_t * p_frame;
+        uint32_t i;
+
+        if (m_stream[end] != TRACE_FRAME_DELIMITER)
+        {
+            continue;
+        }
+        TEST_ASSERT_TRUE(m_num_frames < MAX_FRAMES);
+        p_frame = &m_frames[m_num_frames++];
+        p_frame->length = 0;
+        p_frame->num_entries = 0;
+
+        /* COBS decode */
+        for (i = start; i < end; )
+        {
+            uint8_t code = m_stream[i++];
+
+            TEST_ASSERT_TRUE(i - 1 + code <= end);
+            for (int j = 1; j < code; j++)
+            {
+                p_frame->data[p_frame->length++] = m_stream[i++];
+            }
+            if ((code < 0xFF) && (i < end))
+            {
+                p_frame->data[p_frame->length++] = 0;
+            }
+        }
+        start = end + 1;
+
+        TEST_ASSERT_TRUE(p_frame->length > TRACE_FRAME_SEQ_SIZE + TRACE_FRAME_CRC_SIZE);
+        TEST_ASSERT_TRUE(p_frame->length <=
+                TRACE_FRAME_SEQ_SIZE + TRACE_FRAME_MAX_PAYLOAD + TRACE_FRAME_CRC_SIZE);
+        p_frame->length -= TRACE_FRAME_CRC_SIZE;
+        TEST_ASSERT_EQUAL_HEX16(helper_Crc16(p_frame->data, p_frame->length),
+                p_frame->data[p_frame->length] | (p_frame->data[p_frame->length + 1] << 8));
+        memcpy(&p_frame->seq, p_frame->data, sizeof(p_frame->seq));
+
+        /* Tokens */
+        num_open_entries = 0;
+        for (i = TRACE_FRAME_SEQ_SIZE; i < p_frame->length; )
+        {
+            uint64_t token = 0;
+            uint32_t value;
+            int shift = 0;
+            uint8_t byte;
+
+            do
+            {
+                TEST_ASSERT_TRUE(i < p_frame->length);
+                byte = p_frame->data[i++];
+                token |= (uint64_t)(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+
+            if (token == TRACE_FRAME_TOKEN_EXIT)
+            {
+                TEST_ASSERT_TRUE(num_open_entries > 0);
+                value = FUNC_EXIT(open_entries[--num_open_entries]);
+            }
+            else
+            {
+                TEST_ASSERT_TRUE(token & 1);
+                token >>= 1;
+                value = (uint32_t)((token >> 4) | (token << 28));
+                if (((value >> TRACE_IDCODE_Pos) == TRACE_IDCODE_FUNC_ENTRY) &&
+                    (num_open_entries < TRACE_FRAME_STACK_DEPTH))
+                {
+                    open_entries[num_open_entries++] = value & TRACE_DATA_Msk;
+                }
+            }
+            TEST_ASSERT_TRUE(m_num_decoded_values < ARRAY_SIZE(m_decoded_values));
+            m_decoded_values[m_num_decoded_values++] = value;
+            p_frame->num_entries++;
+        }
+    }
+}
+
+/* Test functions ---------------------------------------------------------- */
+void test_WriteFunctionNotCalledWhenTraceBufferIsEmpty(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(0, m_num_writes);
+}
+
+void test_EntriesAreWrittenAsOneFrame(void)
+{
+    uint32_t test_values[] = {
+            0x12345678,
+            0x00000000,
+            0x0FFFFFFF,
+            0x80000000,
+    };
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    for (int i = 0; i < ARRAY_SIZE(test_values); i++)
+    {
+        TRACE_Put(test_values[i]);
+    }
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(1, m_num_writes);
+    /* The delimiter only appears at the end of the frame */
+    TEST_ASSERT_NULL(memchr(m_stream, TRACE_FRAME_DELIMITER, m_stream_length - 1));
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL(1, m_num_frames);
+    TEST_ASSERT_EQUAL(ARRAY_SIZE(test_values), m_num_decoded_values);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(test_values, m_decoded_values, ARRAY_SIZE(test_values));
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_MatchingFunctionExitIsOneByte(void)
+{
+    uint32_t test_values[] = {
+            FUNC_ENTRY(0x1000),
+            FUNC_ENTRY(0x2000),
+            FUNC_EXIT(0x2000),
+            FUNC_EXIT(0x3000),  /* Doesn't match the innermost entry */
+            FUNC_EXIT(0x1000),
+    };
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    for (int i = 0; i < ARRAY_SIZE(test_values); i++)
+    {
+        TRACE_Put(test_values[i]);
+    }
+
+    DumpExecTraceLog();
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(test_values, m_decoded_values, ARRAY_SIZE(test_values));
+    /* Sequence number, three tokens of 3 bytes and two exits of 1 byte */
+    TEST_ASSERT_EQUAL(TRACE_FRAME_SEQ_SIZE + 3 * 3 + 2, m_frames[0].length);
+}
+
+void test_SequenceNumberCountsEntriesSent(void)
+{
+    uint32_t first_seq;
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    helper_WriteNEntriesToQueue(0x11111111, 3);
+    DumpExecTraceLog();
+    helper_WriteNEntriesToQueue(0x22222222, 2);
+    DumpExecTraceLog();
+
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL(2, m_num_frames);
+    first_seq = m_frames[0].seq;
+    TEST_ASSERT_EQUAL_UINT32(first_seq + 3, m_frames[1].seq);
+}
+
+void test_LargeDumpIsSplitIntoFramesWithoutSplittingRecords(void)
+{
+    uint32_t expected_values[BUFFER_LENGTH_IN_WORDS];
+    uint32_t num_values = 0;
+    uint32_t seq;
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    /* Entries that take the longest tokens, with records interleaved */
+    for (; num_values + 3 <= 200; num_values += 3)
+    {
+        expected_values[num_values] = 0xE7654321 + num_values;
+        expected_values[num_values + 1] = TEST_RECORD_HEADER;
+        expected_values[num_values + 2] = 0xFEDCBA98 - num_values;
+        TRACE_Put(expected_values[num_values]);
+        TRACE_PutRecord2(expected_values[num_values + 1], expected_values[num_values + 2]);
+    }
+
+    DumpExecTraceLog();
+    helper_DecodeStream();
+    TEST_ASSERT_TRUE(m_num_frames > 1);
+    TEST_ASSERT_EQUAL(num_values, m_num_decoded_values);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected_values, m_decoded_values, num_values);
+
+    seq = m_frames[0].seq;
+    for (int i = 0; i < m_num_frames; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(seq, m_frames[i].seq);
+        /* No frame starts with the payload of a record */
+        TEST_ASSERT_NOT_EQUAL(2, (seq - m_frames[0].seq) % 3);
+        seq += m_frames[i].num_entries;
+    }
+}
+
+void test_BufferFullIndicationPrecedesEntries(void)
+{
+    uint32_t expected_values[BUFFER_LENGTH_IN_WORDS];
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+
+    expected_values[0] = BUFFER_FULL_VALUE;
+    for (int i = 1; i < BUFFER_LENGTH_IN_WORDS; i++)
+    {
+        expected_values[i] = 0x10000000 + i;
+        TRACE_Put(expected_values[i]);
+    }
+    TEST_ASSERT_TRUE(TRACE_IsFull());
+
+    DumpExecTraceLog();
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL(BUFFER_LENGTH_IN_WORDS, m_num_decoded_values);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected_values, m_decoded_values, BUFFER_LENGTH_IN_WORDS);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_BoundedDumpDoesNotSplitRecords(void)
+{
+    uint32_t expected_values[] = {
+            0x11111111,
+            TEST_RECORD_HEADER,
+            0x22222222,
+            0x33333333,
+    };
+
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(expected_values[0]);
+    TRACE_PutRecord2(expected_values[1], expected_values[2]);
+    TRACE_Put(expected_values[3]);
+
+    /* A record that was started is finished even past the budget */
+    TEST_ASSERT_EQUAL_UINT32(1, DumpExecTraceLogBounded(2, NULL));
+    TEST_ASSERT_EQUAL_UINT32(0, DumpExecTraceLogBounded(DUMP_NO_LIMIT, NULL));
+
+    helper_DecodeStream();
+    TEST_ASSERT_EQUAL(2, m_num_frames);
+    TEST_ASSERT_EQUAL(3, m_frames[0].num_entries);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected_values, m_decoded_values, ARRAY_SIZE(expected_values));
+}
+
+void test_BoundedDumpWritesNothingPastDeadline(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+    TRACE_Put(0x11111111);
+    TRACE_Put(0x22222222);
+
+    m_deadline_is_reached = true;
+    TEST_ASSERT_EQUAL_UINT32(2, DumpExecTraceLogBounded(DUMP_NO_LIMIT, deadline_reached));
+    TEST_ASSERT_EQUAL(0, m_num_writes);
+}
@@ -24,6 +24,7 @@ static bool       m_unlock_called;
 static int        m_num_writes_expected;
 static int        m_num_writes_actual;
 static uint32_t * m_expected_write_values;
+static int        m_deadline_checks_left;
 
 /* Set up and tear down ---------------------------------------------------- */
 void setUp(void)
@@ -53,6 +54,15 @@ void write_with_check(uint8_t * p_data, uint16_t size)
     TEST_ASSERT_EQUAL(strlen(test_buff), size);
     TEST_ASSERT_EQUAL(0, memcmp(test_buff, p_data, size));
 }
+bool deadline_reached(void)
+{
+    if (m_deadline_checks_left == 0)
+    {
+        return true;
+    }
+    m_deadline_checks_left--;
+    return false;
+}
 void lock(void)
 {
     m_lock_called = true;
@@ -167,3 +177,101 @@ void test_BufferFullIndicationOccursWhenBufferIsFull(void)
     DumpExecTraceLog();
     TEST_ASSERT_EQUAL(m_num_writes_expected, m_num_writes_actual);
 }
+
+void test_BoundedDumpStopsAtMaxEntries(void)
+{
+    uint32_t test_values[] = {
+            0x11111111,
+            0x22222222,
+            0x33333333,
+            0x44444444,
+            0x55555555,
+    };
+
+    TRACE_Init(&test_callbacks_with_write_check);
+    TRACE_Clear();
+    for(int i = 0; i < ARRAY_SIZE(test_values); i++)
+    {
+        TRACE_Put(test_values[i]);
+    }
+
+    m_expected_write_values = test_values;
+    TEST_ASSERT_EQUAL_UINT32(2, DumpExecTraceLogBounded(3, NULL));
+    TEST_ASSERT_EQUAL(3, m_num_writes_actual);
+
+    /* The next call continues where the last one stopped */
+    TEST_ASSERT_EQUAL_UINT32(0, DumpExecTraceLogBounded(DUMP_NO_LIMIT, NULL));
+    TEST_ASSERT_EQUAL(ARRAY_SIZE(test_values), m_num_writes_actual);
+}
+
+void test_BoundedDumpStopsAtDeadline(void)
+{
+    uint32_t test_values[] = {
+            0x11111111,
+            0x22222222,
+            0x33333333,
+            0x44444444,
+    };
+
+    TRACE_Init(&test_callbacks_with_write_check);
+    TRACE_Clear();
+    for(int i = 0; i < ARRAY_SIZE(test_values); i++)
+    {
+        TRACE_Put(test_values[i]);
+    }
+
+    m_expected_write_values = test_values;
+    m_deadline_checks_left = 2;
+    TEST_ASSERT_EQUAL_UINT32(2, DumpExecTraceLogBounded(DUMP_NO_LIMIT, deadline_reached));
+    TEST_ASSERT_EQUAL(2, m_num_writes_actual);
+}
+
+void test_BoundedDumpReleasesLock(void)
+{
+    TRACE_Init(&test_callbacks_with_lock);
+    TRACE_Put(0x11111111);
+    TRACE_Put(0x22222222);
+
+    /* The version trace from TRACE_Init() is written first */
+    TEST_ASSERT_EQUAL_UINT32(2, DumpExecTraceLogBounded(1, NULL));
+    TEST_ASSERT_TRUE(m_lock_called);
+    TEST_ASSERT_TRUE(m_write_called);
+    TEST_ASSERT_TRUE(m_unlock_called);
+}
+
+void test_BufferFullIndicationOccursWhenRecordIsDropped(void)
+{
+    TRACE_Init(&test_callbacks_with_write_check);
+    TRACE_Clear();
+
+    /**
+     * The 2-word record doesn't fit in the one free slot, so it is dropped
+     * without filling the buffer.
+     */
+    uint32_t test_values[] = {
+            0xFFFFFFFF,
+            0x11111111,
+            0x22222222,
+            0x33333333,
+            0x44444444,
+            0x55555555,
+            0x66666666,
+            0x77777777,
+    };
+
+    for(int i = 1; i < ARRAY_SIZE(test_values) - 1; i++)
+    {
+        TRACE_Put(test_values[i]);
+    }
+    TRACE_PutRecord2(0x60000066, 0xAAAAAAAA);
+    TEST_ASSERT_FALSE(TRACE_IsFull());
+
+    m_expected_write_values = test_values;
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(ARRAY_SIZE(test_values) - 1, m_num_writes_actual);
+
+    /* The loss is only indicated once */
+    TRACE_Put(test_values[ARRAY_SIZE(test_values) - 1]);
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL(ARRAY_SIZE(test_values), m_num_writes_actual);
+}
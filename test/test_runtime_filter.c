@@ -0,0 +1,142 @@
+/*
+ * test_runtime_filter.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+/* Include files ----------------------------------------------------------- */
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+/* Private macros ---------------------------------------------------------- */
+#define NOISY_MODULE        0x123
+#define QUIET_MODULE        0xABC
+
+#define ENTRY_AND_EXIT_MASK ((1 << TRACE_IDCODE_FUNC_ENTRY) | (1 << TRACE_IDCODE_FUNC_EXIT))
+#define ALWAYS_TRACED_MASK  ((1 << TRACE_IDCODE_VERSION) | (1 << TRACE_IDCODE_RESET))
+
+/* Private variables ------------------------------------------------------- */
+uint32_t filteredVariable = 0x12345678;
+static int m_num_evaluations;
+
+/* Set up and tear down ---------------------------------------------------- */
+void setUp(void)
+{
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL);
+    TRACE_SetModuleEnabled(TRACE_ALL_MODULES, true);
+    TRACE_Clear();
+    m_num_evaluations = 0;
+}
+
+void tearDown(void)
+{
+}
+
+/* Helper functions -------------------------------------------------------- */
+void filteredFunction(void)
+{
+    TRACE_FunctionEntry(filteredFunction);
+    TRACE_FunctionExit(filteredFunction);
+}
+
+uint32_t countedArgument(void)
+{
+    m_num_evaluations++;
+    return 0;
+}
+
+/* Test functions ---------------------------------------------------------- */
+void test_EverythingIsTracedByDefault(void)
+{
+    TEST_ASSERT_EQUAL_HEX32(TRACE_IDCODE_MASK_ALL, TRACE_GetIdCodeMask());
+    TEST_ASSERT_TRUE(TRACE_IsModuleEnabled(NOISY_MODULE));
+    TEST_ASSERT_TRUE(TRACE_IsModuleEnabled(QUIET_MODULE));
+    filteredFunction();
+    TEST_ASSERT_EQUAL_UINT32(2, TRACE_GetNumEntries());
+}
+
+void test_DisabledIdCodeIsDropped(void)
+{
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL & ~(1 << TRACE_IDCODE_FUNC_ENTRY));
+    filteredFunction();
+    TEST_ASSERT_EQUAL_UINT32(1, TRACE_GetNumEntries());
+    TEST_ASSERT_EQUAL_UINT32(TRACE_IDCODE_FUNC_EXIT, TRACE_Get() >> TRACE_IDCODE_Pos);
+}
+
+void test_ReenabledIdCodeIsTracedAgain(void)
+{
+    TRACE_SetIdCodeMask(0);
+    filteredFunction();
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+    TRACE_SetIdCodeMask(ENTRY_AND_EXIT_MASK);
+    filteredFunction();
+    TEST_ASSERT_EQUAL_UINT32(2, TRACE_GetNumEntries());
+}
+
+void test_VersionAndResetCanNotBeDisabled(void)
+{
+    TRACE_SetIdCodeMask(0);
+    TEST_ASSERT_EQUAL_HEX32(ALWAYS_TRACED_MASK, TRACE_GetIdCodeMask());
+    TRACE_ExecTracerVersion();
+    TRACE_ProcessorReset(0x20000000);
+    TEST_ASSERT_EQUAL_UINT32(TRACE_IDCODE_VERSION, TRACE_Get() >> TRACE_IDCODE_Pos);
+    TEST_ASSERT_EQUAL_UINT32(TRACE_IDCODE_RESET, TRACE_Get() >> TRACE_IDCODE_Pos);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_DisabledRecordIsDroppedWhole(void)
+{
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL & ~(1 << TRACE_IDCODE_VARIABLE_VALUE));
+    TRACE_VariableValue(filteredVariable);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_DisabledPrintfDoesNotEvaluateArguments(void)
+{
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL & ~(1 << TRACE_IDCODE_EXTENDED));
+    TRACE_Printf("%u", countedArgument());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+    TEST_ASSERT_EQUAL(0, m_num_evaluations);
+
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL);
+    TRACE_Printf("%u", countedArgument());
+    TEST_ASSERT_EQUAL_UINT32(2, TRACE_GetNumEntries());
+    TEST_ASSERT_EQUAL(1, m_num_evaluations);
+}
+
+void test_DisabledModuleLinesAreDropped(void)
+{
+    TRACE_SetModuleEnabled(NOISY_MODULE, false);
+    TEST_ASSERT_FALSE(TRACE_IsModuleEnabled(NOISY_MODULE));
+    TEST_ASSERT_TRUE(TRACE_IsModuleEnabled(QUIET_MODULE));
+
+    TRACE_Line(NOISY_MODULE);
+    TRACE_Line(QUIET_MODULE);
+    helper_VerifyLineTrace(QUIET_MODULE, __LINE__ - 1);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+
+    TRACE_SetModuleEnabled(NOISY_MODULE, true);
+    TRACE_Line(NOISY_MODULE);
+    helper_VerifyLineTrace(NOISY_MODULE, __LINE__ - 1);
+}
+
+void test_AllModulesCanBeDisabledAtOnce(void)
+{
+    TRACE_SetModuleEnabled(TRACE_ALL_MODULES, false);
+    TEST_ASSERT_FALSE(TRACE_IsModuleEnabled(0));
+    TEST_ASSERT_FALSE(TRACE_IsModuleEnabled(TRACE_MODULE_MAX));
+    TRACE_Line(QUIET_MODULE);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+
+    TRACE_SetModuleEnabled(QUIET_MODULE, true);
+    TRACE_Line(QUIET_MODULE);
+    TEST_ASSERT_EQUAL_UINT32(1, TRACE_GetNumEntries());
+}
+
+void test_DisabledLineIdCodeDropsEnabledModules(void)
+{
+    TRACE_SetIdCodeMask(TRACE_IDCODE_MASK_ALL & ~(1 << TRACE_IDCODE_FILE_AND_LINE));
+    TRACE_Line(QUIET_MODULE);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
@@ -0,0 +1,200 @@
+/*
+ * test_timestamps.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+
+#include "unity.h"
+#include "execution_tracer.h"
+#include "helper_functions.h"
+
+#define TEST_VALUE_1        0x11111111
+#define TEST_VALUE_2        0x22222222
+#define TEST_VALUE_3        0x33333333
+
+/* ID code 6 (variable value) makes this the header of a two-word record */
+#define TEST_RECORD_HEADER  0x60000066
+
+#define TIMESTAMP_HEADER(num_words, delta)                                  \
+    (((uint32_t)TRACE_IDCODE_EXTENDED << TRACE_IDCODE_Pos) |               \
+    ((num_words) << TRACE_EXT_LENGTH_Pos) |                                 \
+    (TRACE_EXT_TYPE_TIMESTAMP << TRACE_EXT_TYPE_Pos) |                      \
+    (delta))
+#define SYNC_HEADER                                                         \
+    (((uint32_t)TRACE_IDCODE_EXTENDED << TRACE_IDCODE_Pos) |               \
+    (1 << TRACE_EXT_LENGTH_Pos) |                                           \
+    (TRACE_EXT_TYPE_TIMESTAMP_SYNC << TRACE_EXT_TYPE_Pos))
+
+static uint32_t m_timestamp;
+static char     m_first_write[16];
+static int      m_num_writes;
+
+uint32_t fake_GetTimestamp(void)
+{
+    return m_timestamp;
+}
+
+void write(uint8_t * p_data, uint16_t size)
+{
+    if (m_num_writes++ == 0)
+    {
+        TEST_ASSERT_TRUE(size < sizeof(m_first_write));
+        memcpy(m_first_write, p_data, size);
+        m_first_write[size] = '\0';
+    }
+}
+ExecTraceCallbacks_t test_callbacks = {
+        .write = write,
+        .lock = NULL,
+        .unlock = NULL
+};
+
+void setUp(void)
+{
+    m_timestamp = 0;
+    m_num_writes = 0;
+    TRACE_Clear();
+}
+
+void tearDown(void)
+{
+}
+
+static void verify_sync(uint32_t exp_timestamp)
+{
+    TEST_ASSERT_EQUAL_HEX32(SYNC_HEADER, TRACE_Get());
+    TEST_ASSERT_EQUAL_UINT32(exp_timestamp, TRACE_Get());
+}
+
+static void verify_entry(uint32_t exp_delta, uint32_t exp_value)
+{
+    TEST_ASSERT_EQUAL_HEX32(TIMESTAMP_HEADER(1, exp_delta), TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(exp_value, TRACE_Get());
+}
+
+void test_FirstEntryIsPrecededBySync(void)
+{
+    m_timestamp = 0x12345678;
+    TRACE_Put(TEST_VALUE_1);
+
+    TEST_ASSERT_EQUAL_UINT32(4, TRACE_GetNumEntries());
+    verify_sync(0x12345678);
+    verify_entry(0, TEST_VALUE_1);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_EntriesCarryDeltaSincePreviousEntry(void)
+{
+    m_timestamp = 1000;
+    TRACE_Put(TEST_VALUE_1);
+    m_timestamp = 1010;
+    TRACE_Put(TEST_VALUE_2);
+    m_timestamp = 1010 + 0xFFFF;
+    TRACE_Put(TEST_VALUE_3);
+
+    verify_sync(1000);
+    verify_entry(0, TEST_VALUE_1);
+    verify_entry(10, TEST_VALUE_2);
+    verify_entry(0xFFFF, TEST_VALUE_3);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_DeltaTooLargeForHeaderIsTracedAsSync(void)
+{
+    m_timestamp = 1000;
+    TRACE_Put(TEST_VALUE_1);
+    m_timestamp = 1000 + 0x10000;
+    TRACE_Put(TEST_VALUE_2);
+
+    verify_sync(1000);
+    verify_entry(0, TEST_VALUE_1);
+    verify_sync(1000 + 0x10000);
+    verify_entry(0, TEST_VALUE_2);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_SyncIsTracedPeriodically(void)
+{
+    for (int i = 0; i < TIMESTAMP_SYNC_INTERVAL + 1; i++)
+    {
+        m_timestamp += 5;
+        TRACE_Put(TEST_VALUE_1);
+    }
+
+    verify_sync(5);
+    verify_entry(0, TEST_VALUE_1);
+    for (int i = 1; i < TIMESTAMP_SYNC_INTERVAL; i++)
+    {
+        verify_entry(5, TEST_VALUE_1);
+    }
+    verify_sync(5 * (TIMESTAMP_SYNC_INTERVAL + 1));
+    verify_entry(0, TEST_VALUE_1);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_RecordIsTimestampPayload(void)
+{
+    m_timestamp = 7;
+    TRACE_Put(TEST_VALUE_1);
+    m_timestamp = 9;
+    TRACE_PutRecord2(TEST_RECORD_HEADER, TEST_VALUE_2);
+
+    verify_sync(7);
+    verify_entry(0, TEST_VALUE_1);
+    TEST_ASSERT_EQUAL_HEX32(TIMESTAMP_HEADER(2, 2), TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(TEST_RECORD_HEADER, TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(TEST_VALUE_2, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_OverwriteDiscardsTimestampWithItsEntry(void)
+{
+    int num_syncs = 0;
+
+    /* Overfill the buffer. Every entry takes two words, and every
+     * TIMESTAMP_SYNC_INTERVAL entries are preceded by a two-word sync. */
+    for (uint32_t i = 1; i <= BUFFER_LENGTH_IN_WORDS; i++)
+    {
+        m_timestamp++;
+        TRACE_Put(i);
+    }
+
+    /* Whatever is oldest, it is a whole record: either a sync or a
+     * timestamp with its entry */
+    while (!TRACE_IsEmpty())
+    {
+        uint32_t header = TRACE_Get();
+        if (header == SYNC_HEADER)
+        {
+            num_syncs++;
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL_HEX32(TIMESTAMP_HEADER(1, 0), header & ~TRACE_EXT_DATA_Msk);
+        }
+        TEST_ASSERT_TRUE(TRACE_Get() <= BUFFER_LENGTH_IN_WORDS);
+    }
+    /* Absolute time can still be recovered from what is left */
+    TEST_ASSERT_TRUE(num_syncs > 0);
+}
+
+void test_OverwriteIsFlaggedInDump(void)
+{
+    TRACE_Init(&test_callbacks);
+    TRACE_Clear();
+
+    /* Every record takes two words, so overwriting leaves one slot free and
+     * the buffer never counts as full */
+    for (uint32_t i = 1; i <= BUFFER_LENGTH_IN_WORDS; i++)
+    {
+        m_timestamp += 10;
+        TRACE_Put(i);
+    }
+    TEST_ASSERT_FALSE(TRACE_IsFull());
+
+    DumpExecTraceLog();
+    TEST_ASSERT_EQUAL_STRING("0xFFFFFFFF\n", m_first_write);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
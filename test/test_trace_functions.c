@@ -84,6 +84,13 @@ void test_TraceLine(void)
     helper_VerifyLineTrace(TRACE_MODULE, SECOND_TRACED_LINE);
 }
 
+void test_TraceLineUsesGivenModule(void)
+{
+    TRACE_Line(0xABC);      /* Any 12-bit TRACE_MODULE_ID */
+    helper_VerifyLineTrace(0xABC, __LINE__ - 1);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
 uint32_t testVariable = TEST_VALUE_A;
 void test_TraceVariable(void)
 {
@@ -102,3 +109,64 @@ void test_TraceSFR(void)
     helper_VerifySFRTrace(&someMemoryMappedPeripheralRegister,
             someMemoryMappedPeripheralRegister);
 }
+
+#define PRINTF_HEADER(num_args)                                             \
+    (((uint32_t)TRACE_IDCODE_EXTENDED << TRACE_IDCODE_Pos) |               \
+    ((num_args) << TRACE_EXT_LENGTH_Pos) |                                  \
+    (TRACE_EXT_TYPE_PRINTF << TRACE_EXT_TYPE_Pos))
+#define PRINTF_HEADER_Msk       (~TRACE_EXT_DATA_Msk)
+
+void tracedPrintfs(void)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        TRACE_Printf("Loop %d", i);
+    }
+    TRACE_Printf("After the loop");
+}
+
+void test_TracePrintf(void)
+{
+    int32_t negative = -2;
+    char letter = 'x';
+
+    TRACE_Printf("%d %c %u", negative, letter, TEST_VALUE_A);
+    TEST_ASSERT_EQUAL_HEX32(PRINTF_HEADER(3), TRACE_Get() & PRINTF_HEADER_Msk);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFE, TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32('x', TRACE_Get());
+    TEST_ASSERT_EQUAL_HEX32(TEST_VALUE_A, TRACE_Get());
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+/* As with function addresses, the format string's address may be truncated
+ * on the host. Each call site still has its own. */
+void test_TracePrintfFormatIdentifiesCallSite(void)
+{
+    uint32_t first;
+    uint32_t second;
+    uint32_t after;
+
+    tracedPrintfs();
+    first = TRACE_Get();
+    TEST_ASSERT_EQUAL_HEX32(PRINTF_HEADER(1), first & PRINTF_HEADER_Msk);
+    TEST_ASSERT_EQUAL_UINT32(0, TRACE_Get());
+    second = TRACE_Get();
+    TEST_ASSERT_EQUAL_UINT32(1, TRACE_Get());
+    after = TRACE_Get();
+    TEST_ASSERT_EQUAL_HEX32(PRINTF_HEADER(0), after & PRINTF_HEADER_Msk);
+    TEST_ASSERT_EQUAL_HEX32(first, second);
+    TEST_ASSERT_NOT_EQUAL(first, after);
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
+
+void test_TracePrintfMaxArguments(void)
+{
+    TRACE_Printf("%u %u %u %u %u %u %u %u %u %u %u %u %u %u",
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14);
+    TEST_ASSERT_EQUAL_HEX32(PRINTF_HEADER(TRACE_PRINTF_MAX_ARGS), TRACE_Get() & PRINTF_HEADER_Msk);
+    for (uint32_t i = 1; i <= TRACE_PRINTF_MAX_ARGS; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(i, TRACE_Get());
+    }
+    TEST_ASSERT_TRUE(TRACE_IsEmpty());
+}
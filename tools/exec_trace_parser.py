@@ -1,3 +1,10 @@
+import binascii
+import bisect
+import collections
+import re
+import struct
+import sys
+
 class TraceReaderInterface:
     """Interface expected by ExecTraceParser for returning trace buffer values.
 
@@ -9,6 +16,10 @@ class TraceReaderInterface:
     """Value to return after the last value has been read."""
     END_OF_TRACE_BUFFER = -1
 
+    """Value to return where entries are known to be missing. Readers that
+    return it provide the number of missing entries in last_loss."""
+    ENTRIES_LOST = -2
+
     def read_next(self) -> int:
         """Return the next value from the trace buffer.
 
@@ -21,14 +32,592 @@ class TraceReaderInterface:
         """
         pass
 
+    def tell(self):
+        """Return the byte offset in the stream at which a new reader would
+        continue with the next value, or None if there is none because
+        reading is partway through a record or frame. Readers of files
+        implement this for trace_index.py."""
+        return None
+
+class ListTraceReader(TraceReaderInterface):
+    """Return values from a list, such as the payload of an extended record."""
+    def __init__(self, values):
+        self.values = list(values)
+
+    def read_next(self) -> int:
+        if self.values:
+            return self.values.pop(0)
+        return TraceReaderInterface.END_OF_TRACE_BUFFER
+
+class CompactTraceReader(TraceReaderInterface):
+    """Expand a trace buffer dumped in the compact format into trace values.
+
+    With COMPACT_ENCODING, DumpExecTraceLog() in DUMP_FORMAT_RAW_BINARY
+    writes halfwords. Function entry and exit are a single halfword. Anything
+    else follows an escape halfword as full-width words, each written as two
+    halfwords, low half first. See execution_tracer_protocol.h.
+    """
+
+    """Escape halfword that precedes a full-width record."""
+    ESCAPE = 0xFFFF
+
+    def __init__(self, halfword_reader: TraceReaderInterface):
+        """Initializes the compact trace reader.
+
+        Args:
+          halfword_reader: A trace reader whose read_next() returns 16-bit
+                           values, such as a binary reader with a word size
+                           of 2.
+        """
+        self.halfword_reader = halfword_reader
+        # Full-width words of an escaped record not yet returned
+        self.pending = []
+
+    def tell(self):
+        if self.pending:
+            return None
+        return self.halfword_reader.tell()
+
+    def read_word(self):
+        low = self.halfword_reader.read_next()
+        if low == TraceReaderInterface.END_OF_TRACE_BUFFER:
+            return low
+        high = self.halfword_reader.read_next()
+        if high == TraceReaderInterface.END_OF_TRACE_BUFFER:
+            return high
+        return (high << 16) | low
+
+    def read_next(self) -> int:
+        if self.pending:
+            return self.pending.pop(0)
+
+        halfword = self.halfword_reader.read_next()
+        if halfword == TraceReaderInterface.END_OF_TRACE_BUFFER:
+            return halfword
+        if halfword != CompactTraceReader.ESCAPE:
+            idcode = 4 if (halfword & 0x8000) else 3
+            return (idcode << 28) | ((halfword & 0x7FFF) << 1)
+
+        header = self.read_word()
+        if header == TraceReaderInterface.END_OF_TRACE_BUFFER:
+            return header
+        for i in range(1, record_length(header)):
+            word = self.read_word()
+            if word == TraceReaderInterface.END_OF_TRACE_BUFFER:
+                break
+            self.pending.append(word)
+        return header
+
+def cobs_decode(data):
+    """Return the bytes COBS encoded in data, or None if data is not a valid
+    COBS encoding. data must not include the frame delimiter."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+"""First character of the lines written by DumpExecTraceLog() with
+DUMP_FORMAT_BASE64_TEXT."""
+BASE64_LINE_START = '$'
+
+def base64_line_values(line):
+    """Return the trace values in one line written with
+    DUMP_FORMAT_BASE64_TEXT. See execution_tracer_protocol.h.
+
+    Args:
+      line: The line as str or bytes, starting with BASE64_LINE_START. Line
+            endings are ignored.
+
+    Raises:
+      ValueError: If the line is not valid base64 of whole words.
+    """
+    if isinstance(line, str):
+        line = line.encode('ascii')
+    data = binascii.a2b_base64(line[1:].strip())
+    if len(data) % 4:
+        raise ValueError("Base64 line does not hold whole trace values: %r" % line)
+    return list(struct.unpack('<%uI' % (len(data) // 4), data))
+
+class FramedTraceReader(TraceReaderInterface):
+    """Read trace values from the frames written by DumpExecTraceLog() with
+    DUMP_FORMAT_FRAMED. See execution_tracer_protocol.h.
+
+    Frames that fail their CRC check are dropped. The sequence number of the
+    next good frame then shows how many entries were lost, which read_next()
+    reports with ENTRIES_LOST before returning the frame's entries. Reading
+    may start anywhere in the stream; bytes before the first delimiter are
+    skipped.
+
+    Counters:
+      frames_received: Frames that decoded correctly.
+      frames_corrupt: Frames dropped for a bad encoding or CRC.
+      entries_lost: Entries missing from the sequence, in total.
+      last_loss: Entries missing at the last ENTRIES_LOST.
+    """
+
+    """Matches the TRACE_FRAME_ defines in execution_tracer_protocol.h"""
+    DELIMITER = 0x00
+    SEQ_SIZE = 4
+    CRC_SIZE = 2
+    STACK_DEPTH = 16
+    TOKEN_EXIT = 0
+
+    def __init__(self, read_chunk, offset=0):
+        """Initializes the framed trace reader.
+
+        Args:
+          read_chunk: Function returning the next bytes received, as many as
+                      are available. It may block, and returns an empty
+                      bytes object at the end of the stream.
+          offset: Byte offset in the stream of the first bytes read_chunk
+                  returns, for tell().
+        """
+        self.read_chunk = read_chunk
+        self.buffer = bytearray()
+        # Byte offset in the stream of the end of the buffer
+        self.offset = offset
+        self.pending = collections.deque()
+        self.next_seq = None
+        self.synchronized = False
+        self.frames_received = 0
+        self.frames_corrupt = 0
+        self.entries_lost = 0
+        self.last_loss = 0
+
+    def read_frame(self):
+        """Return the next frame, still COBS encoded, or None at the end of
+        the stream."""
+        while True:
+            end = self.buffer.find(FramedTraceReader.DELIMITER)
+            if end >= 0:
+                frame = bytes(self.buffer[:end])
+                del self.buffer[:end + 1]
+                return frame
+            chunk = self.read_chunk()
+            if not chunk:
+                return None
+            self.buffer += chunk
+            self.offset += len(chunk)
+
+    def tell(self):
+        """Return the offset of the next frame, if all values of the frames
+        before it have been read."""
+        if self.pending:
+            return None
+        return self.offset - len(self.buffer)
+
+    @staticmethod
+    def decode_tokens(data):
+        """Return the trace values of a frame's tokens, or None if they are
+        not valid."""
+        values = []
+        open_entries = []
+        i = 0
+        while i < len(data):
+            token = 0
+            shift = 0
+            while True:
+                if i >= len(data):
+                    return None
+                byte = data[i]
+                i += 1
+                token |= (byte & 0x7F) << shift
+                shift += 7
+                if byte < 0x80:
+                    break
+
+            if token == FramedTraceReader.TOKEN_EXIT:
+                if not open_entries:
+                    return None
+                value = (4 << 28) | open_entries.pop()
+            elif token & 1:
+                token >>= 1
+                value = ((token >> 4) | (token << 28)) & 0xFFFFFFFF
+                if (value >> 28) == 3 and len(open_entries) < FramedTraceReader.STACK_DEPTH:
+                    open_entries.append(value & 0x0FFFFFFF)
+            else:
+                return None
+            values.append(value)
+        return values
+
+    def decode_frame(self, frame):
+        """Return the tuple (sequence number, values) of a COBS encoded
+        frame, or None if it is corrupt."""
+        data = cobs_decode(frame)
+        if data is None or len(data) < FramedTraceReader.SEQ_SIZE + FramedTraceReader.CRC_SIZE:
+            return None
+        crc = int.from_bytes(data[-FramedTraceReader.CRC_SIZE:], 'little')
+        data = data[:-FramedTraceReader.CRC_SIZE]
+        if binascii.crc_hqx(data, 0xFFFF) != crc:
+            return None
+        values = FramedTraceReader.decode_tokens(data[FramedTraceReader.SEQ_SIZE:])
+        if values is None:
+            return None
+        return (int.from_bytes(data[:FramedTraceReader.SEQ_SIZE], 'little'), values)
+
+    def read_next(self) -> int:
+        if self.pending:
+            return self.pending.popleft()
+
+        while True:
+            frame = self.read_frame()
+            if frame is None:
+                return TraceReaderInterface.END_OF_TRACE_BUFFER
+            decoded = self.decode_frame(frame)
+            if decoded is None:
+                # The stream may start partway through a frame
+                if self.synchronized:
+                    self.frames_corrupt += 1
+                continue
+            self.synchronized = True
+            self.frames_received += 1
+            seq, values = decoded
+
+            loss = 0
+            if self.next_seq is not None:
+                gap = (seq - self.next_seq) & 0xFFFFFFFF
+                # A sequence number that goes backwards means the target
+                # restarted, not that entries were lost.
+                if gap < 0x80000000:
+                    loss = gap
+            self.next_seq = (seq + len(values)) & 0xFFFFFFFF
+            self.pending.extend(values)
+            if loss:
+                self.entries_lost += loss
+                self.last_loss = loss
+                return TraceReaderInterface.ENTRIES_LOST
+            if self.pending:
+                return self.pending.popleft()
+
+def record_length(header):
+    """Return the number of words in the record that starts with header.
+
+    Matches TRACE_RecordLength() in execution_tracer.h.
+    """
+    idcode = (header >> 28) & 0xF
+    if idcode == 6 or idcode == 7:
+        return 2
+    elif idcode == 8:
+        return 1 + ((header >> 24) & 0xF)
+    return 1
+
+class SymbolIndex:
+    """Resolve any address inside a symbol to the symbol and an offset.
+
+    Symbols are kept as address intervals sorted by start address and found
+    by binary search, so lookups stay fast with tens of thousands of symbols.
+    Where intervals overlap, the earlier one is cut short at the start of the
+    later one. Of several symbols at the same address, the largest is kept.
+    """
+    def __init__(self, intervals):
+        """Build the index.
+
+        Args:
+          intervals: Iterable of (address, size, name) tuples. A size of 0
+                     means the size is unknown; such a symbol only matches its
+                     own address.
+        """
+        self.starts = []
+        self.ends = []
+        self.sizes = []
+        self.names = []
+        for address, size, name in sorted(intervals, key=lambda i: (i[0], -i[1])):
+            if self.starts and address == self.starts[-1]:
+                continue
+            if self.ends and self.ends[-1] > address:
+                self.ends[-1] = address
+            self.starts.append(address)
+            self.ends.append(address + max(size, 1))
+            self.sizes.append(size)
+            self.names.append(name)
+
+    @classmethod
+    def from_sorted(cls, starts, ends, sizes, names):
+        """Wrap sequences that already hold the contents of an index, such as
+        those memory-mapped from the symbol cache. See symbol_cache.py."""
+        index = cls([])
+        index.starts = starts
+        index.ends = ends
+        index.sizes = sizes
+        index.names = names
+        return index
+
+    def lookup(self, address):
+        """Return the tuple (name, offset) for the symbol containing address,
+        or (None, 0) if there is none."""
+        i = bisect.bisect_right(self.starts, address) - 1
+        if i >= 0 and address < self.ends[i]:
+            return (self.names[i], address - self.starts[i])
+        return (None, 0)
+
+def symbol_intervals(symbols):
+    """Return (address, size, name) tuples for a dictionary that maps
+    addresses to parse_map_file.MapSymbol objects or plain names."""
+    if not symbols:
+        return []
+    return [(address, getattr(symbol, 'size', 0), getattr(symbol, 'name', symbol))
+            for address, symbol in symbols.items()]
+
+def register_intervals(registers):
+    """Return (address, size, name) tuples for the registers, and for the
+    peripherals that hold them, in a dictionary that maps addresses to
+    parse_svd.PeripheralRegister objects."""
+    if not registers:
+        return ([], [])
+    register_list = []
+    peripheral_list = {}
+    for address, register in registers.items():
+        register_list.append((address, getattr(register, 'size', 4),
+                              "%s->%s" % (register.peripheral_name, register.register_name)))
+        peripheral_address = getattr(register, 'peripheral_address', 0)
+        peripheral_size = getattr(register, 'peripheral_size', 0)
+        if peripheral_size:
+            peripheral_list[register.peripheral_name] = (peripheral_address, peripheral_size,
+                                                         register.peripheral_name)
+    return (register_list, list(peripheral_list.values()))
+
+def make_symbol_index(symbols):
+    """Return a SymbolIndex for a dictionary of functions or variables.
+    Tables loaded from the symbol cache are indexed already."""
+    if hasattr(symbols, 'symbol_index'):
+        return symbols.symbol_index()
+    return SymbolIndex(symbol_intervals(symbols))
+
+def make_register_indexes(registers):
+    """Return the tuple (register_index, peripheral_index) for a dictionary
+    of registers. Tables loaded from the symbol cache are indexed already."""
+    if hasattr(registers, 'symbol_indexes'):
+        return registers.symbol_indexes()
+    register_list, peripheral_list = register_intervals(registers)
+    return (SymbolIndex(register_list), SymbolIndex(peripheral_list))
+
+def format_symbol(name, offset):
+    """Return name, followed by the offset into the symbol if there is one."""
+    if offset:
+        return "%s + 0x%X" % (name, offset)
+    return name
+
+"""Extended record types. See TRACE_EXT_TYPE_ in execution_tracer_protocol.h."""
+EXT_TYPE_TIMESTAMP = 1
+EXT_TYPE_TIMESTAMP_SYNC = 2
+EXT_TYPE_PRINTF = 3
+
+"""A printf() conversion specification: flags, width, precision, length
+modifier and conversion."""
+PRINTF_CONVERSION = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?(.)', re.DOTALL)
+
+def format_printf(format, args):
+    """Format a TRACE_Printf() message the way printf() would have on target.
+
+    Args are 32-bit words. They are signed for %d and %i, and unsigned for
+    the other integer conversions, and the h and hh length modifiers narrow
+    them as on target. %c takes a character code and %p an address.
+    Conversions that can't be done from the words alone (%s, %n and floating
+    point) are shown as the raw word in hex instead, and missing arguments as
+    "?".
+    """
+    args = iter(args)
+    missing = object()
+
+    def convert(match):
+        flags, width, precision, length, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        if width == '*':
+            width = next(args, missing)
+            if width is missing:
+                return '?'
+            width = str(width - (1 << 32) if width & 0x80000000 else width)
+            if width.startswith('-'):
+                flags, width = flags + '-', width[1:]
+        if precision == '*':
+            precision = next(args, missing)
+            if precision is missing:
+                return '?'
+            precision = None if precision & 0x80000000 else str(precision)
+        value = next(args, missing)
+        if value is missing:
+            return '?'
+        spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '')
+        bits = {'hh': 8, 'h': 16}.get(length, 32)
+        value &= (1 << bits) - 1
+        if conversion in 'di':
+            return (spec + 'd') % (value - (1 << bits) if value >> (bits - 1) else value)
+        if conversion == 'o' and '#' in flags:
+            # Python's alternate form is "0o"; C's is a leading 0
+            text = '%o' % value
+            return ('%' + flags.replace('#', '').replace('0', '') + (width or '') + 's') % (
+                    text if text.startswith('0') else '0' + text)
+        if conversion in 'ouxX':
+            return (spec + conversion) % value
+        if conversion == 'c':
+            return ('%' + flags + (width or '') + 'c') % chr(value & 0xFF)
+        if conversion == 'p':
+            return ('%' + flags + (width or '') + 's') % ('0x%x' % value)
+        return '<0x%08X>' % value
+
+    return PRINTF_CONVERSION.sub(convert, format)
+
+class CallStack:
+    """Reconstructs function call nesting from entry and exit traces.
+
+    Traces don't always pair up. A buffer captured with ALLOW_OVERWRITE
+    starts partway down the call stack, and around a buffer full indication
+    or lost entries, any number of entries and exits may be missing. Rather
+    than counting entries and exits, the stack of open calls is kept so that
+    an exit can be matched with its entry:
+      - An exit that matches a call further down the stack also ends the
+        calls above it; Their exits were missed.
+      - An exit that matches no call had its entry before the capture
+        started, or lost. The depth is left as it is, unless entries were
+        lost; Then the innermost call is taken to have ended too.
+      - The stack is cleared by a version or reset entry, which are traced
+        when the target starts.
+
+    After entries are lost, the stack may hold calls that have already ended,
+    so the depth is uncertain. It becomes certain again once an exit matches
+    a call that was open before the loss, which shows that everything above
+    that call has ended. An exit that matches no call while calls are open
+    also makes the depth uncertain.
+
+    Counters:
+      missed_exits: Calls ended by the exit of a call further down.
+      inferred_entries: Exits that matched no call.
+      resyncs: Times the depth became certain again.
+    """
+    def __init__(self):
+        # Addresses of the open calls, innermost last
+        self.frames = []
+        self.uncertain = False
+        # Calls below this depth were open before the depth became uncertain
+        self.certain_depth = 0
+        self.missed_exits = 0
+        self.inferred_entries = 0
+        self.resyncs = 0
+
+    def depth(self):
+        return len(self.frames)
+
+    def enter(self, address):
+        """Open a call of the function at address. Returns the depth of the
+        call; The number of calls open before it."""
+        self.frames.append(address)
+        return len(self.frames) - 1
+
+    def exit(self, address):
+        """End the innermost call of the function at address. Returns the
+        depth of the call, or the current depth if it matches no open
+        call."""
+        frames = self.frames
+        for i in range(len(frames) - 1, -1, -1):
+            if frames[i] == address:
+                break
+        else:
+            self.inferred_entries += 1
+            if self.uncertain:
+                # Balance the lost entry with the innermost call, which is
+                # as likely to have ended while entries were lost.
+                if frames:
+                    frames.pop()
+                    self.certain_depth = min(self.certain_depth, len(frames))
+            elif frames:
+                self.lose()
+            return len(frames)
+
+        self.missed_exits += len(frames) - 1 - i
+        del frames[i:]
+        if self.uncertain and i < self.certain_depth:
+            self.uncertain = False
+            self.resyncs += 1
+        return i
+
+    def lose(self):
+        """Note that entries were lost, so the depth is uncertain."""
+        if not self.uncertain:
+            self.uncertain = True
+            self.certain_depth = len(self.frames)
+        else:
+            self.certain_depth = min(self.certain_depth, len(self.frames))
+
+    def reset(self):
+        """Clear the stack when the target restarts."""
+        self.frames.clear()
+        self.uncertain = False
+
+"""Kinds of TraceEvent."""
+EVENT_VERSION = 'version'
+EVENT_RESET = 'reset'
+EVENT_ENTER = 'enter'
+EVENT_EXIT = 'exit'
+EVENT_LINE = 'line'
+EVENT_VARIABLE = 'variable'
+EVENT_SFR = 'sfr'
+EVENT_UNKNOWN = 'unknown'
+EVENT_BUFFER_FULL = 'buffer_full'
+EVENT_ENTRIES_LOST = 'entries_lost'
+EVENT_PRINTF = 'printf'
+
+class TraceEvent:
+    """One decoded trace entry or record.
+
+    Attributes:
+      kind: One of the EVENT_ constants.
+      depth: Function call nesting depth; The indent of the event's line in
+             text output. See CallStack.
+      uncertain: True if the depth may be wrong because entries were lost.
+      address: MCU address of the function, variable or register.
+      name: Name the address resolved to (as for get_func_name(), but without
+            the fallback), or None if lookup failed. The formatted message of
+            an EVENT_PRINTF. The file name of an EVENT_LINE's module, if
+            known.
+      value: Variable or register value, reset value, line number, extended
+             record type (EVENT_UNKNOWN), entry count (EVENT_ENTRIES_LOST),
+             format string address (EVENT_PRINTF) or raw version entry
+             (EVENT_VERSION, whose name is "V<major>.<minor>").
+      module: Module number of an EVENT_LINE.
+      payload: Payload values of an EVENT_UNKNOWN, or the arguments of an
+               EVENT_PRINTF.
+      timestamp: Absolute timestamp of a timestamped entry, UNKNOWN_TIMESTAMP
+                 if it was traced before the first sync record, or None.
+    """
+    __slots__ = ('kind', 'depth', 'address', 'name', 'value', 'module', 'payload', 'timestamp', 'uncertain')
+
+    UNKNOWN_TIMESTAMP = -1
+
+    def __init__(self, kind, depth=0, address=None, name=None, value=None, module=None, payload=None):
+        self.kind = kind
+        self.depth = depth
+        self.address = address
+        self.name = name
+        self.value = value
+        self.module = module
+        self.payload = payload
+        self.timestamp = None
+        self.uncertain = False
+
+    def __repr__(self):
+        fields = ('%s=%r' % (field, getattr(self, field)) for field in self.__slots__
+                  if getattr(self, field) not in (None, False))
+        return 'TraceEvent(%s)' % ', '.join(fields)
+
 class ExecTraceParser:
-    """Translates trace buffer values into human readable text."""
+    """Translates trace buffer values into TraceEvent objects, or into human
+    readable text."""
     def __init__(self, functions, variables, registers):
         """Initialize the parser with all of the look-up dictionaries.
 
         Args:
-          functions: Dictionary that maps MCU addresses to function names.
-          variables: Dictionary that maps MCU addresses to variable names.
+          functions: Dictionary that maps MCU addresses to
+                     parse_map_file.MapSymbol objects for functions.
+          variables: Dictionary that maps MCU addresses to
+                     parse_map_file.MapSymbol objects for variables.
           registers: Dictionary that maps MCU addresses to
                      parse_svd.PeripheralRegister objects.
 
@@ -41,11 +630,34 @@ class ExecTraceParser:
         self.functions = functions
         self.variables = variables
         self.registers = registers
+        # Addresses anywhere inside a symbol are resolved through these
+        self.function_index = make_symbol_index(functions)
+        self.variable_index = make_symbol_index(variables)
+        self.register_index, self.peripheral_index = make_register_indexes(registers)
         self.FLASH_BASE = 0
         self.RAM_BASE = 0
         self.SFR_BASE = 0
-        # The indent level is used to keep of nested function calls.
-        self.indent_level = 0
+        # Nesting of function calls, which sets the indent of text output
+        self.call_stack = CallStack()
+        # Maps extended record types to functions taking (header, payload).
+        self.extended_handlers = {
+            EXT_TYPE_TIMESTAMP: self.trace_timestamp,
+            EXT_TYPE_TIMESTAMP_SYNC: self.trace_timestamp_sync,
+            EXT_TYPE_PRINTF: self.trace_printf,
+        }
+        # TRACE_Printf() format strings by address; See set_format_strings()
+        self.format_strings = {}
+        # File names by TRACE_Line() module number; See set_module_names()
+        self.module_names = {}
+        # Absolute timestamp of the last timestamped entry, or None until a
+        # sync record has been seen.
+        self.timestamp = None
+        # Timestamp given to events while decoding a timestamped entry
+        self.event_timestamp = None
+        # Events decoded but not yet returned by events()
+        self.pending_events = []
+        # Function names by address; Most traces are function entry and exit
+        self.func_names = {}
 
     def set_flash_base(self, flash_base):
         """Set the base address for the MCU's flash region."""
@@ -60,29 +672,34 @@ class ExecTraceParser:
         """Set the base address for the MCU's peripherals region."""
         self.SFR_BASE = sfr_base
 
-    def inc_indent(self):
-        """Increments the indent level for trace output."""
-        self.indent_level = self.indent_level + 1
+    def set_format_strings(self, format_strings):
+        """Set the dictionary that maps format string addresses to the format
+        strings of TRACE_Printf(), as returned by
+        parse_elf_file.read_elf_format_strings()."""
+        self.format_strings = format_strings
 
-    def dec_indent(self):
-        """Decreases the indent level for trace output."""
-        if self.indent_level > 0:
-            self.indent_level = self.indent_level - 1
+    def set_module_names(self, module_names):
+        """Set the dictionary that maps TRACE_Line() module numbers to file
+        names, as returned by symbol_cache.load_module_names()."""
+        self.module_names = module_names
 
-    def print_indent(self):
-        """Outputs the indent for a single trace line."""
-        for i in range(0, self.indent_level):
-            print("  ", end="")
+    def save_state(self):
+        """Return what decoding the next entry depends on from the entries
+        before it, as the tuple (frames, uncertain, certain_depth, timestamp).
+        See CallStack for the first three; timestamp is None until a sync
+        record has been seen."""
+        call_stack = self.call_stack
+        return (tuple(call_stack.frames), call_stack.uncertain, call_stack.certain_depth, self.timestamp)
 
-    def reset_indent(self):
-        """Resets the indent level.
-
-        This is necessary if the traces continue through a fault situation and
-        into a restart of the MCU. The nesting must be reset to 0. The parser
-        knows of this condition due to the trace parser version trace, which is
-        part of (re)initialization of the execution tracer on startup.
-        """
-        self.indent_level = 0
+    def restore_state(self, state):
+        """Continue decoding from a state returned by save_state(), such as
+        after seeking in a log file."""
+        frames, uncertain, certain_depth, self.timestamp = state
+        call_stack = self.call_stack
+        # events() holds on to the list, so it is changed in place
+        call_stack.frames[:] = frames
+        call_stack.uncertain = uncertain
+        call_stack.certain_depth = certain_depth
 
     def get_func_name(self, value):
         """Translate a raw trace value into its corresponding function name.
@@ -91,12 +708,13 @@ class ExecTraceParser:
           value: A raw function entry or function exit trace buffer value.
 
         Returns:
-          If lookup succeeds: the function's name.
+          If lookup succeeds: the function's name, followed by " + <offset>"
+            if the address is inside the function rather than at its start.
           If lookup fails: the string "Function @ <address>"
         """
-        func_addr = (value & 0xFFFFFFE) + self.FLASH_BASE
-        if func_addr in self.functions.keys():
-            return self.functions[func_addr]
+        func_addr, name = self.lookup_func(value)
+        if name is not None:
+            return name
         else:
             return "Function @ 0x%08X" % func_addr
 
@@ -107,12 +725,14 @@ class ExecTraceParser:
           value: A raw variable trace buffer value.
 
         Returns:
-          If lookup succeeds: the variable's name.
+          If lookup succeeds: the variable's name, followed by " + <offset>"
+            for a struct member or array element.
           If lookup fails: the string "Variable @ <address>"
         """
         var_addr = (value & 0xFFFFFFE) + self.RAM_BASE
-        if var_addr in self.variables.keys():
-            return self.variables[var_addr]
+        name, offset = self.variable_index.lookup(var_addr)
+        if name is not None:
+            return format_symbol(name, offset)
         else:
             return "Variable @ 0x%08X" % var_addr
 
@@ -128,70 +748,157 @@ class ExecTraceParser:
             Examples: "USART1->CR1"
                       "TIM2->CCR1"
                       "RCC->PLLCFGR"
+            followed by " + <offset>" for an access inside a register. An
+            address between registers is named after its peripheral instead
+            (e.g. "USART1 + 0x1C").
           If lookup fails: the string "SFR @ <address>"
         """
         sfr_addr = (value & 0xFFFFFFE) + self.SFR_BASE
-        if sfr_addr in self.registers.keys():
-            peripheral_register = self.registers[sfr_addr]
-            return "%s->%s" % (peripheral_register.peripheral_name, peripheral_register.register_name)
+        name, offset = self.register_index.lookup(sfr_addr)
+        if name is None:
+            name, offset = self.peripheral_index.lookup(sfr_addr)
+        if name is not None:
+            return format_symbol(name, offset)
         else:
             return "SFR @ 0x%08X" % sfr_addr
 
+    def lookup_func(self, value):
+        """Return the tuple (address, name) for a function entry or exit trace
+        value. name is as for get_func_name(), or None if lookup fails."""
+        func_addr = (value & 0xFFFFFFE) + self.FLASH_BASE
+        name = self.func_names.get(func_addr, False)
+        if name is False:
+            name, offset = self.function_index.lookup(func_addr)
+            if name is not None:
+                name = format_symbol(name, offset)
+            self.func_names[func_addr] = name
+        return (func_addr, name)
+
+    def emit(self, event):
+        """Queue an event for events() to return."""
+        event.timestamp = self.event_timestamp
+        event.uncertain = self.call_stack.uncertain
+        self.pending_events.append(event)
+
     def trace_version(self, value):
-        """Translate a TRACE_ExecTracerVersion() trace to human readable output."""
+        """Translate a TRACE_ExecTracerVersion() trace to an event."""
         ver_char = (value >> 16) & 0xFF
         ver_major = (value >> 8) & 0xFF
         ver_minor = (value >> 0) & 0xFF
-        self.reset_indent()
-        print("**** Tracer protocol version %c%d.%d ****" % (ver_char, ver_major, ver_minor))
+        # Traced on (re)initialization of the execution tracer on startup,
+        # so calls from before a fault or restart will never exit.
+        self.call_stack.reset()
+        self.emit(TraceEvent(EVENT_VERSION, 0, name="%c%d.%d" % (ver_char, ver_major, ver_minor), value=value))
 
     def trace_reset(self, value):
-        """Translate a TRACE_ProcessorReset() trace to human readable output."""
-        self.print_indent()
-        print("Processor reset: 0x%02X" % value)
+        """Translate a TRACE_ProcessorReset() trace to an event."""
+        self.call_stack.reset()
+        self.emit(TraceEvent(EVENT_RESET, 0, value=value))
 
     def trace_func_entry(self, value):
-        """Translate a TRACE_FunctionEntry() trace to human readable output."""
-        self.print_indent()
-        print("Enter %s" % self.get_func_name(value))
-        # Increment indent after Enter statement
-        # This is like an opening brace
-        self.inc_indent()
+        """Translate a TRACE_FunctionEntry() trace to an event."""
+        address, name = self.lookup_func(value)
+        self.emit(TraceEvent(EVENT_ENTER, self.call_stack.enter(address), address, name))
 
     def trace_func_exit(self, value):
-        """Translate a TRACE_FunctionExit() trace to human readable output."""
-        # Decrement indent before Exit statement
-        # This is like a closing brace
-        self.dec_indent()
-        self.print_indent()
-        print("Exit %s" % self.get_func_name(value))
+        """Translate a TRACE_FunctionExit() trace to an event."""
+        address, name = self.lookup_func(value)
+        self.emit(TraceEvent(EVENT_EXIT, self.call_stack.exit(address), address, name))
 
     def trace_file_and_line(self, value):
-        """Translate a TRACE_Line() trace to human readable output."""
+        """Translate a TRACE_Line() trace to an event."""
         module_num = (value >> 16) & 0xFFF
         line_num = (value >> 0) & 0xFFFF
-        self.print_indent()
-        print("Module: %u, Line: %u" % (module_num, line_num))
+        self.emit(TraceEvent(EVENT_LINE, self.call_stack.depth(), name=self.module_names.get(module_num),
+                             value=line_num, module=module_num))
 
     def trace_variable(self, addr_value, var_value):
-        """Translate a TRACE_VariableValue() trace to human readable output."""
-        self.print_indent()
-        print("%s = %d" % (self.get_var_name(addr_value), var_value))
+        """Translate a TRACE_VariableValue() trace to an event."""
+        var_addr = (addr_value & 0xFFFFFFE) + self.RAM_BASE
+        name, offset = self.variable_index.lookup(var_addr)
+        if name is not None:
+            name = format_symbol(name, offset)
+        self.emit(TraceEvent(EVENT_VARIABLE, self.call_stack.depth(), var_addr, name, var_value))
 
     def trace_sfr(self, addr_value, reg_value):
-        """Translate a TRACE_SFRValue() trace to human readable output."""
-        self.print_indent()
-        print("%s = 0x%08X" % (self.get_sfr_name(addr_value), reg_value))
+        """Translate a TRACE_SFRValue() trace to an event."""
+        sfr_addr = (addr_value & 0xFFFFFFE) + self.SFR_BASE
+        name, offset = self.register_index.lookup(sfr_addr)
+        if name is None:
+            name, offset = self.peripheral_index.lookup(sfr_addr)
+        if name is not None:
+            name = format_symbol(name, offset)
+        self.emit(TraceEvent(EVENT_SFR, self.call_stack.depth(), sfr_addr, name, reg_value))
+
+    def trace_extended(self, header, payload):
+        """Translate an extended record to events.
+
+        Args:
+          header: The record's first value. Bits 23:16 are the record type.
+          payload: List of the values that follow the header.
+        """
+        ext_type = (header >> 16) & 0xFF
+        if ext_type in self.extended_handlers:
+            self.extended_handlers[ext_type](header, payload)
+        else:
+            # Newer protocol versions may add types; the length in the header
+            # has already let us skip over the payload.
+            self.emit(TraceEvent(EVENT_UNKNOWN, self.call_stack.depth(), value=ext_type, payload=payload))
+
+    def trace_printf(self, header, payload):
+        """Translate a TRACE_Printf() record to an event with the formatted
+        message. Without the format string, the message shows the raw
+        arguments."""
+        address = header & 0xFFFF
+        format = self.format_strings.get(address)
+        if format is None:
+            message = "Printf @ 0x%04X (%s)" % (address, ', '.join('0x%08X' % arg for arg in payload))
+        else:
+            message = format_printf(format, payload)
+        self.emit(TraceEvent(EVENT_PRINTF, self.call_stack.depth(), value=address, name=message,
+                             payload=payload))
+
+    def trace_timestamp_sync(self, header, payload):
+        """Record the full timestamp from a timestamp sync record."""
+        self.timestamp = payload[0]
+
+    def trace_timestamp(self, header, payload):
+        """Translate a timestamped entry to events carrying its absolute
+        timestamp.
+
+        Entries before the first sync record have an unknown timestamp,
+        TraceEvent.UNKNOWN_TIMESTAMP.
+
+        Args:
+          header: The timestamp record header. Bits 15:0 hold the ticks
+                  elapsed since the previous timestamp.
+          payload: The values of the entry or record that was timestamped.
+        """
+        if self.timestamp is not None:
+            self.timestamp = (self.timestamp + (header & 0xFFFF)) & 0xFFFFFFFF
+            self.event_timestamp = self.timestamp
+        else:
+            self.event_timestamp = TraceEvent.UNKNOWN_TIMESTAMP
+        self.decode_next(ListTraceReader(payload))
+        self.event_timestamp = None
 
     def trace_buff_full_indication(self):
-        """Print a warning indicating the buffer was full"""
-        print("**** Trace buffer full - possible data loss ****")
+        """Emit a warning event indicating the buffer was full"""
+        # Deltas of lost entries are lost too; wait for the next sync.
+        self.timestamp = None
+        self.emit(TraceEvent(EVENT_BUFFER_FULL))
+        self.call_stack.lose()
 
-    def read_and_trace_next(self, trace_reader: TraceReaderInterface):
-        """Read the next value from the trace reader and translate it to human
-        readable output.
+    def trace_entries_lost(self, count):
+        """Emit a warning event indicating entries were lost on the way from
+        the target."""
+        self.timestamp = None
+        self.emit(TraceEvent(EVENT_ENTRIES_LOST, value=count))
+        self.call_stack.lose()
 
-        Output is written to stdout.
+    def decode_next(self, trace_reader: TraceReaderInterface):
+        """Read the next entry or record from the trace reader and queue the
+        events it translates to in pending_events.
 
         Args:
           trace_reader: A concrete implementation of TraceReaderInterface.
@@ -200,20 +907,26 @@ class ExecTraceParser:
           True if there are more values to read.
           False if the end of the buffer has been reached.
         """
-        value = trace_reader.read_next()
+        return self.decode_value(trace_reader.read_next(), trace_reader)
 
+    def decode_value(self, value, trace_reader: TraceReaderInterface):
+        """As decode_next(), for a value already read from the trace reader.
+        The rest of the record, if any, is read from the trace reader."""
         if value == TraceReaderInterface.END_OF_TRACE_BUFFER:
             return False
+        if value == TraceReaderInterface.ENTRIES_LOST:
+            self.trace_entries_lost(trace_reader.last_loss)
+            return True
 
         idcode = (value >> 28) & 0xF
-        if idcode == 1:
-            self.trace_version(value)
-        elif idcode == 2:
-            self.trace_reset(value)
-        elif idcode == 3:
+        if idcode == 3:
             self.trace_func_entry(value)
         elif idcode == 4:
             self.trace_func_exit(value)
+        elif idcode == 1:
+            self.trace_version(value)
+        elif idcode == 2:
+            self.trace_reset(value)
         elif idcode == 5:
             self.trace_file_and_line(value)
         elif idcode == 6:
@@ -222,12 +935,89 @@ class ExecTraceParser:
         elif idcode == 7:
             value2 = trace_reader.read_next()
             self.trace_sfr(value, value2)
+        elif idcode == 8:
+            length = (value >> 24) & 0xF
+            payload = []
+            for i in range(0, length):
+                value2 = trace_reader.read_next()
+                if value2 == TraceReaderInterface.END_OF_TRACE_BUFFER:
+                    return False
+                payload.append(value2)
+            self.trace_extended(value, payload)
         elif idcode == 15:
             self.trace_buff_full_indication()
 
         return True
 
-    def read_and_trace_all(self, trace_reader: TraceReaderInterface):
+    def events(self, trace_reader: TraceReaderInterface):
+        """Generator of the TraceEvent objects translated from the trace
+        reader's values, until end of buffer is reached.
+
+        For TraceReaderInterface implementations that do not signal end of
+        buffer (e.g. live trace scenarios), this never ends.
+
+        Function entry and exit make up most of a trace, so they are decoded
+        here directly rather than through trace_func_entry() and
+        trace_func_exit().
+
+        Args:
+          trace_reader: A concrete implementation of TraceReaderInterface.
+        """
+        pending_events = self.pending_events
+        read_next = trace_reader.read_next
+        func_names = self.func_names
+        lookup_func = self.lookup_func
+        flash_base = self.FLASH_BASE
+        call_stack = self.call_stack
+        frames = call_stack.frames
+        while True:
+            value = read_next()
+            idcode = value >> 28
+            if idcode == 3 or idcode == 4:
+                func_addr = (value & 0xFFFFFFE) + flash_base
+                name = func_names.get(func_addr, False)
+                if name is False:
+                    name = lookup_func(value)[1]
+                if idcode == 3:
+                    event = TraceEvent(EVENT_ENTER, len(frames), func_addr, name)
+                    frames.append(func_addr)
+                elif frames and frames[-1] == func_addr and not call_stack.uncertain:
+                    frames.pop()
+                    event = TraceEvent(EVENT_EXIT, len(frames), func_addr, name)
+                else:
+                    event = TraceEvent(EVENT_EXIT, call_stack.exit(func_addr), func_addr, name)
+                event.uncertain = call_stack.uncertain
+                yield event
+            elif not self.decode_value(value, trace_reader):
+                return
+            elif pending_events:
+                yield from pending_events
+                pending_events.clear()
+
+    def read_and_trace_next(self, trace_reader: TraceReaderInterface):
+        """Read the next value from the trace reader and translate it to human
+        readable output.
+
+        Output is written to stdout.
+
+        Args:
+          trace_reader: A concrete implementation of TraceReaderInterface.
+
+        Returns:
+          True if there are more values to read.
+          False if the end of the buffer has been reached.
+        """
+        from trace_sinks import TextSink
+
+        more = self.decode_next(trace_reader)
+        sink = TextSink(sys.stdout)
+        for event in self.pending_events:
+            sink.write(event)
+        self.pending_events.clear()
+        sink.flush()
+        return more
+
+    def read_and_trace_all(self, trace_reader: TraceReaderInterface, sink=None):
         """Read and trace values from the trace reader until end of buffer is
         reached.
 
@@ -237,6 +1027,14 @@ class ExecTraceParser:
 
         Args:
           trace_reader: A concrete implementation of TraceReaderInterface.
+          sink: Where events are written, such as a trace_sinks.TextSink.
+                Defaults to human readable text on stdout, written as each
+                event is decoded.
         """
-        while(self.read_and_trace_next(trace_reader)):
-            pass
+        if sink is None:
+            from trace_sinks import TextSink
+            sink = TextSink(sys.stdout, buffer_size=1)
+        try:
+            sink.write_all(self.events(trace_reader))
+        finally:
+            sink.flush()
@@ -0,0 +1,562 @@
+"""Read function and variable symbols, and source line info, from an ELF file.
+
+This is an alternative to parse_map_file.read_gnu_map_file(). The ELF symbol
+table also has static functions and variables and the exact size of every
+symbol, and it doesn't depend on -ffunction-sections, -fdata-sections or the
+layout of the linker's map file.
+
+Line info is read from the DWARF .debug_line section (DWARF versions 2 to 5),
+so the firmware must be built with -g. It is only decoded when asked for,
+since decoding symbols alone is all that's needed to trace.
+
+The format strings of TRACE_Printf() are read from the .trace_fmt section.
+
+Limitations (and areas for future work):
+  - Only executables and shared objects are supported; relocations are not
+    applied, so line info of object files is wrong.
+  - Compressed debug sections must use zlib (the default for
+    --compress-debug-sections).
+"""
+from parse_map_file import MapSymbol
+
+import argparse
+import bisect
+import os
+import struct
+import sys
+import zlib
+
+ELF_MAGIC = b'\x7fELF'
+ELFCLASS64 = 2
+ELFDATA2MSB = 2
+EM_ARM = 40
+
+"""Section holding the format strings of TRACE_Printf(). See
+TRACE_FORMAT_SECTION in execution_tracer_protocol.h."""
+FORMAT_SECTION = '.trace_fmt'
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_COMPRESSED = 0x800
+ELFCOMPRESS_ZLIB = 1
+SHN_UNDEF = 0
+SHN_XINDEX = 0xFFFF
+
+STT_OBJECT = 1
+STT_FUNC = 2
+
+class ElfSymbol(MapSymbol):
+    """Provide the name and size of a function or variable, and for functions
+    the source file and range of lines their code comes from.
+
+    file, first_line and last_line are None until set by
+    add_function_line_ranges().
+    """
+    def __init__(self, name, size=0):
+        super().__init__(name, size)
+        self.file = None
+        self.first_line = None
+        self.last_line = None
+
+class ElfFile:
+    """Sections of an ELF file, read with the file's word size and byte
+    order."""
+    def __init__(self, file_name):
+        with open(file_name, 'rb') as file:
+            self.data = file.read()
+        if self.data[0:4] != ELF_MAGIC:
+            raise ValueError(f"'{file_name}' is not an ELF file")
+        self.is_64 = self.data[4] == ELFCLASS64
+        self.endian = '>' if self.data[5] == ELFDATA2MSB else '<'
+
+        if self.is_64:
+            header = struct.unpack_from(self.endian + 'HHIQQQIHHHHHH', self.data, 16)
+            self.section_format = self.endian + 'IIQQQQIIQQ'
+        else:
+            header = struct.unpack_from(self.endian + 'HHIIIIIHHHHHH', self.data, 16)
+            self.section_format = self.endian + 'IIIIIIIIII'
+        self.machine = header[1]
+        section_offset = header[5]
+        section_entry_size = header[10]
+        num_sections = header[11]
+        section_names_index = header[12]
+
+        self.sections = []
+        if section_offset:
+            # Counts too large for the ELF header are kept in section 0
+            first = struct.unpack_from(self.section_format, self.data, section_offset)
+            if num_sections == 0:
+                num_sections = first[5]
+            if section_names_index == SHN_XINDEX:
+                section_names_index = first[6]
+        for i in range(num_sections):
+            self.sections.append(struct.unpack_from(self.section_format, self.data,
+                                                    section_offset + i * section_entry_size))
+
+        self.section_names = {}
+        if self.sections:
+            names = self.section_contents(self.sections[section_names_index])
+            for i, section in enumerate(self.sections):
+                self.section_names[self.c_string(names, section[0])] = i
+
+    @staticmethod
+    def c_string(data, offset):
+        end = data.find(b'\0', offset)
+        return data[offset:end].decode('utf-8', errors='replace')
+
+    def section_contents(self, section):
+        """Return the bytes of a section, decompressed if need be."""
+        flags, offset, size = section[2], section[4], section[5]
+        contents = self.data[offset:offset + size]
+        if flags & SHF_COMPRESSED:
+            if self.is_64:
+                compression, _, _, _ = struct.unpack_from(self.endian + 'IIQQ', contents)
+                header_size = 24
+            else:
+                compression, _, _ = struct.unpack_from(self.endian + 'III', contents)
+                header_size = 12
+            if compression != ELFCOMPRESS_ZLIB:
+                raise ValueError("Unsupported debug section compression %u" % compression)
+            contents = zlib.decompress(contents[header_size:])
+        return contents
+
+    def named_section(self, name):
+        """Return the bytes of the named section, or None if there is none."""
+        if name not in self.section_names:
+            return None
+        return self.section_contents(self.sections[self.section_names[name]])
+
+def read_elf_symbols(elf: ElfFile):
+    """Return the tuple (functions, variables) for an ElfFile. See
+    read_elf_file()."""
+    functions = {}
+    variables = {}
+    if elf.is_64:
+        symbol_format = elf.endian + 'IBBHQQ'
+    else:
+        symbol_format = elf.endian + 'IIIBBH'
+    # Thumb functions have bit 0 of their address set
+    address_mask = ~1 if elf.machine == EM_ARM else ~0
+
+    for section in elf.sections:
+        if section[1] != SHT_SYMTAB:
+            continue
+        symbols = elf.section_contents(section)
+        names = elf.section_contents(elf.sections[section[6]])
+        # Entries beyond the table's whole entries are ignored
+        symbols = symbols[:len(symbols) - len(symbols) % struct.calcsize(symbol_format)]
+        for entry in struct.iter_unpack(symbol_format, symbols):
+            if elf.is_64:
+                name_offset, info, other, section_index, address, size = entry
+            else:
+                name_offset, address, size, info, other, section_index = entry
+            symbol_type = info & 0xF
+            if section_index == SHN_UNDEF or name_offset == 0:
+                continue
+            if symbol_type == STT_FUNC:
+                functions[address & address_mask] = ElfSymbol(elf.c_string(names, name_offset), size)
+            elif symbol_type == STT_OBJECT:
+                variables[address] = ElfSymbol(elf.c_string(names, name_offset), size)
+    return (functions, variables)
+
+def read_elf_file(file_name):
+    """Read in an ELF file and return dictionaries that map memory addresses
+    to functions and variables.
+
+    Unlike read_gnu_map_file(), static functions and variables are included,
+    and every symbol has its exact size.
+
+    Args:
+      file_name - Absolute or relative path to the ELF file for the program
+                  being traced.
+
+    Returns:
+      The tuple (functions, variables)
+      functions - A dictionary that maps MCU memory addresses to ElfSymbol
+                  objects for functions.
+      variables - A dictionary that maps MCU memory addresses to ElfSymbol
+                  objects for variables.
+    """
+    if not os.path.isfile(file_name):
+        print(f"File '{file_name}' not found", file=sys.stderr)
+        return (None, None)
+    return read_elf_symbols(ElfFile(file_name))
+
+def read_elf_format_strings(file_name):
+    """Read the format strings of TRACE_Printf() from an ELF file.
+
+    Args:
+      file_name - Absolute or relative path to the ELF file for the program
+                  being traced.
+
+    Returns:
+      A dictionary that maps the address of each format string, as traced,
+      to the string. It is empty if the program doesn't use TRACE_Printf().
+    """
+    elf = ElfFile(file_name)
+    if FORMAT_SECTION not in elf.section_names:
+        return {}
+    section = elf.sections[elf.section_names[FORMAT_SECTION]]
+    address, size = section[3], section[5]
+    if section[1] == SHT_NOBITS:
+        print(f"WARNING: {FORMAT_SECTION} has no contents; Link it with (INFO), not (NOLOAD)", file=sys.stderr)
+        return {}
+    # Only the low 16 bits of the address are traced; others would alias
+    if address != 0 or size > 0x10000:
+        print(f"ERROR: {FORMAT_SECTION} must be linked at address 0 and be at most 64 KB; "
+              f"It is at 0x{address:X} with size 0x{size:X}", file=sys.stderr)
+        return {}
+    contents = elf.section_contents(section)
+    format_strings = {}
+    offset = 0
+    while offset < len(contents):
+        end = contents.find(b'\0', offset)
+        if end < 0:
+            end = len(contents)
+        # Strings may be padded for alignment
+        if end > offset:
+            format_strings[offset] = contents[offset:end].decode('utf-8', errors='replace')
+        offset = end + 1
+    return format_strings
+
+class LineTable:
+    """Map addresses to the source file and line they were compiled from."""
+    def __init__(self, rows):
+        """Build the table.
+
+        Args:
+          rows: Iterable of (address, file, line) tuples. A file of None marks
+                the end of a sequence of rows.
+        """
+        # A sequence may start where another ends; the end goes first
+        rows = sorted(rows, key=lambda row: (row[0], row[1] is not None))
+        self.addresses = [row[0] for row in rows]
+        self.rows = rows
+
+    def lookup(self, address):
+        """Return the tuple (file, line) for an address, or (None, 0) if
+        there is no line info for it."""
+        i = bisect.bisect_right(self.addresses, address) - 1
+        if i >= 0 and self.rows[i][1] is not None:
+            return (self.rows[i][1], self.rows[i][2])
+        return (None, 0)
+
+    def rows_between(self, start, end):
+        """Return the rows for addresses from start up to (not including)
+        end."""
+        return self.rows[bisect.bisect_left(self.addresses, start):
+                         bisect.bisect_left(self.addresses, end)]
+
+def read_uleb128(data, offset):
+    result = 0
+    shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        result |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return (result, offset)
+
+def read_sleb128(data, offset):
+    result, end = read_uleb128(data, offset)
+    if data[end - 1] & 0x40:
+        result -= 1 << (7 * (end - offset))
+    return (result, end)
+
+# DWARF 5 forms that can appear in .debug_line headers
+DW_FORM_block = 0x09
+DW_FORM_block1 = 0x0a
+DW_FORM_data1 = 0x0b
+DW_FORM_data2 = 0x05
+DW_FORM_data4 = 0x06
+DW_FORM_data8 = 0x07
+DW_FORM_data16 = 0x1e
+DW_FORM_string = 0x08
+DW_FORM_strp = 0x0e
+DW_FORM_udata = 0x0f
+DW_FORM_line_strp = 0x1f
+DW_LNCT_path = 1
+DW_LNCT_directory_index = 2
+
+class LineProgramDecoder:
+    """Decode the line number programs of a .debug_line section.
+
+    See section 6.2 of the DWARF 5 standard. Only what is needed for
+    address-to-line lookups is kept: the address, file and line of each row.
+    """
+    def __init__(self, elf: ElfFile):
+        self.elf = elf
+        self.endian = elf.endian
+        self.debug_line = elf.named_section('.debug_line') or b''
+        self.debug_str = elf.named_section('.debug_str') or b''
+        self.debug_line_str = elf.named_section('.debug_line_str') or b''
+        self.rows = []
+
+    def unpack(self, format, offset):
+        return struct.unpack_from(self.endian + format, self.debug_line, offset)[0]
+
+    def read_form(self, form, offset, offset_size):
+        """Return the tuple (value, next offset) for an attribute."""
+        data = self.debug_line
+        if form == DW_FORM_string:
+            end = data.find(b'\0', offset)
+            return (data[offset:end].decode('utf-8', errors='replace'), end + 1)
+        if form in (DW_FORM_line_strp, DW_FORM_strp):
+            string_offset = self.unpack('Q' if offset_size == 8 else 'I', offset)
+            strings = self.debug_line_str if form == DW_FORM_line_strp else self.debug_str
+            return (ElfFile.c_string(strings, string_offset), offset + offset_size)
+        if form == DW_FORM_udata:
+            return read_uleb128(data, offset)
+        sizes = {DW_FORM_data1: 1, DW_FORM_data2: 2, DW_FORM_data4: 4, DW_FORM_data8: 8}
+        if form in sizes:
+            size = sizes[form]
+            return (int.from_bytes(data[offset:offset + size], 'big' if self.endian == '>' else 'little'),
+                    offset + size)
+        if form == DW_FORM_data16:
+            return (None, offset + 16)
+        if form == DW_FORM_block:
+            length, offset = read_uleb128(data, offset)
+            return (None, offset + length)
+        if form == DW_FORM_block1:
+            return (None, offset + 1 + data[offset])
+        raise ValueError("Unsupported form 0x%X in .debug_line" % form)
+
+    def read_entries(self, offset, offset_size):
+        """Read a DWARF 5 directory or file name table.
+
+        Returns:
+          The tuple (entries, next offset), where each entry is a dictionary
+          that maps DW_LNCT_ content types to values.
+        """
+        data = self.debug_line
+        format_count = data[offset]
+        offset += 1
+        entry_format = []
+        for i in range(format_count):
+            content_type, offset = read_uleb128(data, offset)
+            form, offset = read_uleb128(data, offset)
+            entry_format.append((content_type, form))
+        count, offset = read_uleb128(data, offset)
+        entries = []
+        for i in range(count):
+            entry = {}
+            for content_type, form in entry_format:
+                entry[content_type], offset = self.read_form(form, offset, offset_size)
+            entries.append(entry)
+        return (entries, offset)
+
+    def decode_unit(self, offset):
+        """Decode one line number program and return the offset of the next."""
+        data = self.debug_line
+        unit_length = self.unpack('I', offset)
+        offset += 4
+        offset_size = 4
+        if unit_length == 0xFFFFFFFF:
+            unit_length = self.unpack('Q', offset)
+            offset += 8
+            offset_size = 8
+        unit_end = offset + unit_length
+        version = self.unpack('H', offset)
+        offset += 2
+        address_size = 8 if self.elf.is_64 else 4
+        if version >= 5:
+            address_size = data[offset]
+            offset += 2
+        header_length = self.unpack('Q' if offset_size == 8 else 'I', offset)
+        offset += offset_size
+        program_start = offset + header_length
+        min_instruction_length = data[offset]
+        offset += 1
+        if version >= 4:
+            # maximum_operations_per_instruction only matters for VLIW
+            offset += 1
+        default_is_stmt = data[offset]
+        line_base = struct.unpack_from('b', data, offset + 1)[0]
+        line_range = data[offset + 2]
+        opcode_base = data[offset + 3]
+        offset += 4
+        standard_opcode_lengths = data[offset:offset + opcode_base - 1]
+        offset += opcode_base - 1
+
+        if version >= 5:
+            directory_entries, offset = self.read_entries(offset, offset_size)
+            directories = [entry.get(DW_LNCT_path, '') for entry in directory_entries]
+            file_entries, offset = self.read_entries(offset, offset_size)
+            files = [self.file_path(directories, entry.get(DW_LNCT_path, ''),
+                                    entry.get(DW_LNCT_directory_index, 0))
+                     for entry in file_entries]
+        else:
+            # Directory 0 and file 0 are implied; file numbers start from 1
+            directories = ['']
+            while data[offset] != 0:
+                end = data.find(b'\0', offset)
+                directories.append(data[offset:end].decode('utf-8', errors='replace'))
+                offset = end + 1
+            offset += 1
+            files = [None]
+            while data[offset] != 0:
+                end = data.find(b'\0', offset)
+                name = data[offset:end].decode('utf-8', errors='replace')
+                directory_index, offset = read_uleb128(data, end + 1)
+                _, offset = read_uleb128(data, offset)
+                _, offset = read_uleb128(data, offset)
+                files.append(self.file_path(directories, name, directory_index))
+        self.run_program(program_start, unit_end, address_size, min_instruction_length,
+                         line_base, line_range, opcode_base, standard_opcode_lengths, files)
+        return unit_end
+
+    @staticmethod
+    def file_path(directories, name, directory_index):
+        if os.path.isabs(name) or directory_index >= len(directories):
+            return name
+        return os.path.join(directories[directory_index], name)
+
+    def run_program(self, offset, end, address_size, min_instruction_length,
+                    line_base, line_range, opcode_base, standard_opcode_lengths, files):
+        """Run the line number state machine and add its rows to self.rows."""
+        data = self.debug_line
+        rows = self.rows
+        address_format = 'Q' if address_size == 8 else 'I'
+        const_add_pc = ((255 - opcode_base) // line_range) * min_instruction_length
+
+        def file_name(file_index):
+            return files[file_index] if file_index < len(files) else None
+
+        address = 0
+        file_index = 1
+        line = 1
+        while offset < end:
+            opcode = data[offset]
+            offset += 1
+            if opcode >= opcode_base:
+                # Special opcode: advance address and line, then add a row
+                adjusted = opcode - opcode_base
+                address += (adjusted // line_range) * min_instruction_length
+                line += line_base + adjusted % line_range
+                rows.append((address, file_name(file_index), line))
+            elif opcode == 0:
+                length, offset = read_uleb128(data, offset)
+                sub_opcode = data[offset]
+                if sub_opcode == 1:
+                    # DW_LNE_end_sequence
+                    rows.append((address, None, 0))
+                    address = 0
+                    file_index = 1
+                    line = 1
+                elif sub_opcode == 2:
+                    # DW_LNE_set_address
+                    address = struct.unpack_from(self.endian + address_format, data, offset + 1)[0]
+                offset += length
+            elif opcode == 1:
+                # DW_LNS_copy
+                rows.append((address, file_name(file_index), line))
+            elif opcode == 2:
+                # DW_LNS_advance_pc
+                advance, offset = read_uleb128(data, offset)
+                address += advance * min_instruction_length
+            elif opcode == 3:
+                # DW_LNS_advance_line
+                advance, offset = read_sleb128(data, offset)
+                line += advance
+            elif opcode == 4:
+                # DW_LNS_set_file
+                file_index, offset = read_uleb128(data, offset)
+            elif opcode == 8:
+                # DW_LNS_const_add_pc
+                address += const_add_pc
+            elif opcode == 9:
+                # DW_LNS_fixed_advance_pc
+                address += self.unpack('H', offset)
+                offset += 2
+            else:
+                # Opcodes that don't affect address, file or line. Their
+                # argument counts are given in the header, so even opcodes
+                # from newer versions can be skipped.
+                for i in range(standard_opcode_lengths[opcode - 1]):
+                    _, offset = read_uleb128(data, offset)
+
+    def decode(self):
+        """Decode every line number program in the section."""
+        offset = 0
+        while offset < len(self.debug_line):
+            offset = self.decode_unit(offset)
+        return self.rows
+
+def read_elf_line_table(file_name):
+    """Read the DWARF line info of an ELF file.
+
+    Args:
+      file_name - Absolute or relative path to the ELF file. It must have
+                  been built with debug info (-g).
+
+    Returns:
+      A LineTable object, which is empty if the file has no line info.
+    """
+    elf = ElfFile(file_name)
+    return LineTable(LineProgramDecoder(elf).decode())
+
+def add_function_line_ranges(functions, line_table: LineTable):
+    """Set the file, first_line and last_line of every function that has line
+    info.
+
+    Args:
+      functions: Dictionary that maps addresses to ElfSymbol objects, as
+                 returned by read_elf_file().
+      line_table: A LineTable object from read_elf_line_table().
+    """
+    for address, function in functions.items():
+        lines = [row for row in line_table.rows_between(address, address + max(function.size, 1))
+                 if row[1] is not None and row[2] > 0]
+        if lines:
+            function.file = lines[0][1]
+            function.first_line = min(row[2] for row in lines)
+            function.last_line = max(row[2] for row in lines)
+
+def main():
+    """Test retrieval of functions and variables dictionaries from an ELF
+    file.
+
+    This module is not meant to be used directly when analyzing execution trace
+    logs. Direct use is for dumping the functions and variables dictionaries,
+    with function source ranges, directly to stdout.
+    """
+    parser = argparse.ArgumentParser(description='ELF file parser')
+    parser.add_argument('--file', '-f', help='ELF file', type=str, required=True)
+    parser.add_argument('--lines', '-l', help='Show source lines of functions', action='store_true')
+    parser.add_argument('--formats', help='Show TRACE_Printf() format strings', action='store_true')
+    args = parser.parse_args()
+
+    functions, variables = read_elf_file(args.file)
+    if functions and args.lines:
+        add_function_line_ranges(functions, read_elf_line_table(args.file))
+    if functions:
+        print("Functions:")
+        for key in sorted(functions.keys()):
+            function = functions[key]
+            if function.file:
+                print("  0x%08X: %s (%u bytes) %s:%u-%u" % (key, function.name, function.size,
+                      function.file, function.first_line, function.last_line))
+            else:
+                print("  0x%08X: %s (%u bytes)" % (key, function.name, function.size))
+    if variables:
+        print("Variables")
+        for key in sorted(variables.keys()):
+            print("  0x%08X: %s (%u bytes)" % (key, variables[key].name, variables[key].size))
+    if args.formats:
+        print("Format strings:")
+        for address, format in sorted(read_elf_format_strings(args.file).items()):
+            print("  0x%04X: %r" % (address, format))
+
+class InputError(RuntimeError):
+    """Boilerplate code for using this file directly from the command line."""
+    def __init__(self, e):
+        super(InputError, self).__init__(e)
+
+if __name__ == '__main__':
+    """Boilerplate code for using this file directly from the command line."""
+    try:
+        main()
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
@@ -18,9 +18,42 @@ linker_section_ids = {
     ".bss": LinkerSection.BSS
 }
 
+class MapSymbol:
+    """Provide the name and size in bytes of a function or variable.
+
+    A size of 0 means the size is unknown, such as for symbols assigned in
+    the linker script.
+    """
+    def __init__(self, name, size=0):
+        self.name = name
+        self.size = size
+
+class InputSection:
+    """Collect the symbols of one input section (e.g. .text.main) so that they
+    can be sized once the section is complete."""
+    def __init__(self, address, size, symbols):
+        self.address = address
+        self.size = size
+        self.symbols = symbols
+        # (address, MapSymbol) pairs in the order they appear in the map file
+        self.entries = []
+
+    def add(self, address, name):
+        map_symbol = MapSymbol(name)
+        self.entries.append((address, map_symbol))
+        self.symbols[address] = map_symbol
+
+    def close(self):
+        """Size each symbol up to the next symbol or the end of the section."""
+        end = self.address + self.size
+        addresses = sorted(set(address for address, map_symbol in self.entries))
+        next_address = dict(zip(addresses, addresses[1:] + [end]))
+        for address, map_symbol in self.entries:
+            map_symbol.size = max(0, min(next_address[address], end) - address)
+
 def read_gnu_map_file(file_name):
     """Read in a GNU map file and return dictionaries that map memory addresses
-    to function names and variable names.
+    to functions and variables.
 
     The code should be compiled with -ffunction-sections and -fdata-sections so
     that all function names, including static functions, appear in the map
@@ -34,62 +67,93 @@ def read_gnu_map_file(file_name):
       file-name - Absolute or relative path to the GNU map file for the program
                   being traced.
 
+    Each symbol is sized from the input section that holds it: up to the next
+    symbol in that section, or to the end of the section. With
+    -ffunction-sections and -fdata-sections, that is the size of the function
+    or variable itself.
+
     Returns:
       The tuple (functions, variables)
-      functions - A dictionary that maps MCU memory addresses to function names.
-      variables - A dictionary that maps MCU memory addresses to variable names.
+      functions - A dictionary that maps MCU memory addresses to MapSymbol
+                  objects for functions.
+      variables - A dictionary that maps MCU memory addresses to MapSymbol
+                  objects for variables.
     """
     if not os.path.isfile(file_name):
-        print(f"File '{file_name}' not found")
+        print(f"File '{file_name}' not found", file=sys.stderr)
         return (None, None)
 
     memory_map_section_found = False
     linker_section = LinkerSection.UNKNOWN
     functions = {}
     variables = {}
+    input_section = None
     with open(file_name, "r") as file:
         for line in file:
             if not memory_map_section_found:
                 # There is nothing meaningful to parse before this section
                 if line.startswith("Linker script and memory map"):
-                    print("Found memory map")
+                    print("Found memory map", file=sys.stderr)
                     memory_map_section_found = True
             else:
                 # Each linker section starts with a non-indented lin in the map file
                 # This will be .text, .data, .isr_vector, etc.
                 if line.startswith('.'):
+                    if input_section:
+                        input_section.close()
+                        input_section = None
                     match_results = re.match('^(\.[a-zA-Z_0-9\.]+)\s+', line)
                     if match_results:
                         linker_section_name = match_results.groups()[0]
                         if linker_section_name in linker_section_ids.keys():
                             # We have entered a linker section we care about and will parse
-                            print(f"Found linker section {linker_section_name}")
+                            print(f"Found linker section {linker_section_name}", file=sys.stderr)
                             linker_section = linker_section_ids[linker_section_name]
                         else:
                             # We have entered something we don't care about
                             # E.g. .ARM.extab or .glue_7 or something
                             linker_section = LinkerSection.UNKNOWN
                     else:
-                        print("Fix linker section pattern matching regex")
+                        print("Fix linker section pattern matching regex", file=sys.stderr)
                         sys.exit(1)
-                else:
+                elif linker_section != LinkerSection.UNKNOWN:
                     # For this section to work properly, we need the -ffunction-sections
                     # and -fdata-sections compile flags enabled. Also, this will not be
                     # able to see static variables. Suggested workaround for tracing
                     # static variables is to not declare them static for debug builds
                     # where you want them traced.
                     if linker_section == LinkerSection.TEXT:
-                        match_results = re.match('^ {16}0x([0-9A-Fa-f]+) {16}(\S+)', line)
-                        if match_results:
-                            # Function name and address found
-                            address = int(match_results.groups()[0], 16)
-                            functions[address] = match_results.groups()[1]
-                    elif linker_section == LinkerSection.DATA or linker_section == LinkerSection.BSS:
-                        match_results = re.match('^ {16}0x([0-9A-Fa-f]+) {16}(\S+)', line)
-                        if match_results:
-                            # Variable name and address found
-                            address = int(match_results.groups()[0], 16)
-                            variables[address] = match_results.groups()[1]
+                        symbols = functions
+                    else:
+                        symbols = variables
+                    match_results = re.match('^ {16}0x([0-9A-Fa-f]+) {16}(\S+)(\s*=)?', line)
+                    if match_results:
+                        # Function or variable name and address found
+                        address = int(match_results.groups()[0], 16)
+                        name = match_results.groups()[1]
+                        if match_results.groups()[2] or not input_section:
+                            # Assigned in the linker script; Its size is unknown,
+                            # so don't let it hide a real symbol.
+                            symbols.setdefault(address, MapSymbol(name))
+                        else:
+                            input_section.add(address, name)
+                        continue
+
+                    # Input sections are listed as name, address, size and
+                    # object file. Long names are put on a line of their own.
+                    match_results = re.match('^ (\S+)?\s+0x([0-9A-Fa-f]+)\s+0x([0-9A-Fa-f]+)\s+\S', line)
+                    if match_results:
+                        if input_section:
+                            input_section.close()
+                        address = int(match_results.groups()[1], 16)
+                        size = int(match_results.groups()[2], 16)
+                        input_section = InputSection(address, size, symbols)
+                    elif re.match('^ \S+\s*$', line) and input_section:
+                        input_section.close()
+                        input_section = None
+
+    if input_section:
+        input_section.close()
 
     return (functions, variables)
 
@@ -114,11 +178,11 @@ def main():
     if functions:
         print("Functions:")
         for key in functions.keys():
-            print("  0x%08X: %s" % (key, functions[key]))
+            print("  0x%08X: %s (%u bytes)" % (key, functions[key].name, functions[key].size))
     if variables:
         print("Variables")
         for key in variables.keys():
-            print("  0x%08X: %s" % (key, variables[key]))
+            print("  0x%08X: %s (%u bytes)" % (key, variables[key].name, variables[key].size))
 
 class InputError(RuntimeError):
     """Boilerplate code for using this file directly from the command line."""
@@ -6,10 +6,35 @@ import sys
 from cmsis_svd.parser import SVDParser
 
 class PeripheralRegister:
-    """Provide the peripheral and register names for a specific address."""
+    """Provide the peripheral and register names for a specific address.
+
+    size is the register's width in bytes. peripheral_address and
+    peripheral_size give the span of the whole peripheral, so that addresses
+    between registers can still be named.
+    """
     def __init__(self):
         self.peripheral_name = ""
         self.register_name = ""
+        self.size = 4
+        self.peripheral_address = 0
+        self.peripheral_size = 0
+
+def get_peripheral_size(peripheral):
+    """Return the size in bytes of a peripheral's address block(s).
+
+    Args:
+      peripheral: is a cmsis_svd.model.SVDPeripheral object.
+
+    Returns:
+      The end of the last address block relative to the peripheral's base
+      address, or 0 if the SVD file doesn't say.
+    """
+    # Depending on its version, cmsis_svd has one block or a list of them
+    blocks = getattr(peripheral, 'address_blocks', None)
+    if not blocks:
+        block = getattr(peripheral, 'address_block', None)
+        blocks = [block] if block else []
+    return max([(block.offset or 0) + (block.size or 0) for block in blocks], default=0)
 
 def get_mcu_register_set_for_device(device):
     """Return a PeripheralRegisters dictionary for an SVDDevice object.
@@ -24,6 +49,7 @@ def get_mcu_register_set_for_device(device):
     for peripheral in device.peripherals:
         peripheral_name = peripheral.name
         peripheral_address = peripheral.base_address
+        peripheral_size = get_peripheral_size(peripheral)
         for register in peripheral.registers:
             register_name = register.name
             register_offset = register.address_offset
@@ -31,6 +57,10 @@ def get_mcu_register_set_for_device(device):
             registers[register_address] = PeripheralRegister()
             registers[register_address].peripheral_name = peripheral_name
             registers[register_address].register_name = register_name
+            # Register size is in bits; 32 is the SVD default
+            registers[register_address].size = (register.size or 32) // 8
+            registers[register_address].peripheral_address = peripheral_address
+            registers[register_address].peripheral_size = peripheral_size
     return registers
 
 def get_mcu_register_set_for_packaged_svd(make, model):
@@ -57,7 +87,7 @@ def get_mcu_register_set_for_packaged_svd(make, model):
         device = parser.get_device()
         return get_mcu_register_set_for_device(device)
     except FileNotFoundError as e:
-        print(f"{model} by {make}: Device not found")
+        print(f"{model} by {make}: Device not found", file=sys.stderr)
         return None
 
 def get_mcu_register_set_from_xml_file(file_name):
@@ -70,7 +100,7 @@ def get_mcu_register_set_from_xml_file(file_name):
       A dictionary that maps MCU memory addresses to PeripheralRegister objects.
     """
     if not os.path.isfile(file_name):
-        print(f"File '{file_name}' not found")
+        print(f"File '{file_name}' not found", file=sys.stderr)
         return None
 
     try:
@@ -100,14 +130,14 @@ def get_mcu_register_set(svd_file = None, make = None, model = None):
       A dictionary that maps MCU memory addresses to PeripheralRegister objects.
     """
     if not make and not model and not svd_file:
-        print("WARNING: No arguments for SVD selection.")
+        print("WARNING: No arguments for SVD selection.", file=sys.stderr)
         return None
 
     if (svd_file and (make or model)) or (make and not model) or (model and not make):
-        print("WARNING: Invalid arguments combination for SVD selection.")
-        print("Provide MAKE and MODEL to use a packaged svd file.")
-        print("Provide SVD_FILE to use an external svd file.")
-        print("Do not use both at the same time; They are mutually exclusive.")
+        print("WARNING: Invalid arguments combination for SVD selection.", file=sys.stderr)
+        print("Provide MAKE and MODEL to use a packaged svd file.", file=sys.stderr)
+        print("Provide SVD_FILE to use an external svd file.", file=sys.stderr)
+        print("Do not use both at the same time; They are mutually exclusive.", file=sys.stderr)
         return None
 
     if make and model:
@@ -0,0 +1,334 @@
+"""Cache the function, variable and register tables used to decode traces.
+
+Parsing a large GNU map or ELF file and building the SVD register set can take
+seconds. The first time a symbol and SVD file are used, the resolved tables are
+written to a cache file named after a hash of their contents. Later runs
+memory-map that file and look symbols up in place, so startup no longer
+depends on the size of the image.
+
+The cache file holds four tables: functions, variables, registers and
+peripherals. Each table is the content of an exec_trace_parser.SymbolIndex:
+arrays of start address, end address, size and name offset (native 32-bit
+unsigned integers), followed by the names themselves in UTF-8.
+
+Limitations (and areas for future work):
+  - Cache files are never removed. Delete the cache directory to reclaim the
+    space used by old images.
+"""
+from parse_map_file import read_gnu_map_file, MapSymbol
+from parse_elf_file import read_elf_file, read_elf_format_strings, ELF_MAGIC
+from parse_svd import get_mcu_register_set, PeripheralRegister
+from exec_trace_parser import SymbolIndex, make_symbol_index, make_register_indexes
+
+import argparse
+import array
+import bisect
+import collections.abc
+import hashlib
+import mmap
+import os
+import struct
+import sys
+import tempfile
+
+"""Bump whenever the cache file layout or the way tables are built changes."""
+CACHE_VERSION = 1
+CACHE_MAGIC = b'ETSC'
+HEADER_FORMAT = '<4sII32s'
+TABLE_FORMAT = '<II'
+NUM_TABLES = 4
+
+def default_cache_dir():
+    """Return the directory cache files are kept in unless told otherwise."""
+    cache_home = os.environ.get('XDG_CACHE_HOME') or os.path.join(os.path.expanduser('~'), '.cache')
+    return os.path.join(cache_home, 'execution_tracer')
+
+def read_symbol_file(file_name):
+    """Return the tuple (functions, variables) from an ELF file or a GNU map
+    file, whichever file_name is."""
+    with open(file_name, 'rb') as file:
+        is_elf = file.read(len(ELF_MAGIC)) == ELF_MAGIC
+    if is_elf:
+        return read_elf_file(file_name)
+    return read_gnu_map_file(file_name)
+
+def load_format_strings(symbol_file):
+    """Return the TRACE_Printf() format strings of an ELF file, as for
+    parse_elf_file.read_elf_format_strings(). GNU map files don't have them,
+    so the dictionary is empty for those. Format strings are not cached."""
+    if not os.path.isfile(symbol_file):
+        return {}
+    with open(symbol_file, 'rb') as file:
+        if file.read(len(ELF_MAGIC)) != ELF_MAGIC:
+            return {}
+    return read_elf_format_strings(symbol_file)
+
+def load_module_names(manifest_file):
+    """Return a dictionary that maps TRACE_Line() module numbers to file names,
+    from the manifest written by exec_trace_module_ids() in CMake. Each line of
+    the manifest is a module number and a path; Lines starting with '#' are
+    comments."""
+    module_names = {}
+    with open(manifest_file) as file:
+        for line in file:
+            if not line.strip() or line.startswith('#'):
+                continue
+            module_num, path = line.rstrip('\n').split(' ', 1)
+            module_names[int(module_num)] = path
+    return module_names
+
+def cache_key(symbol_file, svd_file=None, make=None, model=None):
+    """Return a SHA-256 digest of everything the symbol tables are built from.
+
+    Args:
+      symbol_file: Path to the GNU map file or ELF file.
+      svd_file: Path to the SVD file, if one is used.
+      make, model: Selection of a packaged SVD file, if one is used.
+    """
+    digest = hashlib.sha256()
+    def add(tag, data):
+        digest.update(tag + struct.pack('<Q', len(data)) + data)
+
+    add(b'version', b'%d %s' % (CACHE_VERSION, sys.byteorder.encode()))
+    for tag, file_name in ((b'symbols', symbol_file), (b'svd', svd_file)):
+        if file_name:
+            with open(file_name, 'rb') as file:
+                add(tag, file.read())
+    if make or model:
+        # Packaged SVD files only change with the cmsis_svd package
+        import cmsis_svd
+        package_version = getattr(cmsis_svd, '__version__', '')
+        add(b'packaged_svd', ('%s %s %s' % (make, model, package_version)).encode())
+    return digest.digest()
+
+class MappedNames(collections.abc.Sequence):
+    """Names of one table, decoded from the cache file as they are used."""
+    def __init__(self, offsets, blob):
+        self.offsets = offsets
+        self.blob = blob
+
+    def __len__(self):
+        return len(self.offsets) - 1
+
+    def __getitem__(self, i):
+        return str(self.blob[self.offsets[i]:self.offsets[i + 1]], 'utf-8')
+
+class MappedTable:
+    """One table of the cache file."""
+    def __init__(self, starts, ends, sizes, names):
+        self.index = SymbolIndex.from_sorted(starts, ends, sizes, names)
+
+    def find(self, address):
+        """Return the position of the symbol that starts at address, or -1."""
+        starts = self.index.starts
+        i = bisect.bisect_left(starts, address)
+        if i < len(starts) and starts[i] == address:
+            return i
+        return -1
+
+class MappedSymbols(collections.abc.Mapping):
+    """Dictionary that maps MCU addresses to parse_map_file.MapSymbol objects,
+    backed by a table of the cache file."""
+    def __init__(self, table: MappedTable):
+        self.table = table
+
+    def __getitem__(self, address):
+        i = self.table.find(address)
+        if i < 0:
+            raise KeyError(address)
+        return MapSymbol(self.table.index.names[i], self.table.index.sizes[i])
+
+    def __iter__(self):
+        return iter(self.table.index.starts)
+
+    def __len__(self):
+        return len(self.table.index.starts)
+
+    def symbol_index(self):
+        """Used by ExecTraceParser in place of building its own index."""
+        return self.table.index
+
+class MappedRegisters(collections.abc.Mapping):
+    """Dictionary that maps MCU addresses to parse_svd.PeripheralRegister
+    objects, backed by the register and peripheral tables of the cache
+    file."""
+    def __init__(self, registers: MappedTable, peripherals: MappedTable):
+        self.registers = registers
+        self.peripherals = peripherals
+
+    def __getitem__(self, address):
+        i = self.registers.find(address)
+        if i < 0:
+            raise KeyError(address)
+        peripheral_register = PeripheralRegister()
+        name = self.registers.index.names[i]
+        peripheral_register.peripheral_name, peripheral_register.register_name = name.split('->', 1)
+        peripheral_register.size = self.registers.index.sizes[i]
+        peripheral_name, offset = self.peripherals.index.lookup(address)
+        if peripheral_name is not None:
+            j = self.peripherals.find(address - offset)
+            peripheral_register.peripheral_address = address - offset
+            peripheral_register.peripheral_size = self.peripherals.index.sizes[j]
+        return peripheral_register
+
+    def __iter__(self):
+        return iter(self.registers.index.starts)
+
+    def __len__(self):
+        return len(self.registers.index.starts)
+
+    def symbol_indexes(self):
+        """Used by ExecTraceParser in place of building its own indexes."""
+        return (self.registers.index, self.peripherals.index)
+
+def pack_table(index: SymbolIndex):
+    """Return the bytes of one table of the cache file."""
+    encoded_names = [name.encode('utf-8') for name in index.names]
+    offsets = array.array('I', [0])
+    for name in encoded_names:
+        offsets.append(offsets[-1] + len(name))
+    names = b''.join(encoded_names)
+    names += b'\0' * (-len(names) % 4)
+    return (struct.pack(TABLE_FORMAT, len(index.starts), len(names)) +
+            array.array('I', index.starts).tobytes() +
+            array.array('I', index.ends).tobytes() +
+            array.array('I', index.sizes).tobytes() +
+            offsets.tobytes() + names)
+
+def write_cache(file_name, key, functions, variables, registers):
+    """Write the symbol tables to a cache file.
+
+    The file is written under a temporary name and then renamed, so that a
+    concurrent or interrupted run never sees a partial cache file.
+    """
+    register_index, peripheral_index = make_register_indexes(registers)
+    data = [struct.pack(HEADER_FORMAT, CACHE_MAGIC, CACHE_VERSION, NUM_TABLES, key)]
+    for index in (make_symbol_index(functions), make_symbol_index(variables),
+                  register_index, peripheral_index):
+        data.append(pack_table(index))
+
+    cache_dir = os.path.dirname(file_name)
+    fd, temp_name = tempfile.mkstemp(dir=cache_dir, suffix='.tmp')
+    try:
+        with os.fdopen(fd, 'wb') as file:
+            file.write(b''.join(data))
+        os.replace(temp_name, file_name)
+    except BaseException:
+        os.unlink(temp_name)
+        raise
+
+def read_cache(file_name, key):
+    """Memory-map a cache file and return its tables.
+
+    Returns:
+      The tuple (functions, variables, registers), or None if the file is
+      missing, was built from other inputs, or is not a valid cache file.
+    """
+    try:
+        with open(file_name, 'rb') as file:
+            mapped = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+    except (OSError, ValueError):
+        return None
+
+    view = memoryview(mapped)
+    try:
+        magic, version, num_tables, file_key = struct.unpack_from(HEADER_FORMAT, view)
+        if magic != CACHE_MAGIC or version != CACHE_VERSION or num_tables != NUM_TABLES or file_key != key:
+            return None
+        offset = struct.calcsize(HEADER_FORMAT)
+        tables = []
+        for i in range(NUM_TABLES):
+            count, names_length = struct.unpack_from(TABLE_FORMAT, view, offset)
+            offset += struct.calcsize(TABLE_FORMAT)
+            arrays = []
+            for length in (count, count, count, count + 1):
+                arrays.append(view[offset:offset + 4 * length].cast('I'))
+                offset += 4 * length
+            if offset + names_length > len(view):
+                return None
+            names = MappedNames(arrays[3], view[offset:offset + names_length])
+            offset += names_length
+            tables.append(MappedTable(arrays[0], arrays[1], arrays[2], names))
+    except (struct.error, TypeError):
+        return None
+
+    return (MappedSymbols(tables[0]), MappedSymbols(tables[1]), MappedRegisters(tables[2], tables[3]))
+
+def load_symbol_tables(symbol_file, svd_file=None, make=None, model=None, cache_dir=None):
+    """Return the function, variable and register tables for a symbol and SVD
+    file, from the cache if possible.
+
+    On a cache miss, the symbol and SVD files are parsed as usual and the result
+    is added to the cache. A cache that can't be written is not an error; the
+    tables are still returned.
+
+    Args:
+      symbol_file: Path to the GNU map file or ELF file.
+      svd_file, make, model: SVD selection, as for
+                             parse_svd.get_mcu_register_set().
+      cache_dir: Directory for cache files, or None to not use the cache.
+
+    Returns:
+      The tuple (functions, variables, registers). These are used in the same
+      way as the dictionaries returned by read_gnu_map_file() (or
+      read_elf_file()) and
+      get_mcu_register_set().
+    """
+    if not os.path.isfile(symbol_file):
+        print(f"File '{symbol_file}' not found", file=sys.stderr)
+        return (None, None, get_mcu_register_set(svd_file, make, model))
+    if cache_dir is None or (svd_file and not os.path.isfile(svd_file)):
+        functions, variables = read_symbol_file(symbol_file)
+        return (functions, variables, get_mcu_register_set(svd_file, make, model))
+
+    key = cache_key(symbol_file, svd_file, make, model)
+    file_name = os.path.join(cache_dir, key.hex() + '.symcache')
+    tables = read_cache(file_name, key)
+    if tables:
+        print(f"Loaded symbols from {file_name}", file=sys.stderr)
+        return tables
+
+    functions, variables = read_symbol_file(symbol_file)
+    registers = get_mcu_register_set(svd_file, make, model)
+    try:
+        os.makedirs(cache_dir, exist_ok=True)
+        write_cache(file_name, key, functions, variables, registers)
+        print(f"Saved symbols to {file_name}", file=sys.stderr)
+    except OSError as e:
+        print(f"WARNING: Symbols not cached: {e}", file=sys.stderr)
+    return (functions, variables, registers)
+
+def main():
+    """Build (or check) the symbol cache for a symbol and SVD file.
+
+    This module is not meant to be used directly when analyzing execution trace
+    logs. Direct use is for filling the cache ahead of time, for example as
+    part of a firmware build, so that the first trace starts quickly too.
+    """
+    parser = argparse.ArgumentParser(description='Symbol table cache')
+    symbol_group = parser.add_mutually_exclusive_group(required=True)
+    symbol_group.add_argument('--map_file', '-m', help='GNU Map file', type=str)
+    symbol_group.add_argument('--elf_file', '-e', help='ELF file', type=str)
+    parser.add_argument('--svd_file', help='SVD file in XML foramt', type=str, required=False)
+    parser.add_argument('--make', help='Vendor (e.g. Atmel or STMicro)', type=str, required=False)
+    parser.add_argument('--model', help='Device name (e.g. ATSAMA5D33 or STM32L4x6)', type=str, required=False)
+    parser.add_argument('--cache_dir', help='Symbol cache directory', type=str, default=default_cache_dir())
+    args = parser.parse_args()
+
+    functions, variables, registers = load_symbol_tables(args.map_file or args.elf_file, args.svd_file,
+                                                         args.make, args.model, args.cache_dir)
+    print("%u functions, %u variables, %u registers" %
+          (len(functions or {}), len(variables or {}), len(registers or {})))
+
+class InputError(RuntimeError):
+    """Boilerplate code for using this file directly from the command line."""
+    def __init__(self, e):
+        super(InputError, self).__init__(e)
+
+if __name__ == '__main__':
+    """Boilerplate code for using this file directly from the command line."""
+    try:
+        main()
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
@@ -0,0 +1,457 @@
+"""Classify and filter the entries of an execution trace log file in bulk.
+
+ExecTraceParser decodes one entry at a time, which is what text output needs
+but is slow for passes over a long log file that only count or select
+entries. TraceArray instead loads the log file into numpy arrays, with one
+element per record: Record boundaries, ID codes and fields (28-bit data,
+module and line numbers, addresses, values and absolute timestamps) are all
+found with vector operations, without Python code per entry.
+
+Raw binary log files are memory-mapped rather than read, so that only the
+arrays derived from them take memory. Text log files are converted to an
+array of words first; This is fast for the "0xXXXXXXXX" lines written by
+DumpExecTraceLog() and for DUMP_FORMAT_BASE64_TEXT lines, and falls back to
+parsing each line otherwise.
+
+Usage:
+  entries = TraceArray.open('capture.bin', binary=True, flash_base=FLASH_BASE)
+  calls = entries.addresses(entries.idcodes == 3)
+  addresses, counts = numpy.unique(calls, return_counts=True)
+
+Run from the command line, this prints the number of entries of each kind,
+the most called functions and, with --module, the lines traced in a module.
+
+Requires numpy.
+
+Limitations (and areas for future work):
+  - Log files in the compact encoding or in framed format aren't supported;
+    Decode those with trace_from_file.py.
+  - Call depth isn't reconstructed, as it depends on every entry before.
+  - Binary log files are assumed to have been captured from a little-endian
+    target.
+"""
+from exec_trace_parser import (TraceEvent, EXT_TYPE_TIMESTAMP, EXT_TYPE_TIMESTAMP_SYNC, BASE64_LINE_START,
+                               base64_line_values)
+
+import argparse
+import binascii
+import sys
+import time
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+def require_numpy():
+    if numpy is None:
+        raise InputError("trace_array.py requires numpy (pip install numpy)")
+
+def top_bytes(words):
+    """Return bits 31:24 of every word: The ID code, and the payload length of
+    extended records."""
+    if words.dtype.str == '<u4' and words.flags.c_contiguous:
+        return numpy.ascontiguousarray(words.view(numpy.uint8)[3::4])
+    return (words >> 24).astype(numpy.uint8)
+
+def record_starts(top):
+    """Find the words that start a record, from their top_bytes().
+
+    Where a record starts depends on the lengths of all the records before
+    it, but only records longer than one word can cover the words after
+    them. Those are few, except with timestamps, and most of them can't be
+    covered by any longer record before them, so they certainly start a
+    record. Records are followed one at a time only from such a record up to
+    the next one, where one could be covered, and all of these walks are
+    taken at once, one record per step.
+
+    A record cut short by the end of the log file is left out.
+
+    Returns:
+      The tuple (is_start, long_starts): A mask of the words that start a
+      record, and the indexes of the records longer than one word.
+    """
+    # ID codes 6, 7 and 8 could start a longer record
+    index_type = numpy.int32 if len(top) < (1 << 31) - 16 else numpy.int64
+    candidates = numpy.flatnonzero((top - 0x60) < 0x30).astype(index_type)
+    headers = top[candidates]
+    # Words after the header, as for exec_trace_parser.record_length()
+    payload = numpy.where(headers >= 0x80, headers & 0xF, 1).astype(numpy.uint8)
+    del headers
+    if not payload.all():
+        candidates = candidates[payload != 0]
+        payload = payload[payload != 0]
+    ends = candidates + 1 + payload
+
+    # Candidates that no candidate before them would cover
+    covered_to = numpy.empty(len(candidates), dtype=ends.dtype)
+    if len(candidates):
+        covered_to[0] = 0
+        numpy.maximum.accumulate(ends[:-1], out=covered_to[1:])
+    is_long = covered_to <= candidates
+    del covered_to
+    # Walk from the certain starts just before uncertain ones. The next record
+    # longer than one word is the first candidate at or after the end of the
+    # one before.
+    walk = numpy.flatnonzero(~is_long) - 1
+    walk = walk[is_long[walk]]
+    while len(walk):
+        walk = numpy.searchsorted(candidates, ends[walk])
+        walk = walk[walk < len(candidates)]
+        walk = walk[~is_long[walk]]
+        is_long[walk] = True
+
+    long_starts = candidates[is_long]
+    payload = payload[is_long]
+    is_start = numpy.ones(len(top), dtype=bool)
+    if len(long_starts) and long_starts[-1] + payload[-1] >= len(top):
+        is_start[long_starts[-1]:] = False
+        long_starts = long_starts[:-1]
+        payload = payload[:-1]
+    covering = long_starts
+    for offset in range(1, 16):
+        is_start[covering + offset] = False
+        more = payload > offset
+        if not more.all():
+            covering = covering[more]
+            payload = payload[more]
+        if not len(covering):
+            break
+    return is_start, long_starts
+
+def words_from_text(data):
+    """Return the values in the contents of a text log file (see
+    trace_from_file.TextFileTraceReader) as an array of words."""
+    for width in (11, 12):
+        if len(data) % width or data[width - 1:width] != b'\n':
+            continue
+        # Every line could be "0xXXXXXXXX\n" (or end in "\r\n"): Convert the
+        # hex digits all at once
+        chars = numpy.frombuffer(data, dtype=numpy.uint8).reshape(-1, width)
+        if width == 12 and not numpy.all(chars[:, 10] == ord('\r')):
+            break
+        if not (numpy.all(chars[:, 0] == ord('0')) and numpy.all((chars[:, 1] | 0x20) == ord('x')) and
+                numpy.all(chars[:, -1] == ord('\n'))):
+            break
+        digits = chars[:, 2:10] - numpy.uint8(ord('0'))
+        letters = (chars[:, 2:10] | 0x20) - numpy.uint8(ord('a') - 10)
+        digits = numpy.where(digits < 10, digits, letters)
+        if not numpy.all(digits < 16):
+            break
+        words = numpy.zeros(len(chars), dtype=numpy.uint32)
+        for column in range(8):
+            words <<= 4
+            words |= digits[:, column]
+        return words
+    lines = data.split()
+    start = BASE64_LINE_START.encode('ascii')
+    if lines and all(line[:1] == start for line in lines):
+        # Base64 lines: Decode each with binascii and view the bytes as words
+        chunks = [binascii.a2b_base64(line[1:]) for line in lines]
+        if not any(len(chunk) % 4 for chunk in chunks):
+            return numpy.frombuffer(b''.join(chunks), dtype='<u4')
+    values = []
+    for line in lines:
+        if line[:1] == start:
+            values.extend(base64_line_values(line))
+        else:
+            values.append(int(line, 0))
+    return numpy.array(values, dtype=numpy.uint32)
+
+def selected(array, mask):
+    """Return the elements of a per record array selected by mask, or all of
+    them if mask is None."""
+    return array if mask is None else array[mask]
+
+class TraceArray:
+    """The records of a log file as numpy arrays, in log file order.
+
+    Timestamped entries count as the entry itself: Their ID code and fields
+    are those of the entry inside the timestamp record, and timestamps()
+    gives their absolute timestamp. Timestamp sync records are kept as
+    records with ID code 8.
+
+    Attributes:
+      words: All words of the log file.
+      is_entry: Mask of the words that are the entry header of a record;
+                The word after the timestamp record header for timestamped
+                entries.
+      idcodes: ID code of each record, the top four bits of its entry header.
+      timestamped: True for each record that is a timestamped entry.
+    """
+    """Timestamp of records that aren't timestamped."""
+    NO_TIMESTAMP = -2
+
+    def __init__(self, words, flash_base=0, ram_base=0, sfr_base=0):
+        """Finds the records in an array of words.
+
+        Args:
+          words: numpy array of 32-bit words, such as returned by
+                 numpy.memmap().
+          flash_base, ram_base, sfr_base: MCU base addresses, as for
+                                          ExecTraceParser.
+        """
+        require_numpy()
+        # Plain arrays index faster than memmap objects
+        self.words = numpy.asarray(words)
+        words = self.words
+        self.flash_base = flash_base
+        self.ram_base = ram_base
+        self.sfr_base = sfr_base
+        top = top_bytes(words)
+        is_start, long_starts = record_starts(top)
+        # Timestamp records with a payload hold the entry that was
+        # timestamped. Words are coded 1 for the entry header of a record,
+        # 2 if the entry was timestamped, and 0 otherwise.
+        timestamp_starts = long_starts[(top[long_starts] >> 4 == 8) &
+                                       (((words[long_starts] >> 16) & 0xFF) == EXT_TYPE_TIMESTAMP)]
+        entry_codes = is_start.view(numpy.int8)
+        entry_codes[timestamp_starts] = 0
+        entry_codes[timestamp_starts + 1] = 2
+        self.is_entry = entry_codes != 0
+        self.idcodes = top[self.is_entry] >> 4
+        if len(timestamp_starts):
+            self.timestamped = entry_codes[self.is_entry] == 2
+        else:
+            self.timestamped = numpy.zeros(len(self.idcodes), dtype=bool)
+        del top, is_start, entry_codes
+        self.header_words = None
+        self.entry_positions = None
+
+    @classmethod
+    def open(cls, file_name, binary=False, **bases):
+        """Return the TraceArray of a log file.
+
+        Args:
+          file_name: Path to the log file.
+          binary: The log file is in raw binary format rather than text.
+          bases: flash_base, ram_base and sfr_base, as for the constructor.
+        """
+        require_numpy()
+        if binary:
+            with open(file_name, 'rb') as log_file:
+                size = log_file.seek(0, 2)
+            if size < 4:
+                words = numpy.zeros(0, dtype='<u4')
+            else:
+                # A trailing partial word is left out, as by
+                # BinaryFileTraceReader
+                words = numpy.memmap(file_name, dtype='<u4', mode='r', shape=(size // 4,))
+        else:
+            with open(file_name, 'rb') as log_file:
+                words = words_from_text(log_file.read())
+        return cls(words, **bases)
+
+    def __len__(self):
+        return len(self.idcodes)
+
+    def headers(self):
+        """Return the entry header of each record; The word after the
+        timestamp record header for timestamped entries."""
+        if self.header_words is None:
+            self.header_words = self.words[self.is_entry]
+        return self.header_words
+
+    def positions(self):
+        """Return the index in words of each record's entry header."""
+        if self.entry_positions is None:
+            self.entry_positions = numpy.flatnonzero(self.is_entry)
+        return self.entry_positions
+
+    def counts(self):
+        """Return the number of records with each ID code, indexed by ID
+        code."""
+        # bincount() converts every element to a full size integer; Counting
+        # pairs of ID codes at once halves that
+        idcodes = self.idcodes
+        pairs = numpy.bincount(idcodes[:len(idcodes) // 2 * 2].view(numpy.uint16), minlength=1 << 16)
+        pairs = pairs.reshape(256, 256)
+        counts = pairs.sum(axis=0) + pairs.sum(axis=1)
+        if len(idcodes) % 2:
+            counts[idcodes[-1]] += 1
+        return counts[:16]
+
+    def select(self, *idcodes):
+        """Return a mask of the records with any of the ID codes."""
+        mask = self.idcodes == idcodes[0]
+        for idcode in idcodes[1:]:
+            mask |= self.idcodes == idcode
+        return mask
+
+    def data(self, mask=None):
+        """Return the 28 bits below the ID code of each record's header.
+
+        This and the other fields take an optional mask, such as from
+        select(), to return the field of the selected records only. That is
+        faster than selecting from the field of all records.
+        """
+        return selected(self.headers(), mask) & 0x0FFFFFFF
+
+    def modules(self, mask=None):
+        """Return the module number of each record, as for EVENT_LINE. Only
+        meaningful for ID code 5."""
+        return ((selected(self.headers(), mask) >> 16) & 0xFFF).astype(numpy.uint16)
+
+    def lines(self, mask=None):
+        """Return the line number of each record, as for EVENT_LINE. Only
+        meaningful for ID code 5."""
+        return (selected(self.headers(), mask) & 0xFFFF).astype(numpy.uint16)
+
+    def addresses(self, mask=None):
+        """Return the MCU address of the function (ID codes 3 and 4),
+        variable (6) or register (7) of each record, and 0 for the others."""
+        idcodes = selected(self.idcodes, mask)
+        addresses = (selected(self.headers(), mask) & 0xFFFFFFE).astype(numpy.int64)
+        numpy.multiply(addresses, ((idcodes - 3) <= 1) | ((idcodes - 6) <= 1), out=addresses)
+        for idcode, base in ((3, self.flash_base), (4, self.flash_base), (6, self.ram_base), (7, self.sfr_base)):
+            if base:
+                numpy.add(addresses, base, out=addresses, where=(idcodes == idcode))
+        return addresses
+
+    def values(self, mask=None):
+        """Return the value of each variable (ID code 6) and register (7)
+        record, and 0 for the others."""
+        idcodes = selected(self.idcodes, mask)
+        has_value = ((idcodes - 6) <= 1)
+        values = numpy.zeros(len(idcodes), dtype=numpy.uint32)
+        values[has_value] = self.words[selected(self.positions(), mask)[has_value] + 1]
+        return values
+
+    def extended_types(self, mask=None):
+        """Return the type of each extended record (ID code 8)."""
+        return ((selected(self.headers(), mask) >> 16) & 0xFF).astype(numpy.uint8)
+
+    def timestamps(self, mask=None):
+        """Return the absolute timestamp of each record, as ExecTraceParser
+        would: TraceEvent.UNKNOWN_TIMESTAMP for timestamped entries before
+        the first sync record (or after a buffer full indication, until the
+        next one), and NO_TIMESTAMP for records that aren't timestamped."""
+        count = len(self)
+        positions = self.positions()
+        headers = self.headers()
+        timestamped = self.timestamped
+        deltas = numpy.zeros(count, dtype=numpy.int64)
+        deltas[timestamped] = self.words[positions[timestamped] - 1] & 0xFFFF
+        elapsed = numpy.cumsum(deltas)
+        del deltas
+        is_sync = ((self.idcodes == 8) & (((headers >> 16) & 0xFF) == EXT_TYPE_TIMESTAMP_SYNC) &
+                   (((headers >> 24) & 0xF) != 0) & ~timestamped)
+        is_full = self.idcodes == 15
+        # The last sync record or buffer full indication at or before each
+        # record; A timestamped buffer full indication only affects the
+        # records after it
+        last = numpy.maximum.accumulate(numpy.where(is_sync | is_full, numpy.arange(count), -1))
+        if count:
+            before = numpy.concatenate(([-1], last[:-1]))
+            last = numpy.where(is_full & timestamped, before, last)
+        known = last >= 0
+        known[known] = is_sync[last[known]]
+        known &= timestamped
+        since = last[known]
+        timestamps = numpy.full(count, self.NO_TIMESTAMP, dtype=numpy.int64)
+        timestamps[timestamped] = TraceEvent.UNKNOWN_TIMESTAMP
+        timestamps[known] = (self.words[positions[since] + 1].astype(numpy.int64) + elapsed[known] -
+                             elapsed[since]) & 0xFFFFFFFF
+        return selected(timestamps, mask)
+
+"""Names of the ID codes, for the summary."""
+IDCODE_NAMES = {
+    1: 'Tracer version',
+    2: 'Processor reset',
+    3: 'Function entry',
+    4: 'Function exit',
+    5: 'Line',
+    6: 'Variable',
+    7: 'Register',
+    8: 'Extended record',
+    15: 'Buffer full',
+}
+
+def print_summary(entries: TraceArray, function_index=None, top=10, module=None, file=sys.stdout):
+    """Print the number of records of each kind, the most called functions
+    and, if module is given, the number of times each of its lines was
+    traced.
+
+    Args:
+      entries: TraceArray of the log file.
+      function_index: exec_trace_parser.SymbolIndex of the functions, or None
+                      to print addresses only.
+      top: Number of functions to print.
+      module: Module number, or None.
+    """
+    from exec_trace_parser import format_symbol
+
+    counts = entries.counts()
+    print("%12s  %s" % ("records", "kind"), file=file)
+    for idcode in numpy.flatnonzero(counts):
+        print("%12u  %s" % (counts[idcode], IDCODE_NAMES.get(idcode, "ID code %u" % idcode)), file=file)
+
+    if top:
+        calls = entries.addresses(entries.idcodes == 3)
+        addresses, calls = numpy.unique(calls, return_counts=True)
+        order = numpy.argsort(-calls, kind='stable')[:top]
+        print("\n%12s  %s" % ("calls", "function"), file=file)
+        for address, count in zip(addresses[order].tolist(), calls[order].tolist()):
+            name = None
+            if function_index is not None:
+                name, offset = function_index.lookup(address)
+                if name is not None:
+                    name = format_symbol(name, offset)
+            print("%12u  %s" % (count, name or "Function @ 0x%08X" % address), file=file)
+
+    if module is not None:
+        is_line = entries.idcodes == 5
+        in_module = entries.modules(is_line) == module
+        lines, hits = numpy.unique(entries.lines(is_line)[in_module], return_counts=True)
+        print("\n%12s  %s" % ("hits", "line of module %u" % module), file=file)
+        for line, count in zip(lines.tolist(), hits.tolist()):
+            print("%12u  %u" % (count, line), file=file)
+
+def main():
+    """Summarize a log file saved from a back-end terminal on stdout.
+
+    See module comment for usage.
+    """
+    from trace_from_file import FLASH_BASE, RAM_BASE, SFR_BASE
+
+    parser = argparse.ArgumentParser(description='Execution trace log summary')
+    symbol_group = parser.add_mutually_exclusive_group()
+    symbol_group.add_argument('--map_file', '-m', help='GNU Map file', type=str)
+    symbol_group.add_argument('--elf_file', '-e', help='ELF file (instead of a map file)', type=str)
+    parser.add_argument('--file', '-f', help='Log file', type=str, required=True)
+    parser.add_argument('--binary', '-b', help='Log file is in raw binary format', action='store_true')
+    parser.add_argument('--top', '-n', help='Number of most called functions to print', type=int, default=10)
+    parser.add_argument('--module', help='Print the lines traced in this module', type=int, required=False)
+    parser.add_argument('--cache_dir', help='Symbol cache directory', type=str, required=False)
+    parser.add_argument('--no_cache', help='Always parse the map file', action='store_true')
+    args = parser.parse_args()
+
+    function_index = None
+    symbol_file = args.map_file or args.elf_file
+    if symbol_file:
+        from symbol_cache import load_symbol_tables, default_cache_dir
+        from exec_trace_parser import make_symbol_index
+        cache_dir = None if args.no_cache else (args.cache_dir or default_cache_dir())
+        functions = load_symbol_tables(symbol_file, cache_dir=cache_dir)[0]
+        if functions:
+            function_index = make_symbol_index(functions)
+
+    begin = time.perf_counter()
+    entries = TraceArray.open(args.file, args.binary, flash_base=FLASH_BASE, ram_base=RAM_BASE,
+                              sfr_base=SFR_BASE)
+    elapsed = time.perf_counter() - begin
+    print_summary(entries, function_index, args.top, args.module)
+    print("\n%u records in %.3f s" % (len(entries), elapsed), file=sys.stderr)
+
+class InputError(RuntimeError):
+    """Boilerplate code for using this file directly from the command line."""
+    def __init__(self, e):
+        super(InputError, self).__init__(e)
+
+if __name__ == '__main__':
+    """Boilerplate code for using this file directly from the command line."""
+    try:
+        main()
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
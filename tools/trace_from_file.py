@@ -1,31 +1,78 @@
 """Parse and display the contents of an execution trace log saved to a text
 file.
 
-You must provide the map file and SVD information needed for translating trace
-values on the command line. You must also provide the path to the log file
-where traces are saved.
+You must provide the map (or ELF) file and SVD information needed for
+translating trace values on the command line. You must also provide the path
+to the log file where traces are saved.
 
 The log file should likely be the recording from a terminal interface (such as
 RTT or serial port) to an execution tracer back-end.
 
+Log files may be in text format (one value per line, as written by
+DumpExecTraceLog() with DUMP_FORMAT_HEX_TEXT, or several values per line with
+DUMP_FORMAT_BASE64_TEXT) or in raw binary format (as
+written with DUMP_FORMAT_RAW_BINARY). Use --binary for the latter, and add
+--compact if the target was also built with COMPACT_ENCODING. Use --framed for
+log files written with DUMP_FORMAT_FRAMED; Lost entries are then reported, and
+the log may start or end partway through a frame.
+
+The decoded trace is written to stdout, or to --output, as human readable text
+or, with --format, as CSV or JSON Lines for further processing (see
+trace_sinks.py). --format chrome writes function calls as spans in Chrome Trace
+Event JSON, to be opened in Perfetto (https://ui.perfetto.dev). Its time scale
+comes from timestamps with --ticks_per_us, or is one microsecond per entry.
+
+To decode only part of a long log file, select a segment (the part between
+two starts of the target) with --segment, and optionally a time range within
+it with --start and --end, or --last. --entry starts at the given entry. The
+log file is indexed on first use (see trace_index.py), so that decoding can
+start close to the selection.
+
+With --jobs, the log file is split at the index's checkpoints (segment starts
+and every few thousand entries) and the parts are decoded in parallel, in as
+many processes. The output is the same as without --jobs. The first run still
+reads the whole log file once to index it.
+
+To count or select entries in long log files without decoding every entry,
+see trace_array.py.
+
+Symbol tables are cached after the first run with a given map or ELF file and
+SVD file (see symbol_cache.py). Use --no_cache to parse them every time.
+
+Messages traced with TRACE_Printf() are formatted with the format strings of
+the ELF file; With a map file, only their raw arguments are shown. TRACE_Line()
+entries show file names if the module manifest written by the build is given
+with --modules; Otherwise, they show module numbers.
+
 Limitations (and areas for future work):
-  - Raw trace buffer data is not supported. Every value must be
-    formatted with either "0x%X\n" or "%u\n" printf format strings.
+  - Text log files must have every value formatted with either "0x%X\n" or
+    "%u\n" printf format strings, or as base64 lines.
+  - Binary log files are assumed to have been captured from a little-endian
+    target.
   - Flash, RAM and peripheral register base addresses are all hard-coded for
     STMicro.
 """
-from parse_map_file import read_gnu_map_file
-from parse_svd import get_mcu_register_set
-from exec_trace_parser import ExecTraceParser, TraceReaderInterface
+from symbol_cache import load_symbol_tables, load_format_strings, load_module_names, default_cache_dir
+from exec_trace_parser import (ExecTraceParser, TraceReaderInterface, CompactTraceReader, FramedTraceReader,
+                               BASE64_LINE_START, base64_line_values)
+from trace_sinks import SINKS
 
 import argparse
+import array
+import collections
+import contextlib
 import io
+import multiprocessing
+import os
 import sys
 
 FLASH_BASE = 0x08000000
 RAM_BASE   = 0x20000000
 SFR_BASE   = 0x40000000
 
+"""Start of base64 lines, for log files opened in text or binary mode."""
+BASE64_STARTS = (BASE64_LINE_START, BASE64_LINE_START.encode('ascii'))
+
 class TextFileTraceReader(TraceReaderInterface):
     """Read trace buffer values saved to a log file in text format.
 
@@ -33,16 +80,25 @@ class TextFileTraceReader(TraceReaderInterface):
     a new line character.
       hex format: 0xXXXXXXXX
       decimal format: XXXXXXXXX
+    Lines written with DUMP_FORMAT_BASE64_TEXT, which start with
+    BASE64_LINE_START and hold several values, may be mixed in.
 
     The log file must not contain anything other than trace buffer data.
+
+    The log file may also be opened in binary mode; tell() then returns
+    offsets that can be seeked to, except partway through a base64 line.
     """
-    def __init__(self, log_file: io.StringIO):
+    def __init__(self, log_file: io.StringIO, offset=0):
         """Initializes the log file trace reader.
 
         Args:
           log_file: A text stream reader object returned by open().
+          offset: Byte offset of the log file's current position, for tell().
         """
         self.log_file = log_file
+        self.offset = offset
+        # Values of the last base64 line that have not been returned yet
+        self.pending = collections.deque()
 
     def read_next(self) -> int:
         """Read the next value from the log file and return it as an integer.
@@ -51,35 +107,184 @@ class TextFileTraceReader(TraceReaderInterface):
           The next value from the log file or
           TraceReaderInterface.END_OF_TRACE_BUFFER if there are no more values.
         """
-        line = self.log_file.readline()
-        if len(line) > 0:
-            value = int(line, 0)
-        else:
-            value = TraceReaderInterface.END_OF_TRACE_BUFFER
+        while not self.pending:
+            line = self.log_file.readline()
+            if len(line) == 0:
+                return TraceReaderInterface.END_OF_TRACE_BUFFER
+            self.offset += len(line)
+            if line[:1] not in BASE64_STARTS:
+                return int(line, 0)
+            self.pending.extend(base64_line_values(line))
+        return self.pending.popleft()
+
+    def tell(self):
+        if self.pending:
+            return None
+        return self.offset
+
+class BinaryFileTraceReader(TraceReaderInterface):
+    """Read trace buffer values saved to a log file in raw binary format.
+
+    Each value is a 32-bit little-endian word. This is the format produced by
+    DumpExecTraceLog() when the execution tracer is built with
+    DUMP_FORMAT_RAW_BINARY. With COMPACT_ENCODING, values are 16-bit
+    halfwords instead and must be expanded by CompactTraceReader.
+
+    The log file must not contain anything other than trace buffer data.
+    """
+    def __init__(self, log_file: io.BufferedReader, word_size=4, offset=0):
+        """Initializes the binary log file trace reader.
+
+        Args:
+          log_file: A binary stream reader object returned by open(..., 'rb').
+          word_size: Bytes per value; 4, or 2 for the compact encoding.
+          offset: Byte offset of the log file's current position, for tell().
+        """
+        self.log_file = log_file
+        self.word_size = word_size
+        # Byte offset of the first value in the block
+        self.offset = offset
+        # Values are read from the file a block at a time
+        self.values = array.array('I' if word_size == 4 else 'H')
+        self.pos = 0
+        if self.values.itemsize != word_size:
+            raise InputError("Unsupported word size %u" % word_size)
+
+    def read_next(self) -> int:
+        """Read the next word from the log file and return it as an integer.
+
+        Returns:
+          The next value from the log file or
+          TraceReaderInterface.END_OF_TRACE_BUFFER if there are no more values.
+          A trailing partial word is treated as the end of the log file.
+        """
+        if self.pos >= len(self.values):
+            data = self.log_file.read(64 * 1024 * self.word_size)
+            data = data[:len(data) - len(data) % self.word_size]
+            if not data:
+                return TraceReaderInterface.END_OF_TRACE_BUFFER
+            self.offset += len(self.values) * self.word_size
+            self.values = array.array(self.values.typecode, data)
+            if sys.byteorder != 'little':
+                self.values.byteswap()
+            self.pos = 0
+        value = self.values[self.pos]
+        self.pos += 1
         return value
 
-def live_trace(reader, functions, variables, registers):
+    def tell(self):
+        return self.offset + self.pos * self.word_size
+
+def live_trace(reader, functions, variables, registers, sink=None, format_strings=None, module_names=None):
     """Parse all values from the log file and output to stdout.
 
     Iterates over the entire log file, translating all trace values to human
-    readable format and outputting the results to stdout.
+    readable format and outputting the results to stdout, or to sink.
 
     The user must use ^C to terminate this function.
 
     Args:
-      reader: A TextFileTraceReader object for retrieving trace buffer
-              values.
-      functions: Dictionary that maps MCU addresses to function names.
-      variables: Dictionary that maps MCU addresses to variable names.
+      reader: A TextFileTraceReader, BinaryFileTraceReader or
+              FramedTraceReader object for retrieving trace buffer values.
+      functions: Dictionary that maps MCU addresses to
+                 parse_map_file.MapSymbol objects for functions.
+      variables: Dictionary that maps MCU addresses to
+                 parse_map_file.MapSymbol objects for variables.
       registers: Dictionary that maps MCU addresses to
                  parse_svd.PeripheralRegister objects.
+      sink: A trace_sinks.TraceSink object, or None for text on stdout.
+      format_strings: Dictionary that maps addresses to TRACE_Printf()
+                      format strings, or None.
+      module_names: Dictionary that maps TRACE_Line() module numbers to file
+                    names, or None.
 
     """
+    tracer = new_parser(functions, variables, registers, format_strings, module_names)
+    tracer.read_and_trace_all(reader, sink)
+
+def new_parser(functions, variables, registers, format_strings=None, module_names=None):
+    """Return an ExecTraceParser for the symbol tables, with the MCU's base
+    addresses, the format strings and the module names set."""
     tracer = ExecTraceParser(functions, variables, registers)
     tracer.set_flash_base(FLASH_BASE)
     tracer.set_ram_base(RAM_BASE)
     tracer.set_sfr_base(SFR_BASE)
-    tracer.read_and_trace_all(reader)
+    if format_strings:
+        tracer.set_format_strings(format_strings)
+    if module_names:
+        tracer.set_module_names(module_names)
+    return tracer
+
+"""Per-process state of parallel_trace() workers."""
+worker = None
+
+def init_worker(log_file_name, index, symbol_args, module_names, output_format):
+    """Load the symbol tables in a parallel_trace() worker process."""
+    global worker
+    # Symbol loading progress is already shown by the main process
+    with contextlib.redirect_stdout(io.StringIO()):
+        functions, variables, registers = load_symbol_tables(*symbol_args)
+        format_strings = load_format_strings(symbol_args[0])
+    worker = (log_file_name, index, new_parser(functions, variables, registers, format_strings, module_names),
+              SINKS[output_format](None))
+
+def decode_chunk(chunk):
+    """Return the output of one chunk of the log file, in a worker."""
+    log_file_name, index, tracer, sink = worker
+    first, stop = chunk
+    if hasattr(sink, 'uncertain'):
+        sink.uncertain = index.checkpoints[first].shown_uncertain
+    with open(log_file_name, 'rb') as log_file:
+        return ''.join(map(sink.render, index.chunk_events(log_file, tracer, first, stop)))
+
+def parallel_trace(log_file_name, args, symbol_args, sink, jobs, module_names=None):
+    """Decode a log file in parallel processes, using its index.
+
+    Args:
+      log_file_name: Path to the log file.
+      args: Parsed command line options: The log format, format and index.
+      symbol_args: Arguments of load_symbol_tables(), for the workers.
+      sink: A trace_sinks.TraceSink object that renders events one at a
+            time; Not ChromeTraceSink.
+      jobs: Number of processes.
+      module_names: As for live_trace().
+    """
+    from trace_index import open_index, log_format_of
+
+    index = open_index(log_file_name, log_format_of(args), index_file_name=args.index)
+    # More chunks than processes keep them all busy until the end
+    chunks = index.chunks(jobs * 4)
+    sink.flush()
+    with multiprocessing.Pool(jobs, init_worker, (log_file_name, index, symbol_args, module_names,
+                                                   args.format)) as pool:
+        for text in pool.imap(decode_chunk, chunks):
+            sink.out.write(text)
+
+def indexed_trace(log_file_name, args, functions, variables, registers, sink, format_strings=None,
+                  module_names=None):
+    """Decode the part of a log file selected by the command line options,
+    using its index.
+
+    Args:
+      log_file_name: Path to the log file.
+      args: Parsed command line options: The log format, and segment, start,
+            end, last, entry and index.
+      functions, variables, registers: As for live_trace().
+      sink: A trace_sinks.TraceSink object.
+      format_strings, module_names: As for live_trace().
+    """
+    from trace_index import open_index, log_format_of
+
+    index = open_index(log_file_name, log_format_of(args), index_file_name=args.index)
+    tracer = new_parser(functions, variables, registers, format_strings, module_names)
+    with open(log_file_name, 'rb') as log_file:
+        try:
+            sink.write_all(index.events(log_file, tracer, args.segment, args.start, args.end, args.last,
+                                        args.entry))
+        except (IndexError, ValueError) as e:
+            raise InputError(e)
+        finally:
+            sink.flush()
 
 def main():
     """Parse a log file saved from a back-end terminal and output the results
@@ -90,41 +295,109 @@ def main():
     global ser
 
     parser = argparse.ArgumentParser(description='GNU Map file parser')
-    parser.add_argument('--map_file', '-m', help='GNU Map file', type=str, required=True)
+    symbol_group = parser.add_mutually_exclusive_group(required=True)
+    symbol_group.add_argument('--map_file', '-m', help='GNU Map file', type=str)
+    symbol_group.add_argument('--elf_file', '-e', help='ELF file (instead of a map file)', type=str)
     parser.add_argument('--file', '-f', help='Log file', type=str, required=True)
+    parser.add_argument('--binary', '-b', help='Log file is in raw binary format', action='store_true')
+    parser.add_argument('--compact', '-c', help='Raw binary log file uses the compact encoding', action='store_true')
+    parser.add_argument('--framed', help='Log file is in framed format', action='store_true')
+    parser.add_argument('--format', help='Output format', choices=SINKS.keys(), default='text')
+    parser.add_argument('--ticks_per_us', help='Timestamp ticks per microsecond (with --format chrome)',
+                        type=float, required=False)
+    parser.add_argument('--output', '-o', help='Output file (default stdout)', type=str, required=False)
+    parser.add_argument('--segment', help='Decode only this segment (from 0; negative counts from the end)',
+                        type=int, required=False)
+    parser.add_argument('--start', help='Time in the segment to decode from, in timestamp ticks', type=int,
+                        required=False)
+    parser.add_argument('--end', help='Time in the segment to decode to, in timestamp ticks', type=int,
+                        required=False)
+    parser.add_argument('--last', help='Decode the last ticks of the segment', type=int, required=False)
+    parser.add_argument('--entry', help='Entry to decode from, counted from 0', type=int, required=False)
+    parser.add_argument('--index', help='Index file (default: the log file with an .idx suffix)', type=str,
+                        required=False)
+    parser.add_argument('--jobs', '-j', help='Decode in this many processes (0 for one per CPU)', type=int,
+                        default=1)
+    parser.add_argument('--modules', help='Module manifest written by exec_trace_module_ids() in CMake', type=str,
+                        required=False)
     parser.add_argument('--svd_file', help='SVD file in XML foramt', type=str, required=False)
     parser.add_argument('--make', help='Vendor (e.g. Atmel or STMicro)', type=str, required=False)
     parser.add_argument('--model', help='Device name (e.g. ATSAMA5D33 or STM32L4x6)', type=str, required=False)
+    parser.add_argument('--cache_dir', help='Symbol cache directory', type=str, default=default_cache_dir())
+    parser.add_argument('--no_cache', help='Always parse the map and SVD files', action='store_true')
     args = parser.parse_args()
+    indexed = any(option is not None for option in (args.segment, args.start, args.end, args.last, args.entry))
+    jobs = args.jobs or os.cpu_count()
+    if jobs > 1 and (indexed or args.format == 'chrome'):
+        raise InputError("--jobs can't be used with a selection or with --format chrome")
 
-    map_file = args.map_file
+    symbol_file = args.map_file or args.elf_file
     log_file_name = args.file
+    binary = args.binary
+    compact = args.compact
+    framed = args.framed
     svd_file = args.svd_file
     make = args.make
     model = args.model
+    cache_dir = None if args.no_cache else args.cache_dir
 
-    functions, variables = read_gnu_map_file(map_file)
+    functions, variables, registers = load_symbol_tables(symbol_file, svd_file, make, model, cache_dir)
+    format_strings = load_format_strings(symbol_file)
+    module_names = load_module_names(args.modules) if args.modules else None
     if functions:
         # Can trace functions found here
         pass
     else:
-        print("WARNING: No functions found in %s" % map_file)
+        print("WARNING: No functions found in %s" % symbol_file, file=sys.stderr)
     if variables:
         # Can trace variables found here
         pass
     else:
-        print("WARNING: No variables found in %s" % map_file)
+        print("WARNING: No variables found in %s" % symbol_file, file=sys.stderr)
 
-    registers = get_mcu_register_set(svd_file, make, model)
     if registers:
         # Can trace registers found here
         pass
     else:
-        print("WARNING: No peripheral registers found")
+        print("WARNING: No peripheral registers found", file=sys.stderr)
 
-    with open(log_file_name) as log_file:
-        reader = TextFileTraceReader(log_file)
-        live_trace(reader, functions, variables, registers)
+    if args.output:
+        out = open(args.output, 'w', newline='' if args.format == 'csv' else None)
+    else:
+        out = sys.stdout
+    if args.format == 'chrome':
+        sink = SINKS[args.format](out, ticks_per_us=args.ticks_per_us)
+    else:
+        sink = SINKS[args.format](out)
+
+    if jobs > 1:
+        parallel_trace(log_file_name, args, (symbol_file, svd_file, make, model, cache_dir), sink, jobs,
+                       module_names)
+    elif indexed:
+        indexed_trace(log_file_name, args, functions, variables, registers, sink, format_strings, module_names)
+    elif framed:
+        with open(log_file_name, 'rb') as log_file:
+            reader = FramedTraceReader(lambda: log_file.read(65536))
+            live_trace(reader, functions, variables, registers, sink, format_strings, module_names)
+            if reader.frames_corrupt or reader.entries_lost:
+                print("%u frames received, %u corrupt, %u entries lost" %
+                      (reader.frames_received, reader.frames_corrupt, reader.entries_lost),
+                      file=sys.stderr if out is sys.stdout else sys.stdout)
+    elif binary and compact:
+        with open(log_file_name, 'rb') as log_file:
+            reader = CompactTraceReader(BinaryFileTraceReader(log_file, 2))
+            live_trace(reader, functions, variables, registers, sink, format_strings, module_names)
+    elif binary:
+        with open(log_file_name, 'rb') as log_file:
+            reader = BinaryFileTraceReader(log_file)
+            live_trace(reader, functions, variables, registers, sink, format_strings, module_names)
+    else:
+        with open(log_file_name) as log_file:
+            reader = TextFileTraceReader(log_file)
+            live_trace(reader, functions, variables, registers, sink, format_strings, module_names)
+    sink.close()
+    if out is not sys.stdout:
+        out.close()
 
 class InputError(RuntimeError):
     """Boilerplate code for using this file directly from the command line."""
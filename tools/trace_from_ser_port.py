@@ -1,30 +1,68 @@
 """Start a live exeuction trace for an embedded target using the selected
 serial port.
 
-You must provide the map file and SVD information needed for translating trace
-values on the command line. You must also specify the serial device. This will
-be of the form 'COMn' on Windows or '/dev/ttyn' on Mac or Linux.
+You must provide the map (or ELF) file and SVD information needed for
+translating trace values on the command line. You must also specify the serial
+device. This will be of the form 'COMn' on Windows or '/dev/ttyn' on Mac or
+Linux.
+
+Symbol tables are cached after the first run with a given map or ELF file and
+SVD file (see symbol_cache.py). Use --no_cache to parse them every time.
+
+Messages traced with TRACE_Printf() are formatted with the format strings of
+the ELF file; With a map file, only their raw arguments are shown. TRACE_Line()
+entries show file names if the module manifest written by the build is given
+with --modules; Otherwise, they show module numbers.
 
 Limitations (and areas for future work):
   - The serial port is operated at 921600 with no flow control. There are no
     command-line options to modify this.
-  - Raw UINT values on the serial port are not supported. Every value must be
-    formatted with either "0x%X\n" or "%u\n" printf format strings.
+  - In text mode, every value must be formatted with either "0x%X\n" or
+    "%u\n" printf format strings, or as base64 lines written with
+    DUMP_FORMAT_BASE64_TEXT, which take half the bandwidth.
+  - In binary mode (--binary), values are raw 32-bit little-endian words as
+    written by DumpExecTraceLog() with DUMP_FORMAT_RAW_BINARY. There is no
+    framing, so the trace must be started before the target begins dumping.
+    Add --compact if the target was also built with COMPACT_ENCODING.
+  - In framed mode (--framed), the target must be built with
+    DUMP_FORMAT_FRAMED. The trace may be started at any time, and entries
+    lost to dropped or corrupted bytes are reported.
   - Flash, RAM and peripheral register base addresses are all hard-coded for
     STMicro.
+
+Pipelined mode (--pipelined):
+  Reading the serial port, decoding and writing to stdout run as separate
+  stages, so that a slow terminal or decoder doesn't stop the serial port from
+  being drained. A reader thread moves received bytes into a bounded ring
+  (--ring_size), the main thread decodes from the ring, and an output thread
+  writes the decoded text in batches. If the ring fills, received bytes are
+  dropped and counted rather than left to overflow the OS serial buffer;
+  --framed is recommended so that the decoder recovers from such drops.
+
+  Every --stats seconds, and on exit, each stage's throughput and backlog are
+  written to stderr, for example:
+    serial 88.1 KB/s, ring 3% (max 41%), 0 B dropped | decode 24.0k values/s | output 310.2 KB/s, 0 KB queued
+  A ring that keeps filling up points at the decoder; An output queue that
+  keeps growing points at the terminal.
 """
-from parse_map_file import read_gnu_map_file
-from parse_svd import get_mcu_register_set
-from exec_trace_parser import ExecTraceParser, TraceReaderInterface
+from symbol_cache import load_symbol_tables, load_format_strings, load_module_names, default_cache_dir
+from exec_trace_parser import (ExecTraceParser, TraceReaderInterface, CompactTraceReader, FramedTraceReader,
+                               BASE64_LINE_START, base64_line_values)
 
 import argparse
+import collections
+import queue
 import serial
 import sys
+import threading
+import time
 
 FLASH_BASE = 0x08000000
 RAM_BASE   = 0x20000000
 SFR_BASE   = 0x40000000
 
+BASE64_START = BASE64_LINE_START.encode('ascii')
+
 class SerialPortTraceReader(TraceReaderInterface):
     """Read trace buffer values from a serial port back end.
 
@@ -32,6 +70,8 @@ class SerialPortTraceReader(TraceReaderInterface):
     a new line character.
       hex format: 0xXXXXXXXX
       decimal format: XXXXXXXXX
+    Lines written with DUMP_FORMAT_BASE64_TEXT, which start with
+    BASE64_LINE_START and hold several values, are also accepted.
 
     Trace buffer data must be the only thing output on this serial port.
     """
@@ -44,23 +84,339 @@ class SerialPortTraceReader(TraceReaderInterface):
                        rate, stop bits, flow control and so forth.
         """
         self.ser = serial_port
+        # Values of the last base64 line that have not been returned yet
+        self.pending = collections.deque()
 
     def read_next(self) -> int:
         """Return the next value from the trace buffer and return it as an
         integer.
 
-        This function reads one line from the serial port. If the serial port's
-        RX buffer is empty, it blocks until the next value is available.
+        This function reads one line from the serial port, unless values of
+        the last base64 line are left. If the serial port's RX buffer is empty,
+        it blocks until the next value is available.
+
+        Returns:
+          The next value from the trace buffer.
+        """
+        while not self.pending:
+            line = self.ser.read_until()
+            line = line.decode(encoding='utf-8')
+            if not line.startswith(BASE64_LINE_START):
+                return int(line, 0)
+            self.pending.extend(base64_line_values(line))
+        return self.pending.popleft()
+
+class BinarySerialPortTraceReader(TraceReaderInterface):
+    """Read raw binary trace buffer values from a serial port back end.
+
+    Each value is a 32-bit little-endian word. This is the format produced by
+    DumpExecTraceLog() when the execution tracer is built with
+    DUMP_FORMAT_RAW_BINARY. With COMPACT_ENCODING, values are 16-bit
+    halfwords instead and must be expanded by CompactTraceReader.
+
+    Trace buffer data must be the only thing output on this serial port.
+    """
+    def __init__(self, serial_port: serial.Serial, word_size=4):
+        """Initializes the binary serial port trace reader.
+
+        Args:
+          serial_port: An already open and configured serial port. This should
+                       already be set up with the proper settings for baud
+                       rate, stop bits, flow control and so forth.
+          word_size: Bytes per value; 4, or 2 for the compact encoding.
+        """
+        self.ser = serial_port
+        self.word_size = word_size
+
+    def read_next(self) -> int:
+        """Return the next value from the trace buffer as an integer.
+
+        This function reads one word from the serial port. If the serial
+        port's RX buffer is empty, it blocks until the next value is available.
 
         Returns:
           The next value from the trace buffer.
         """
-        line = self.ser.read_until()
-        line = line.decode(encoding='utf-8')
-        value = int(line, 0)
+        data = self.ser.read(self.word_size)
+        return int.from_bytes(data, byteorder='little')
+
+class ByteRing:
+    """Bounded FIFO of received bytes, between the serial reader thread and
+    the decoder.
+
+    Writes never block. Bytes that don't fit are dropped and counted, so that
+    the serial port is always drained.
+    """
+    def __init__(self, capacity):
+        self.buffer = bytearray(capacity)
+        self.capacity = capacity
+        # Free-running byte counts; Their difference is the backlog
+        self.head = 0
+        self.tail = 0
+        self.dropped = 0
+        self.high_water = 0
+        self.closed = False
+        self.cond = threading.Condition()
+
+    def backlog(self):
+        return self.head - self.tail
+
+    def write(self, data):
+        with self.cond:
+            free = self.capacity - (self.head - self.tail)
+            if len(data) > free:
+                self.dropped += len(data) - free
+                data = data[:free]
+            start = self.head % self.capacity
+            first = min(len(data), self.capacity - start)
+            self.buffer[start:start + first] = data[:first]
+            self.buffer[:len(data) - first] = data[first:]
+            self.head += len(data)
+            self.high_water = max(self.high_water, self.head - self.tail)
+            self.cond.notify()
+
+    def read(self, max_size):
+        """Return up to max_size bytes, blocking until there is at least one.
+        Returns an empty bytes object once the ring is closed and empty."""
+        with self.cond:
+            while self.head == self.tail and not self.closed:
+                self.cond.wait()
+            size = min(max_size, self.head - self.tail)
+            start = self.tail % self.capacity
+            first = min(size, self.capacity - start)
+            data = bytes(self.buffer[start:start + first]) + bytes(self.buffer[:size - first])
+            self.tail += size
+            return data
+
+    def close(self):
+        with self.cond:
+            self.closed = True
+            self.cond.notify_all()
+
+class ChunkTraceReader(TraceReaderInterface):
+    """Read raw binary or text trace values from a function returning chunks
+    of received bytes, such as ByteRing.read.
+
+    Text lines may also be base64 lines written with DUMP_FORMAT_BASE64_TEXT.
+    Lines that don't parse (for example because bytes were dropped) are
+    skipped and counted in malformed.
+    """
+    def __init__(self, read_chunk, word_size=None):
+        """Initializes the chunk trace reader.
+
+        Args:
+          read_chunk: Function returning the next received bytes, or an empty
+                      bytes object at the end of the stream.
+          word_size: Bytes per raw binary value, or None for text values.
+        """
+        self.read_chunk = read_chunk
+        self.word_size = word_size
+        self.buffer = bytearray()
+        self.pos = 0
+        self.malformed = 0
+        # Values of the last base64 line that have not been returned yet
+        self.pending = collections.deque()
+
+    def fill(self, size):
+        """Make at least size bytes available from pos; Return False at the
+        end of the stream."""
+        while len(self.buffer) - self.pos < size:
+            chunk = self.read_chunk()
+            if not chunk:
+                return False
+            del self.buffer[:self.pos]
+            self.pos = 0
+            self.buffer += chunk
+        return True
+
+    def read_next(self) -> int:
+        if self.word_size:
+            if not self.fill(self.word_size):
+                return TraceReaderInterface.END_OF_TRACE_BUFFER
+            value = int.from_bytes(self.buffer[self.pos:self.pos + self.word_size], byteorder='little')
+            self.pos += self.word_size
+            return value
+
+        if self.pending:
+            return self.pending.popleft()
+        while True:
+            end = self.buffer.find(b'\n', self.pos)
+            if end < 0:
+                if not self.fill(len(self.buffer) - self.pos + 1):
+                    return TraceReaderInterface.END_OF_TRACE_BUFFER
+                continue
+            line = self.buffer[self.pos:end]
+            self.pos = end + 1
+            try:
+                if line[:1] != BASE64_START:
+                    return int(line.decode(encoding='ascii'), 0)
+                self.pending.extend(base64_line_values(line))
+            except (UnicodeDecodeError, ValueError):
+                self.malformed += 1
+                continue
+            if self.pending:
+                return self.pending.popleft()
+
+class CountingTraceReader(TraceReaderInterface):
+    """Count the values passing through another trace reader."""
+    def __init__(self, reader: TraceReaderInterface):
+        self.reader = reader
+        self.count = 0
+        # Used by ExecTraceParser when reader returns ENTRIES_LOST
+        self.last_loss = 0
+
+    def read_next(self) -> int:
+        value = self.reader.read_next()
+        if value >= 0:
+            self.count += 1
+        self.last_loss = getattr(self.reader, 'last_loss', 0)
         return value
 
-def live_trace(reader, functions, variables, registers):
+class BatchedOutput:
+    """File-like object that collects text and hands it to an output thread
+    in batches, instead of writing every line as it is produced."""
+    def __init__(self, out, batch_size=64 * 1024, max_batches=64, flush_interval=0.1):
+        """Initializes the batched output.
+
+        Args:
+          out: Text stream the output thread writes to.
+          batch_size: Characters collected before a batch is queued.
+          max_batches: Queued batches before write() blocks.
+          flush_interval: Longest time, in seconds, that text waits in a
+                          partial batch.
+        """
+        self.out = out
+        self.batch_size = batch_size
+        self.flush_interval = flush_interval
+        self.batches = queue.Queue(max_batches)
+        self.lock = threading.Lock()
+        self.pending = []
+        self.pending_size = 0
+        self.queued_size = 0
+        self.written = 0
+        self.stopped = False
+        self.thread = threading.Thread(target=self.run, name='output', daemon=True)
+        self.thread.start()
+
+    def write(self, text):
+        with self.lock:
+            self.pending.append(text)
+            self.pending_size += len(text)
+            if self.pending_size < self.batch_size:
+                return len(text)
+            batch = self.take_pending()
+        self.batches.put(batch)
+        return len(text)
+
+    def flush(self):
+        pass
+
+    def take_pending(self):
+        """Return the pending text as one batch. Call with the lock held."""
+        batch = ''.join(self.pending)
+        self.pending = []
+        self.pending_size = 0
+        self.queued_size += len(batch)
+        return batch
+
+    def backlog(self):
+        """Characters produced but not yet written."""
+        return self.queued_size + self.pending_size
+
+    def run(self):
+        while True:
+            try:
+                batch = self.batches.get(timeout=self.flush_interval)
+            except queue.Empty:
+                with self.lock:
+                    if self.stopped and not self.pending:
+                        return
+                    if not self.pending:
+                        continue
+                    batch = self.take_pending()
+            self.out.write(batch)
+            self.out.flush()
+            with self.lock:
+                self.queued_size -= len(batch)
+                self.written += len(batch)
+
+    def close(self):
+        """Write out everything still pending and stop the output thread."""
+        with self.lock:
+            self.stopped = True
+        self.thread.join()
+
+def read_serial_port(ser: serial.Serial, ring: ByteRing, stop: threading.Event):
+    """Reader stage: Drain the serial port into the ring until stopped."""
+    while not stop.is_set():
+        data = ser.read(max(1, ser.in_waiting))
+        if data:
+            ring.write(data)
+    ring.close()
+
+def report_stats(ring, values, output, stop, interval, file=sys.stderr):
+    """Write the throughput and backlog of each stage to file every interval
+    seconds until stopped, and once more after."""
+    last = (time.monotonic(), ring.head, values.count, output.written)
+    while True:
+        stopped = stop.wait(interval) if interval else stop.wait()
+        now = (time.monotonic(), ring.head, values.count, output.written)
+        elapsed = max(now[0] - last[0], 1e-9)
+        print("serial %.1f KB/s, ring %u%% (max %u%%), %u B dropped | decode %.1fk values/s | "
+              "output %.1f KB/s, %u KB queued" %
+              ((now[1] - last[1]) / elapsed / 1024,
+               100 * ring.backlog() // ring.capacity, 100 * ring.high_water // ring.capacity,
+               ring.dropped, (now[2] - last[2]) / elapsed / 1000,
+               (now[3] - last[3]) / elapsed / 1024, output.backlog() // 1024), file=file, flush=True)
+        last = now
+        if stopped:
+            return
+
+def pipelined_live_trace(ser, make_reader, ring_size, stats_interval, functions, variables, registers,
+                         format_strings=None, module_names=None):
+    """Start a live trace with reading, decoding and output in separate stages.
+
+    The user must use ^C to terminate this function.
+
+    Args:
+      ser: The open serial port. Its read timeout is changed so that the
+           reader thread can be stopped.
+      make_reader: Function that takes a read_chunk function and returns the
+                   trace reader that decodes from it.
+      ring_size: Capacity, in bytes, of the ring between reader and decoder.
+      stats_interval: Seconds between stage statistics on stderr, or 0 to
+                      only write them on exit.
+      functions, variables, registers, format_strings, module_names: As for
+        live_trace().
+    """
+    ser.timeout = 0.1
+    ring = ByteRing(ring_size)
+    values = CountingTraceReader(make_reader(lambda: ring.read(64 * 1024)))
+    output = BatchedOutput(sys.stdout)
+    stop = threading.Event()
+    reader_thread = threading.Thread(target=read_serial_port, args=(ser, ring, stop), name='serial', daemon=True)
+    stats_thread = threading.Thread(target=report_stats, args=(ring, values, output, stop, stats_interval),
+                                    name='stats', daemon=True)
+    reader_thread.start()
+    stats_thread.start()
+
+    real_stdout = sys.stdout
+    sys.stdout = output
+    try:
+        live_trace(values, functions, variables, registers, format_strings, module_names)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        sys.stdout = real_stdout
+        stop.set()
+        reader_thread.join()
+        output.close()
+        stats_thread.join()
+        malformed = getattr(values.reader, 'malformed', 0)
+        if malformed:
+            print("%u malformed lines skipped" % malformed, file=sys.stderr)
+
+def live_trace(reader, functions, variables, registers, format_strings=None, module_names=None):
     """Start an execution tracer live trace on the selected serial port.
 
     Continuously reads trace values from the serial port and converts them to
@@ -69,18 +425,28 @@ def live_trace(reader, functions, variables, registers):
     The user must use ^C to terminate this function.
 
     Args:
-      reader: A SerialPortTraceReader object for retrieving trace buffer
-              values.
-      functions: Dictionary that maps MCU addresses to function names.
-      variables: Dictionary that maps MCU addresses to variable names.
+      reader: A SerialPortTraceReader, BinarySerialPortTraceReader or
+              FramedTraceReader object for retrieving trace buffer values.
+      functions: Dictionary that maps MCU addresses to
+                 parse_map_file.MapSymbol objects for functions.
+      variables: Dictionary that maps MCU addresses to
+                 parse_map_file.MapSymbol objects for variables.
       registers: Dictionary that maps MCU addresses to
                  parse_svd.PeripheralRegister objects.
+      format_strings: Dictionary that maps addresses to TRACE_Printf()
+                      format strings, or None.
+      module_names: Dictionary that maps TRACE_Line() module numbers to file
+                    names, or None.
 
     """
     tracer = ExecTraceParser(functions, variables, registers)
     tracer.set_flash_base(FLASH_BASE)
     tracer.set_ram_base(RAM_BASE)
     tracer.set_sfr_base(SFR_BASE)
+    if format_strings:
+        tracer.set_format_strings(format_strings)
+    if module_names:
+        tracer.set_module_names(module_names)
     tracer.read_and_trace_all(reader)
 
 def main():
@@ -92,41 +458,83 @@ def main():
     global ser
 
     parser = argparse.ArgumentParser(description='GNU Map file parser')
-    parser.add_argument('--map_file', '-m', help='GNU Map file', type=str, required=True)
+    symbol_group = parser.add_mutually_exclusive_group(required=True)
+    symbol_group.add_argument('--map_file', '-m', help='GNU Map file', type=str)
+    symbol_group.add_argument('--elf_file', '-e', help='ELF file (instead of a map file)', type=str)
     parser.add_argument('--serial', '-s', help='Serial device', type=str, required=True)
+    parser.add_argument('--binary', '-b', help='Target dumps in raw binary format', action='store_true')
+    parser.add_argument('--compact', '-c', help='Target uses the compact encoding (with --binary)', action='store_true')
+    parser.add_argument('--framed', help='Target dumps in framed format', action='store_true')
+    parser.add_argument('--pipelined', '-p', help='Read, decode and output in separate stages', action='store_true')
+    parser.add_argument('--ring_size', help='Bytes buffered between reading and decoding (with --pipelined)',
+                        type=int, default=4 * 1024 * 1024)
+    parser.add_argument('--stats', help='Seconds between stage statistics on stderr, 0 for only on exit '
+                        '(with --pipelined)', type=float, default=5)
+    parser.add_argument('--modules', help='Module manifest written by exec_trace_module_ids() in CMake', type=str,
+                        required=False)
     parser.add_argument('--svd_file', help='SVD file in XML foramt', type=str, required=False)
     parser.add_argument('--make', help='Vendor (e.g. Atmel or STMicro)', type=str, required=False)
     parser.add_argument('--model', help='Device name (e.g. ATSAMA5D33 or STM32L4x6)', type=str, required=False)
+    parser.add_argument('--cache_dir', help='Symbol cache directory', type=str, default=default_cache_dir())
+    parser.add_argument('--no_cache', help='Always parse the map and SVD files', action='store_true')
     args = parser.parse_args()
 
-    map_file = args.map_file
+    symbol_file = args.map_file or args.elf_file
     ser_port_name = args.serial
+    binary = args.binary
+    compact = args.compact
+    framed = args.framed
+    pipelined = args.pipelined
     svd_file = args.svd_file
     make = args.make
     model = args.model
+    cache_dir = None if args.no_cache else args.cache_dir
 
-    functions, variables = read_gnu_map_file(map_file)
+    functions, variables, registers = load_symbol_tables(symbol_file, svd_file, make, model, cache_dir)
+    format_strings = load_format_strings(symbol_file)
+    module_names = load_module_names(args.modules) if args.modules else None
     if functions:
         # Can trace functions found here
         pass
     else:
-        print("WARNING: No functions found in %s" % map_file)
+        print("WARNING: No functions found in %s" % symbol_file, file=sys.stderr)
     if variables:
         # Can trace variables found here
         pass
     else:
-        print("WARNING: No variables found in %s" % map_file)
+        print("WARNING: No variables found in %s" % symbol_file, file=sys.stderr)
 
-    registers = get_mcu_register_set(svd_file, make, model)
     if registers:
         # Can trace registers found here
         pass
     else:
-        print("WARNING: No peripheral registers found")
+        print("WARNING: No peripheral registers found", file=sys.stderr)
 
-    reader = SerialPortTraceReader(serial.Serial(port=ser_port_name, baudrate=921600, rtscts=False))
+    ser = serial.Serial(port=ser_port_name, baudrate=921600, rtscts=False)
+    if pipelined:
+        if framed:
+            make_reader = FramedTraceReader
+        elif binary and compact:
+            make_reader = lambda read_chunk: CompactTraceReader(ChunkTraceReader(read_chunk, 2))
+        elif binary:
+            make_reader = lambda read_chunk: ChunkTraceReader(read_chunk, 4)
+        else:
+            make_reader = ChunkTraceReader
+        pipelined_live_trace(ser, make_reader, args.ring_size, args.stats, functions, variables, registers,
+                             format_strings, module_names)
+        return
+
+    if framed:
+        # Block for at least one byte, then take whatever else has arrived
+        reader = FramedTraceReader(lambda: ser.read(max(1, ser.in_waiting)))
+    elif binary and compact:
+        reader = CompactTraceReader(BinarySerialPortTraceReader(ser, 2))
+    elif binary:
+        reader = BinarySerialPortTraceReader(ser)
+    else:
+        reader = SerialPortTraceReader(ser)
 
-    live_trace(reader, functions, variables, registers)
+    live_trace(reader, functions, variables, registers, format_strings, module_names)
 
 class InputError(RuntimeError):
     """Boilerplate code for using this file directly from the command line."""
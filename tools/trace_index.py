@@ -0,0 +1,620 @@
+"""Index execution trace log files for random access.
+
+Captures from long runs, such as soak tests, can take many minutes to decode
+from the beginning. An index, built once per log file, records checkpoints
+where decoding can resume:
+  - At the start of each segment. A segment is the part of the log from one
+    start of the target to the next; It starts at a version entry, traced by
+    TRACE_Init(), or at a processor reset entry that doesn't directly follow
+    one.
+  - Every --interval entries.
+Each checkpoint holds the byte offset to seek to, the decoder state there
+(open function calls and timestamp) and the time of the last timestamped
+entry. A segment, a time range within a segment, or the entries from a given
+one on can then be decoded without decoding anything before them.
+
+Times are in timestamp ticks, as printed by trace_from_file.py. Unlike those,
+they keep counting past a wraparound of the target's 32-bit timestamp, so each
+time is unique within a segment.
+
+The index is written next to the log file, with an .idx suffix, and rebuilt
+when the log file's size or modification time changes.
+
+Usage:
+  Build the index (if needed) and list the segments:
+    trace_index.py -f soak.log
+  Decode the last 5 seconds of the third segment, that is before the third
+  restart, with timestamps counting at 1 MHz:
+    trace_from_file.py -m app.map -f soak.log --segment 2 --last 5000000
+
+Limitations (and areas for future work):
+  - Entries are counted as records: A variable, register or timestamped entry
+    counts as one.
+"""
+from exec_trace_parser import (ExecTraceParser, TraceReaderInterface, TraceEvent, CompactTraceReader,
+                               FramedTraceReader, EVENT_VERSION, EVENT_RESET)
+from trace_from_file import TextFileTraceReader, BinaryFileTraceReader
+
+import argparse
+import bisect
+import os
+import struct
+import sys
+import tempfile
+
+"""Bump whenever the index file layout or the way checkpoints are chosen
+changes."""
+INDEX_VERSION = 2
+INDEX_MAGIC = b'ETIX'
+HEADER_FORMAT = '<4sIIIQQII'
+SEGMENT_FORMAT = '<IQqq'
+CHECKPOINT_FORMAT = '<QQIIIBBHHqqqqq'
+
+"""Log file formats, as selected by the trace_from_file.py options."""
+FORMATS = ('text', 'binary', 'compact', 'framed')
+
+DEFAULT_INTERVAL = 16384
+
+def open_reader(log_file, log_format, offset=0, sequence=None):
+    """Return a trace reader for log_file, opened in binary mode, reading
+    from offset. For framed log files, sequence is the sequence number
+    expected of the frame at offset, if known."""
+    log_file.seek(offset)
+    if log_format == 'framed':
+        reader = FramedTraceReader(lambda: log_file.read(65536), offset)
+        reader.next_seq = sequence
+        return reader
+    if log_format == 'compact':
+        return CompactTraceReader(BinaryFileTraceReader(log_file, 2, offset))
+    if log_format == 'binary':
+        return BinaryFileTraceReader(log_file, 4, offset)
+    return TextFileTraceReader(log_file, offset)
+
+class SegmentTracker:
+    """Number the segments of a log as its events arrive."""
+
+    """What the current segment holds so far."""
+    EMPTY = 0
+    VERSION_ONLY = 1
+    STARTED = 2
+
+    def __init__(self, segment=0, content=EMPTY):
+        self.segment = segment
+        self.content = content
+
+    def add(self, event: TraceEvent):
+        """Return True if event starts a new segment."""
+        kind = event.kind
+        if kind == EVENT_VERSION:
+            new = self.content != SegmentTracker.EMPTY
+            self.content = SegmentTracker.VERSION_ONLY
+        elif kind == EVENT_RESET:
+            new = self.content == SegmentTracker.STARTED
+            self.content = SegmentTracker.STARTED
+        else:
+            self.content = SegmentTracker.STARTED
+            return False
+        if new:
+            self.segment += 1
+        return new
+
+class SegmentClock:
+    """Extend the 32-bit timestamps of events to a time that keeps counting
+    past a wraparound."""
+    def __init__(self, base=0, last=None):
+        self.base = base
+        self.last = last
+
+    def add(self, timestamp):
+        """Advance to the timestamp of an event, if it has one."""
+        if timestamp is None or timestamp == TraceEvent.UNKNOWN_TIMESTAMP:
+            return
+        if self.last is not None and timestamp < self.last:
+            self.base += 1 << 32
+        self.last = timestamp
+
+    def time(self):
+        """Return the time of the last timestamp, or None if there was
+        none."""
+        if self.last is None:
+            return None
+        return self.base + self.last
+
+    def reset(self):
+        """Start counting again, at the start of a segment."""
+        self.base = 0
+        self.last = None
+
+class BoundedFile:
+    """A binary file that ends at a byte offset, as if it was cut there."""
+    def __init__(self, file, end):
+        self.file = file
+        self.end = end
+        self.pos = 0
+
+    def seek(self, offset):
+        self.pos = self.file.seek(offset)
+        return self.pos
+
+    def read(self, size=-1):
+        remaining = max(self.end - self.pos, 0)
+        data = self.file.read(remaining if size < 0 else min(size, remaining))
+        self.pos += len(data)
+        return data
+
+    def readline(self):
+        line = self.file.readline(max(self.end - self.pos, 0))
+        self.pos += len(line)
+        return line
+
+class Segment:
+    """Where a segment starts, and the range of its times."""
+    __slots__ = ('first_checkpoint', 'entries', 'start_time', 'end_time')
+
+    def __init__(self, first_checkpoint, entries=0, start_time=None, end_time=None):
+        self.first_checkpoint = first_checkpoint
+        self.entries = entries
+        self.start_time = start_time
+        self.end_time = end_time
+
+class Checkpoint:
+    """A place in the log to resume decoding from.
+
+    Decoding resumes at offset with the decoder, segment tracker and clock
+    states saved there. The first skip entries are then decoded without
+    output to reach the checkpoint itself, at entry. skip is only non-zero
+    where the checkpoint is partway through a frame, as offset must be at
+    the start of one.
+
+    Attributes:
+      offset: Byte offset in the log file to seek to.
+      entry: Number of the entry at the checkpoint, counted from the start
+             of the log.
+      skip: Number of entries from offset to the checkpoint.
+      segment: Segment the entry at the checkpoint belongs to.
+      tracker: SegmentTracker state at offset, as (segment, content).
+      state: ExecTraceParser.save_state() at offset, with function addresses
+             relative to the flash base.
+      clock: SegmentClock state at offset, as (base, last).
+      sequence: Sequence number expected of the frame at offset, in framed
+                log files, so that entries lost before it are reported.
+      time: Time of the last timestamped entry before the checkpoint, or None
+            if there is none in the segment yet.
+      shown_uncertain: Whether the last event before offset had an uncertain
+                       depth. This can differ from the state after entries
+                       were lost, and decides whether trace_sinks.TextSink
+                       marks the next event.
+    """
+    __slots__ = ('offset', 'entry', 'skip', 'segment', 'tracker', 'state', 'clock', 'sequence', 'time',
+                 'shown_uncertain')
+
+def optional(value):
+    """Map None to -1 for packing."""
+    return -1 if value is None else value
+
+def unpack_optional(value):
+    """Map -1 to None after unpacking."""
+    return None if value == -1 else value
+
+class TraceIndex:
+    """Checkpoints and segments of one log file. See module comment."""
+    def __init__(self, log_format, interval=DEFAULT_INTERVAL):
+        self.log_format = log_format
+        self.interval = interval
+        # Size and modification time of the log file when it was indexed
+        self.size = 0
+        self.mtime_ns = 0
+        self.segments = []
+        self.checkpoints = []
+        # Entry numbers of the checkpoints, for bisection
+        self.entries = []
+        self.entries_total = 0
+
+    @classmethod
+    def build(cls, log_file_name, log_format, interval=DEFAULT_INTERVAL):
+        """Decode the whole log file and return its index."""
+        index = cls(log_format, interval)
+        stat = os.stat(log_file_name)
+        index.size = stat.st_size
+        index.mtime_ns = stat.st_mtime_ns
+
+        # Only the structure of the trace matters, not the names in it
+        parser = ExecTraceParser({}, {}, {})
+        pending_events = parser.pending_events
+        call_stack = parser.call_stack
+        frames = call_stack.frames
+        tracker = SegmentTracker()
+        clock = SegmentClock()
+        segment = Segment(0)
+        index.segments.append(segment)
+        entry = 0
+        resume = None
+        sequence = None
+        shown_uncertain = False
+        # Except in framed logs, decoding can resume at every entry, so the
+        # state is only saved for entries that may become checkpoints.
+        every_entry = log_format != 'framed'
+        with open(log_file_name, 'rb') as log_file:
+            reader = open_reader(log_file, log_format)
+            read_next = reader.read_next
+            while True:
+                offset = reader.tell()
+                if offset is not None and not every_entry:
+                    # Reading a frame moves the expected sequence number on
+                    sequence = reader.next_seq
+                value = read_next()
+                idcode = value >> 28
+                if offset is not None and (not every_entry or entry % interval == 0 or
+                                           idcode == 1 or idcode == 2 or idcode == 8):
+                    resume = (offset, entry, (tracker.segment, tracker.content), parser.save_state(),
+                              (clock.base, clock.last), sequence, shown_uncertain)
+
+                if idcode == 3 or idcode == 4:
+                    # As in ExecTraceParser.events(), for the bulk of the log
+                    if entry % interval == 0:
+                        index.add_checkpoint(resume, entry, tracker.segment, clock.time())
+                    func_addr = value & 0xFFFFFFE
+                    if idcode == 3:
+                        frames.append(func_addr)
+                    elif frames and frames[-1] == func_addr and not call_stack.uncertain:
+                        frames.pop()
+                    else:
+                        call_stack.exit(func_addr)
+                    shown_uncertain = call_stack.uncertain
+                    tracker.content = SegmentTracker.STARTED
+                    entry += 1
+                    segment.entries += 1
+                    continue
+
+                time = clock.time()
+                if not parser.decode_value(value, reader):
+                    break
+                new_segment = False
+                for event in pending_events:
+                    if tracker.add(event):
+                        new_segment = True
+                        clock.reset()
+                        segment = Segment(len(index.checkpoints))
+                        index.segments.append(segment)
+                    clock.add(event.timestamp)
+                if pending_events:
+                    shown_uncertain = pending_events[-1].uncertain
+                pending_events.clear()
+                if value == TraceReaderInterface.ENTRIES_LOST:
+                    continue
+
+                if new_segment or entry % interval == 0:
+                    index.add_checkpoint(resume, entry, tracker.segment, None if new_segment else time)
+                entry += 1
+                segment.entries += 1
+                if clock.last is not None:
+                    if segment.start_time is None:
+                        segment.start_time = clock.time()
+                    segment.end_time = clock.time()
+        index.entries_total = entry
+        return index
+
+    def add_checkpoint(self, resume, entry, segment, time):
+        """Add a checkpoint at entry, resuming from the state saved by
+        build()."""
+        checkpoint = Checkpoint()
+        (checkpoint.offset, resume_entry, checkpoint.tracker, checkpoint.state, checkpoint.clock,
+         checkpoint.sequence, checkpoint.shown_uncertain) = resume
+        checkpoint.entry = entry
+        checkpoint.skip = entry - resume_entry
+        checkpoint.segment = segment
+        checkpoint.time = time
+        self.checkpoints.append(checkpoint)
+        self.entries.append(entry)
+
+    def save(self, file_name):
+        """Write the index to a file.
+
+        The file is written under a temporary name and then renamed, so that a
+        concurrent or interrupted run never sees a partial index file.
+        """
+        data = [struct.pack(HEADER_FORMAT, INDEX_MAGIC, INDEX_VERSION, FORMATS.index(self.log_format),
+                            self.interval, self.size, self.mtime_ns, len(self.segments), len(self.checkpoints))]
+        for segment in self.segments:
+            data.append(struct.pack(SEGMENT_FORMAT, segment.first_checkpoint, segment.entries,
+                                    optional(segment.start_time), optional(segment.end_time)))
+        for checkpoint in self.checkpoints:
+            frames, uncertain, certain_depth, timestamp = checkpoint.state
+            data.append(struct.pack(CHECKPOINT_FORMAT, checkpoint.offset, checkpoint.entry, checkpoint.skip,
+                                    checkpoint.segment, checkpoint.tracker[0], checkpoint.tracker[1],
+                                    uncertain | (checkpoint.shown_uncertain << 1), certain_depth, len(frames),
+                                    checkpoint.clock[0],
+                                    optional(checkpoint.clock[1]), optional(checkpoint.sequence),
+                                    optional(checkpoint.time), optional(timestamp)))
+            data.append(struct.pack('<%uI' % len(frames), *frames))
+
+        fd, temp_name = tempfile.mkstemp(dir=os.path.dirname(os.path.abspath(file_name)), suffix='.tmp')
+        try:
+            with os.fdopen(fd, 'wb') as file:
+                file.write(b''.join(data))
+            os.replace(temp_name, file_name)
+        except BaseException:
+            os.unlink(temp_name)
+            raise
+
+    @classmethod
+    def load(cls, file_name):
+        """Return the index read from a file, or None if the file is missing
+        or is not a valid index file."""
+        try:
+            with open(file_name, 'rb') as file:
+                data = file.read()
+        except OSError:
+            return None
+
+        try:
+            (magic, version, log_format, interval, size, mtime_ns,
+             num_segments, num_checkpoints) = struct.unpack_from(HEADER_FORMAT, data)
+            if magic != INDEX_MAGIC or version != INDEX_VERSION or log_format >= len(FORMATS):
+                return None
+            index = cls(FORMATS[log_format], interval)
+            index.size = size
+            index.mtime_ns = mtime_ns
+            offset = struct.calcsize(HEADER_FORMAT)
+            for i in range(num_segments):
+                first_checkpoint, entries, start_time, end_time = struct.unpack_from(SEGMENT_FORMAT, data, offset)
+                offset += struct.calcsize(SEGMENT_FORMAT)
+                index.segments.append(Segment(first_checkpoint, entries, unpack_optional(start_time),
+                                              unpack_optional(end_time)))
+                index.entries_total += entries
+            for i in range(num_checkpoints):
+                (file_offset, entry, skip, segment, tracker_segment, content, flags, certain_depth, depth,
+                 clock_base, clock_last, sequence, time, timestamp) = struct.unpack_from(CHECKPOINT_FORMAT, data,
+                                                                                         offset)
+                offset += struct.calcsize(CHECKPOINT_FORMAT)
+                frames = struct.unpack_from('<%uI' % depth, data, offset)
+                offset += 4 * depth
+                checkpoint = Checkpoint()
+                checkpoint.offset = file_offset
+                checkpoint.entry = entry
+                checkpoint.skip = skip
+                checkpoint.segment = segment
+                checkpoint.tracker = (tracker_segment, content)
+                checkpoint.state = (frames, bool(flags & 1), certain_depth, unpack_optional(timestamp))
+                checkpoint.clock = (clock_base, unpack_optional(clock_last))
+                checkpoint.sequence = unpack_optional(sequence)
+                checkpoint.time = unpack_optional(time)
+                checkpoint.shown_uncertain = bool(flags & 2)
+                index.checkpoints.append(checkpoint)
+                index.entries.append(entry)
+        except struct.error:
+            return None
+        return index
+
+    def is_current(self, log_file_name):
+        """Return True if the index is of the log file as it is now."""
+        stat = os.stat(log_file_name)
+        return stat.st_size == self.size and stat.st_mtime_ns == self.mtime_ns
+
+    def resume(self, log_file, parser: ExecTraceParser, checkpoint: Checkpoint):
+        """Restore the parser's state at the offset of a checkpoint, and
+        return a reader for the log file from there."""
+        frames, uncertain, certain_depth, timestamp = checkpoint.state
+        parser.restore_state((tuple(address + parser.FLASH_BASE for address in frames), uncertain,
+                              certain_depth, timestamp))
+        return open_reader(log_file, self.log_format, checkpoint.offset, checkpoint.sequence)
+
+    def chunks(self, count):
+        """Split the log into up to count chunks of about the same number of
+        entries, to be decoded independently. Chunks start at checkpoints.
+
+        Returns:
+          List of (first, stop) tuples of checkpoint numbers. A chunk is
+          decoded from the offset of checkpoint first to that of checkpoint
+          stop, or to the end of the log file if stop is None. See
+          chunk_events().
+        """
+        if not self.checkpoints:
+            return []
+        starts = [0]
+        for i in range(1, count):
+            first = bisect.bisect_left(self.entries, self.entries_total * i // count)
+            if starts[-1] < first < len(self.checkpoints):
+                starts.append(first)
+        return list(zip(starts, starts[1:] + [None]))
+
+    def chunk_events(self, log_file, parser: ExecTraceParser, first, stop):
+        """Generator of the TraceEvent objects of a chunk returned by
+        chunks(). Decoding the chunks one after the other gives the same
+        events as decoding the whole log file.
+
+        Args:
+          log_file: The log file, opened in binary mode.
+          parser: ExecTraceParser to decode with. Its state is replaced.
+          first, stop: The chunk.
+        """
+        if stop is not None:
+            log_file = BoundedFile(log_file, self.checkpoints[stop].offset)
+        parser.pending_events.clear()
+        return parser.events(self.resume(log_file, parser, self.checkpoints[first]))
+
+    def events(self, log_file, parser: ExecTraceParser, segment=None, start=None, end=None, last=None,
+               entry=None):
+        """Generator of the TraceEvent objects of part of the log file.
+
+        Decoding starts at the checkpoint closest before the first event
+        selected.
+
+        Args:
+          log_file: The log file, opened in binary mode.
+          parser: ExecTraceParser to decode with, as for
+                  ExecTraceParser.events(). Its state is replaced.
+          segment: Number of the segment to decode, counted from 0. Negative
+                   numbers count from the last segment, as for a list. None
+                   for the whole log.
+          start: Time of the first event of the segment to return. Events
+                 are returned from the first timestamped one at or after
+                 start.
+          end: Time after which no more events of the segment are returned.
+          last: Return the events of the segment's last ticks rather than
+                from start.
+          entry: Number of the first entry to return events for.
+
+        Raises:
+          IndexError: segment is out of range.
+          ValueError: A time is given without a segment.
+        """
+        if segment is None:
+            if start is not None or end is not None or last is not None:
+                raise ValueError("Times are within a segment; Select one")
+            first, stop = 0, len(self.checkpoints)
+        else:
+            if segment < 0:
+                segment += len(self.segments)
+            if not 0 <= segment < len(self.segments):
+                raise IndexError("No segment %d; There are %u" % (segment, len(self.segments)))
+            first = self.segments[segment].first_checkpoint
+            if segment + 1 < len(self.segments):
+                stop = self.segments[segment + 1].first_checkpoint
+            else:
+                stop = len(self.checkpoints)
+            if last is not None and self.segments[segment].end_time is not None:
+                start = self.segments[segment].end_time - last
+
+        # The last checkpoint at or before where the selection starts
+        chosen = first
+        if entry is not None:
+            chosen = max(chosen, min(bisect.bisect_right(self.entries, entry, 0, stop), stop) - 1)
+        if start is not None:
+            for i in range(chosen + 1, stop):
+                time = self.checkpoints[i].time
+                if time is not None and time >= start:
+                    break
+                if time is not None:
+                    chosen = i
+        if chosen >= len(self.checkpoints):
+            return
+        checkpoint = self.checkpoints[chosen]
+
+        reader = self.resume(log_file, parser, checkpoint)
+        tracker = SegmentTracker(*checkpoint.tracker)
+        clock = SegmentClock(*checkpoint.clock)
+
+        # Catch up with the checkpoint, and then with the first entry
+        pending_events = parser.pending_events
+        pending_events.clear()
+        skip = checkpoint.skip
+        if entry is not None and entry > checkpoint.entry:
+            skip += entry - checkpoint.entry
+        while skip:
+            value = reader.read_next()
+            if not parser.decode_value(value, reader):
+                return
+            for event in pending_events:
+                if tracker.add(event):
+                    clock.reset()
+                clock.add(event.timestamp)
+            pending_events.clear()
+            if value != TraceReaderInterface.ENTRIES_LOST:
+                skip -= 1
+
+        started = start is None
+        for event in parser.events(reader):
+            if tracker.add(event):
+                clock.reset()
+            clock.add(event.timestamp)
+            if segment is not None:
+                if tracker.segment < segment:
+                    continue
+                if tracker.segment > segment:
+                    return
+            if event.timestamp is not None and event.timestamp != TraceEvent.UNKNOWN_TIMESTAMP:
+                time = clock.time()
+                if not started and time >= start:
+                    started = True
+                if end is not None and time > end:
+                    return
+            if started:
+                yield event
+
+def open_index(log_file_name, log_format, interval=DEFAULT_INTERVAL, index_file_name=None):
+    """Return the index of a log file, building it first if there is no
+    current one. An index that can't be written is not an error; it is
+    still returned.
+
+    Args:
+      log_file_name: Path to the log file.
+      log_format: One of FORMATS.
+      interval: Entries between checkpoints, for a new index.
+      index_file_name: Path to the index file, or None for the log file's
+                       path with an .idx suffix.
+    """
+    if index_file_name is None:
+        index_file_name = log_file_name + '.idx'
+    index = TraceIndex.load(index_file_name)
+    if index is not None and index.log_format == log_format and index.is_current(log_file_name):
+        return index
+
+    print(f"Indexing {log_file_name}", file=sys.stderr)
+    index = TraceIndex.build(log_file_name, log_format, interval)
+    try:
+        index.save(index_file_name)
+        print(f"Saved index to {index_file_name}", file=sys.stderr)
+    except OSError as e:
+        print(f"WARNING: Index not saved: {e}", file=sys.stderr)
+    return index
+
+def log_format_of(args):
+    """Return the log format selected by --binary, --compact and --framed."""
+    if args.framed:
+        return 'framed'
+    if args.binary:
+        return 'compact' if args.compact else 'binary'
+    return 'text'
+
+def main():
+    """Build (or check) the index of a log file and list its segments.
+
+    Decoding with the index is done by trace_from_file.py; Direct use is for
+    indexing ahead of time, and for finding the segment and times to decode.
+    """
+    parser = argparse.ArgumentParser(description='Execution trace log indexer')
+    parser.add_argument('--file', '-f', help='Log file', type=str, required=True)
+    parser.add_argument('--binary', '-b', help='Log file is in raw binary format', action='store_true')
+    parser.add_argument('--compact', '-c', help='Raw binary log file uses the compact encoding', action='store_true')
+    parser.add_argument('--framed', help='Log file is in framed format', action='store_true')
+    parser.add_argument('--index', help='Index file (default: the log file with an .idx suffix)', type=str,
+                        required=False)
+    parser.add_argument('--interval', help='Entries between checkpoints', type=int, default=DEFAULT_INTERVAL)
+    parser.add_argument('--rebuild', help='Build the index even if it is current', action='store_true')
+    args = parser.parse_args()
+
+    if not os.path.isfile(args.file):
+        raise InputError(f"File '{args.file}' not found")
+    if args.interval < 1:
+        raise InputError("The interval must be at least 1")
+    log_format = log_format_of(args)
+    if args.rebuild:
+        index = TraceIndex.build(args.file, log_format, args.interval)
+        index.save(args.index or args.file + '.idx')
+    else:
+        index = open_index(args.file, log_format, args.interval, args.index)
+
+    print("%u entries, %u checkpoints" % (index.entries_total, len(index.checkpoints)))
+    print("%7s %14s %12s %20s %20s" % ("segment", "first entry", "entries", "start time", "end time"))
+    for number, segment in enumerate(index.segments):
+        if segment.first_checkpoint < len(index.checkpoints):
+            first_entry = index.checkpoints[segment.first_checkpoint].entry
+        else:
+            first_entry = index.entries_total
+        print("%7u %14u %12u %20s %20s" % (number, first_entry, segment.entries,
+                                           '-' if segment.start_time is None else segment.start_time,
+                                           '-' if segment.end_time is None else segment.end_time))
+
+class InputError(RuntimeError):
+    """Boilerplate code for using this file directly from the command line."""
+    def __init__(self, e):
+        super(InputError, self).__init__(e)
+
+if __name__ == '__main__':
+    """Boilerplate code for using this file directly from the command line."""
+    try:
+        main()
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
@@ -0,0 +1,269 @@
+"""Profile functions from an execution trace log saved to a file.
+
+Reports, for every function in the trace, the number of calls and the
+inclusive and exclusive time spent in it, followed by its callers and
+callees. The inputs are the same as for trace_from_file.py.
+
+Time is measured with entry timestamps if the target was built with
+USE_TIMESTAMPS; Use --ticks_per_us to report microseconds rather than ticks.
+Without timestamps, the number of trace entries between a function's entry
+and exit stands in for time.
+
+The trace is read in a single pass. Memory use grows with the number of
+distinct functions and callers, not with the length of the trace.
+
+Limitations (and areas for future work):
+  - Functions that are not traced (or whose traces were overwritten) count
+    towards their caller's exclusive time.
+  - Calls are paired by depth as reconstructed by the parser (see
+    CallStack), so an exit that doesn't match the innermost call ends the
+    calls above the matching one. An exit that matches no call is ignored.
+    Calls around lost entries may still be paired wrongly.
+"""
+from symbol_cache import load_symbol_tables, default_cache_dir
+from exec_trace_parser import (ExecTraceParser, CompactTraceReader, FramedTraceReader, TraceEvent,
+                               EVENT_ENTER, EVENT_EXIT, EVENT_VERSION, EVENT_RESET)
+from trace_from_file import TextFileTraceReader, BinaryFileTraceReader, FLASH_BASE, RAM_BASE, SFR_BASE
+
+import argparse
+import sys
+
+class FunctionStats:
+    """Totals for one function, or for one caller and callee pair."""
+    __slots__ = ('name', 'calls', 'inclusive', 'exclusive', 'callers', 'callees')
+
+    def __init__(self, name):
+        self.name = name
+        self.calls = 0
+        self.inclusive = 0
+        self.exclusive = 0
+        # FunctionStats by address of the caller or callee
+        self.callers = {}
+        self.callees = {}
+
+class Profile:
+    """Aggregate function calls from a stream of TraceEvent objects.
+
+    Usage:
+      profile = Profile()
+      profile.add_all(parser.events(reader))
+      profile.finish()
+    """
+    def __init__(self, use_timestamps=True):
+        """Initializes the profile.
+
+        Args:
+          use_timestamps: Measure time with entry timestamps where there are
+                          any. Otherwise, each event counts as one unit.
+        """
+        self.use_timestamps = use_timestamps
+        # FunctionStats by function address
+        self.functions = {}
+        # Open calls as [address, start time, time spent in callees]
+        self.stack = []
+        # Number of open calls of each function, so that recursive calls
+        # don't count the same time twice
+        self.active = {}
+        self.time = 0
+        self.timestamped = False
+        self.last_timestamp = None
+        self.timestamp_base = 0
+        self.unmatched_exits = 0
+
+    def advance_time(self, event: TraceEvent):
+        timestamp = event.timestamp
+        if self.use_timestamps and timestamp is not None:
+            if timestamp != TraceEvent.UNKNOWN_TIMESTAMP:
+                # Timestamps are 32 bits and wrap around
+                if self.last_timestamp is not None and timestamp < self.last_timestamp:
+                    self.timestamp_base += 1 << 32
+                self.last_timestamp = timestamp
+                self.time = self.timestamp_base + timestamp
+                self.timestamped = True
+        elif not self.timestamped:
+            self.time += 1
+
+    def stats(self, address, name):
+        stats = self.functions.get(address)
+        if stats is None:
+            stats = FunctionStats(name if name is not None else "Function @ 0x%08X" % address)
+            self.functions[address] = stats
+        return stats
+
+    def pop(self):
+        """End the innermost open call at the current time."""
+        address, start, in_callees = self.stack.pop()
+        duration = self.time - start
+        stats = self.functions[address]
+        stats.exclusive += duration - in_callees
+        self.active[address] -= 1
+        if self.active[address] == 0:
+            stats.inclusive += duration
+        if self.stack:
+            caller = self.stack[-1]
+            caller[2] += duration
+            stats.callers[caller[0]].inclusive += duration
+            self.functions[caller[0]].callees[address].inclusive += duration
+
+    def pop_to(self, depth):
+        """End the open calls at depth and deeper."""
+        while len(self.stack) > depth:
+            self.pop()
+
+    def add(self, event: TraceEvent):
+        self.advance_time(event)
+        kind = event.kind
+        if kind == EVENT_ENTER:
+            self.pop_to(event.depth)
+            stats = self.stats(event.address, event.name)
+            stats.calls += 1
+            if self.stack:
+                caller_address = self.stack[-1][0]
+                caller = self.functions[caller_address]
+                edge = stats.callers.get(caller_address)
+                if edge is None:
+                    edge = stats.callers[caller_address] = FunctionStats(caller.name)
+                    caller.callees[event.address] = FunctionStats(stats.name)
+                edge.calls += 1
+                caller.callees[event.address].calls += 1
+            self.active[event.address] = self.active.get(event.address, 0) + 1
+            self.stack.append([event.address, self.time, 0])
+        elif kind == EVENT_EXIT:
+            self.pop_to(event.depth + 1)
+            if len(self.stack) > event.depth and self.stack[event.depth][0] == event.address:
+                self.pop()
+            else:
+                self.unmatched_exits += 1
+        elif kind == EVENT_VERSION or kind == EVENT_RESET:
+            # The target restarted; Calls still open will never exit
+            self.finish()
+
+    def add_all(self, events):
+        add = self.add
+        for event in events:
+            add(event)
+
+    def finish(self):
+        """End the calls still open at the time of the last event."""
+        self.pop_to(0)
+
+"""Keys for sorting the report."""
+SORT_KEYS = {
+    'calls': lambda stats: stats.calls,
+    'inclusive': lambda stats: stats.inclusive,
+    'exclusive': lambda stats: stats.exclusive,
+    'name': lambda stats: stats.name,
+}
+
+def print_report(profile: Profile, sort='exclusive', limit=None, call_graph=True, scale=1.0, unit='ticks',
+                 file=sys.stdout):
+    """Print the profile as a table of functions, most significant first,
+    optionally followed by each function's callers and callees.
+
+    Args:
+      profile: A finished Profile.
+      sort: One of SORT_KEYS. Names sort alphabetically, the others from
+            largest to smallest.
+      limit: Number of functions to report, or None for all.
+      call_graph: Also print callers and callees of each function.
+      scale: Divisor applied to times before printing.
+      unit: Name of the time unit after scaling.
+    """
+    key = SORT_KEYS[sort]
+    functions = sorted(profile.functions.values(), key=key, reverse=(sort != 'name'))
+    if limit is not None:
+        functions = functions[:limit]
+    total = sum(stats.exclusive for stats in profile.functions.values()) or 1
+
+    print("%10s %14s %14s %7s  %s" % ("calls", "inclusive", "exclusive", "excl %", "function"), file=file)
+    for stats in functions:
+        print("%10u %14.6g %14.6g %6.2f%%  %s" % (stats.calls, stats.inclusive / scale, stats.exclusive / scale,
+                                                 100.0 * stats.exclusive / total, stats.name), file=file)
+    print("Times in %s" % unit, file=file)
+    if profile.unmatched_exits:
+        print("%u exits without a matching entry were ignored" % profile.unmatched_exits, file=file)
+
+    if not call_graph:
+        return
+    for stats in functions:
+        print("\n%s" % stats.name, file=file)
+        for edge in sorted(stats.callers.values(), key=key, reverse=(sort != 'name')):
+            print("  <- %-40s %10u calls %14.6g" % (edge.name, edge.calls, edge.inclusive / scale), file=file)
+        for edge in sorted(stats.callees.values(), key=key, reverse=(sort != 'name')):
+            print("  -> %-40s %10u calls %14.6g" % (edge.name, edge.calls, edge.inclusive / scale), file=file)
+
+def main():
+    """Profile a log file saved from a back-end terminal and print the report
+    to stdout.
+
+    See module comment for usage.
+    """
+    parser = argparse.ArgumentParser(description='Execution trace profiler')
+    symbol_group = parser.add_mutually_exclusive_group(required=True)
+    symbol_group.add_argument('--map_file', '-m', help='GNU Map file', type=str)
+    symbol_group.add_argument('--elf_file', '-e', help='ELF file (instead of a map file)', type=str)
+    parser.add_argument('--file', '-f', help='Log file', type=str, required=True)
+    parser.add_argument('--binary', '-b', help='Log file is in raw binary format', action='store_true')
+    parser.add_argument('--compact', '-c', help='Raw binary log file uses the compact encoding', action='store_true')
+    parser.add_argument('--framed', help='Log file is in framed format', action='store_true')
+    parser.add_argument('--sort', '-s', help='Sort order of the report', choices=SORT_KEYS.keys(),
+                        default='exclusive')
+    parser.add_argument('--limit', '-n', help='Number of functions to report', type=int, required=False)
+    parser.add_argument('--no_call_graph', help='Leave out callers and callees', action='store_true')
+    parser.add_argument('--entries', help='Measure time in trace entries even if there are timestamps',
+                        action='store_true')
+    parser.add_argument('--ticks_per_us', help='Timestamp ticks per microsecond', type=float, required=False)
+    parser.add_argument('--svd_file', help='SVD file in XML foramt', type=str, required=False)
+    parser.add_argument('--make', help='Vendor (e.g. Atmel or STMicro)', type=str, required=False)
+    parser.add_argument('--model', help='Device name (e.g. ATSAMA5D33 or STM32L4x6)', type=str, required=False)
+    parser.add_argument('--cache_dir', help='Symbol cache directory', type=str, default=default_cache_dir())
+    parser.add_argument('--no_cache', help='Always parse the map and SVD files', action='store_true')
+    args = parser.parse_args()
+
+    symbol_file = args.map_file or args.elf_file
+    cache_dir = None if args.no_cache else args.cache_dir
+    functions, variables, registers = load_symbol_tables(symbol_file, args.svd_file, args.make, args.model,
+                                                         cache_dir)
+    if not functions:
+        print("WARNING: No functions found in %s" % symbol_file, file=sys.stderr)
+
+    tracer = ExecTraceParser(functions, variables, registers)
+    tracer.set_flash_base(FLASH_BASE)
+    tracer.set_ram_base(RAM_BASE)
+    tracer.set_sfr_base(SFR_BASE)
+    profile = Profile(use_timestamps=not args.entries)
+
+    if args.framed:
+        with open(args.file, 'rb') as log_file:
+            profile.add_all(tracer.events(FramedTraceReader(lambda: log_file.read(65536))))
+    elif args.binary:
+        with open(args.file, 'rb') as log_file:
+            reader = BinaryFileTraceReader(log_file, 2 if args.compact else 4)
+            if args.compact:
+                reader = CompactTraceReader(reader)
+            profile.add_all(tracer.events(reader))
+    else:
+        with open(args.file) as log_file:
+            profile.add_all(tracer.events(TextFileTraceReader(log_file)))
+    profile.finish()
+
+    if not profile.timestamped:
+        scale, unit = 1.0, 'trace entries'
+    elif args.ticks_per_us:
+        scale, unit = args.ticks_per_us, 'microseconds'
+    else:
+        scale, unit = 1.0, 'timestamp ticks'
+    print_report(profile, args.sort, args.limit, not args.no_call_graph, scale, unit)
+
+class InputError(RuntimeError):
+    """Boilerplate code for using this file directly from the command line."""
+    def __init__(self, e):
+        super(InputError, self).__init__(e)
+
+if __name__ == '__main__':
+    """Boilerplate code for using this file directly from the command line."""
+    try:
+        main()
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
@@ -0,0 +1,297 @@
+"""Output sinks for the events produced by ExecTraceParser.events().
+
+Each sink renders events in one format and writes them to a text stream in
+batches, so that output costs a few large writes rather than one per line.
+
+  - TextSink: Human readable text, as printed by the trace tools.
+  - CsvSink: One row per event with the columns in CSV_COLUMNS.
+  - JsonLinesSink: One JSON object per event, with only the fields that are
+    set.
+  - ChromeTraceSink: Chrome Trace Event JSON of function call spans, for a
+    flame chart viewer such as Perfetto (https://ui.perfetto.dev) or
+    chrome://tracing.
+
+Usage:
+  sink = CsvSink(open('trace.csv', 'w', newline=''))
+  sink.write_all(parser.events(reader))
+  sink.close()
+"""
+from exec_trace_parser import (TraceEvent, EVENT_VERSION, EVENT_RESET, EVENT_ENTER, EVENT_EXIT,
+                               EVENT_LINE, EVENT_VARIABLE, EVENT_SFR, EVENT_UNKNOWN,
+                               EVENT_BUFFER_FULL, EVENT_ENTRIES_LOST, EVENT_PRINTF)
+
+import csv
+import json
+
+class TraceSink:
+    """Base class of the sinks. Collects rendered lines and writes them to the
+    output stream once buffer_size lines are waiting."""
+    def __init__(self, out, buffer_size=4096):
+        """Initializes the sink.
+
+        Args:
+          out: Text stream to write to.
+          buffer_size: Number of events collected before writing. Use 1 for
+                       live traces, so that each event shows as it arrives.
+        """
+        self.out = out
+        self.buffer_size = buffer_size
+        self.lines = []
+
+    def render(self, event: TraceEvent) -> str:
+        """Return the text for one event, including its line ending."""
+        raise NotImplementedError
+
+    def write(self, event: TraceEvent):
+        lines = self.lines
+        lines.append(self.render(event))
+        if len(lines) >= self.buffer_size:
+            self.flush()
+
+    def write_all(self, events):
+        """Write every event from an iterable, such as
+        ExecTraceParser.events(). Same as calling write() for each."""
+        lines = self.lines
+        render = self.render
+        buffer_size = self.buffer_size
+        for event in events:
+            lines.append(render(event))
+            if len(lines) >= buffer_size:
+                self.flush()
+
+    def flush(self):
+        """Write out any events still collected."""
+        if self.lines:
+            self.out.write(''.join(self.lines))
+            self.lines.clear()
+        self.out.flush()
+
+    def close(self):
+        """Write out any events still collected, and anything the format
+        needs after the last event. The output stream is left open."""
+        self.flush()
+
+class TextSink(TraceSink):
+    """Render events as the human readable text of the trace tools. Lines are
+    indented by function call depth, and timestamped entries are prefixed
+    with their absolute timestamp. A marker line shows where the depth
+    becomes uncertain after lost entries, and where it is certain again."""
+    def __init__(self, out, buffer_size=4096):
+        super().__init__(out, buffer_size)
+        self.uncertain = False
+        self.formats = {
+            EVENT_VERSION: lambda event: "**** Tracer protocol version %s ****" % event.name,
+            EVENT_RESET: lambda event: "%sProcessor reset: 0x%02X" % ('  ' * event.depth, event.value),
+            EVENT_ENTER: lambda event: "%sEnter %s" % ('  ' * event.depth, event.name or
+                                                       "Function @ 0x%08X" % event.address),
+            EVENT_EXIT: lambda event: "%sExit %s" % ('  ' * event.depth, event.name or
+                                                     "Function @ 0x%08X" % event.address),
+            EVENT_LINE: lambda event: ("%s%s:%u" % ('  ' * event.depth, event.name, event.value) if event.name else
+                                       "%sModule: %u, Line: %u" % ('  ' * event.depth, event.module, event.value)),
+            EVENT_VARIABLE: lambda event: "%s%s = %d" % ('  ' * event.depth, event.name or
+                                                         "Variable @ 0x%08X" % event.address, event.value),
+            EVENT_SFR: lambda event: "%s%s = 0x%08X" % ('  ' * event.depth, event.name or
+                                                        "SFR @ 0x%08X" % event.address, event.value),
+            EVENT_UNKNOWN: lambda event: "%sUnknown extended record type %u (%u payload words)" %
+                                         ('  ' * event.depth, event.value, len(event.payload)),
+            EVENT_BUFFER_FULL: lambda event: "**** Trace buffer full - possible data loss ****",
+            EVENT_ENTRIES_LOST: lambda event: "**** %u trace entries lost ****" % event.value,
+            EVENT_PRINTF: lambda event: "%s%s" % ('  ' * event.depth, event.name),
+        }
+
+    def render(self, event: TraceEvent) -> str:
+        text = self.formats[event.kind](event)
+        if event.timestamp is None:
+            text += '\n'
+        elif event.timestamp == TraceEvent.UNKNOWN_TIMESTAMP:
+            text = "%10s %s\n" % ("?", text)
+        else:
+            text = "%10u %s\n" % (event.timestamp, text)
+        if event.uncertain != self.uncertain:
+            self.uncertain = event.uncertain
+            if event.uncertain:
+                return "**** Call depth uncertain ****\n" + text
+            return "**** Call depth resynchronized ****\n" + text
+        return text
+
+"""Columns written by CsvSink, in order."""
+CSV_COLUMNS = ('kind', 'timestamp', 'depth', 'uncertain', 'address', 'name', 'value', 'module')
+
+class LastWrite:
+    """File-like object that keeps only the last text written to it."""
+    def write(self, text):
+        self.text = text
+
+class CsvSink(TraceSink):
+    """Render events as CSV rows, after a header row. Addresses are written
+    in hex; Empty cells are fields that don't apply to the event, and the
+    uncertain column is 1 where the depth may be wrong. Open the output file
+    with newline='' as for the csv module."""
+    def __init__(self, out, buffer_size=4096):
+        super().__init__(out, buffer_size)
+        self.row = LastWrite()
+        self.row_writer = csv.writer(self.row)
+        self.row_writer.writerow(CSV_COLUMNS)
+        self.lines.append(self.row.text)
+
+    def render(self, event: TraceEvent) -> str:
+        timestamp = event.timestamp
+        if timestamp == TraceEvent.UNKNOWN_TIMESTAMP:
+            timestamp = '?'
+        address = event.address
+        self.row_writer.writerow((event.kind, timestamp, event.depth, 1 if event.uncertain else None,
+                                  None if address is None else '0x%08X' % address,
+                                  event.name, event.value, event.module))
+        return self.row.text
+
+class JsonLinesSink(TraceSink):
+    """Render events as JSON objects, one per line. Only fields that are set
+    are included; Unknown timestamps are written as null, and "uncertain" is
+    only written where the depth may be wrong.
+
+    Objects are formatted directly rather than with json.dumps(), which is
+    several times slower for such small objects.
+    """
+    def __init__(self, out, buffer_size=4096):
+        super().__init__(out, buffer_size)
+        self.encode_string = json.encoder.encode_basestring_ascii
+
+    def render(self, event: TraceEvent) -> str:
+        text = '{"kind":"%s","depth":%d' % (event.kind, event.depth)
+        if event.address is not None:
+            text += ',"address":%d' % event.address
+        if event.name is not None:
+            text += ',"name":' + self.encode_string(event.name)
+        if event.value is not None:
+            text += ',"value":%d' % event.value
+        if event.module is not None:
+            text += ',"module":%d' % event.module
+        if event.payload is not None:
+            text += ',"payload":[%s]' % ','.join(map(str, event.payload))
+        if event.timestamp is not None:
+            if event.timestamp == TraceEvent.UNKNOWN_TIMESTAMP:
+                text += ',"timestamp":null'
+            else:
+                text += ',"timestamp":%d' % event.timestamp
+        if event.uncertain:
+            text += ',"uncertain":true'
+        return text + '}\n'
+
+class ChromeTraceSink(TraceSink):
+    """Render function entry and exit as Chrome Trace Event spans.
+
+    Each function call becomes one complete ("X") event, written when the
+    function exits, so memory is bounded by the call depth and not by the
+    length of the trace. Variable and register values become counter ("C")
+    tracks named after the variable or register. Everything else (lines,
+    resets, buffer full, lost entries) becomes an instant ("i") event.
+
+    Calls are paired by the depth of the events, as reconstructed by the
+    parser's CallStack: An entry at a depth ends any calls still open at that
+    depth or deeper, and an exit ends the calls above its depth, along with
+    the call at its depth if it is of the same function. Otherwise the exit
+    is shown as an instant event. Calls still open at the end of the trace
+    end at the last event's time.
+
+    Time is in microseconds. With ticks_per_us, it is taken from the entries'
+    timestamps, and entries without one get the time of the entry before.
+    Otherwise every event counts as one microsecond.
+    """
+    def __init__(self, out, buffer_size=4096, ticks_per_us=None):
+        super().__init__(out, buffer_size)
+        self.ticks_per_us = ticks_per_us
+        self.encode_string = json.encoder.encode_basestring_ascii
+        # Open calls as (address, name, start time)
+        self.stack = []
+        self.time = 0
+        self.last_timestamp = None
+        self.timestamp_base = 0
+        self.lines.append('{"displayTimeUnit":"ns","traceEvents":[\n')
+        self.first = True
+        self.closed = False
+        # Renders the text of instant events
+        self.text = TextSink(None)
+
+    def advance_time(self, event: TraceEvent):
+        """Set self.time to the time of event, in microseconds."""
+        if self.ticks_per_us is None:
+            self.time += 1
+            return
+        timestamp = event.timestamp
+        if timestamp is None or timestamp == TraceEvent.UNKNOWN_TIMESTAMP:
+            return
+        # Timestamps are 32 bits and wrap around
+        if self.last_timestamp is not None and timestamp < self.last_timestamp:
+            self.timestamp_base += 1 << 32
+        self.last_timestamp = timestamp
+        self.time = (self.timestamp_base + timestamp) / self.ticks_per_us
+
+    def label(self, event: TraceEvent):
+        if event.name is not None:
+            return event.name
+        return "0x%08X" % event.address
+
+    def add(self, text):
+        """Add one JSON object to the traceEvents array."""
+        if self.first:
+            self.first = False
+            self.lines.append(text)
+        else:
+            self.lines.append(',\n' + text)
+        if len(self.lines) >= self.buffer_size:
+            super().flush()
+
+    def span(self, name, start, end):
+        return '{"name":%s,"ph":"X","ts":%s,"dur":%s,"pid":1,"tid":1}' % (
+                self.encode_string(name), start, end - start)
+
+    def instant(self, name, args=''):
+        return '{"name":%s,"ph":"i","s":"t","ts":%s,"pid":1,"tid":1%s}' % (
+                self.encode_string(name), self.time, args)
+
+    def end_calls(self, depth):
+        """End the open calls at depth and deeper."""
+        stack = self.stack
+        while len(stack) > depth:
+            address, name, start = stack.pop()
+            self.add(self.span(name, start, self.time))
+
+    def write(self, event: TraceEvent):
+        self.advance_time(event)
+        kind = event.kind
+        if kind == EVENT_ENTER:
+            self.end_calls(event.depth)
+            self.stack.append((event.address, self.label(event), self.time))
+        elif kind == EVENT_EXIT:
+            self.end_calls(event.depth + 1)
+            if len(self.stack) > event.depth and self.stack[event.depth][0] == event.address:
+                self.end_calls(event.depth)
+            else:
+                self.add(self.instant("Exit " + self.label(event)))
+        elif kind == EVENT_VARIABLE or kind == EVENT_SFR:
+            name = self.label(event)
+            self.add('{"name":%s,"ph":"C","ts":%s,"pid":1,"args":{"value":%d}}' % (
+                    self.encode_string(name), self.time, event.value))
+        else:
+            self.add(self.instant(self.text.formats[kind](event).strip()))
+
+    def write_all(self, events):
+        for event in events:
+            self.write(event)
+
+    def close(self):
+        """End the calls still open and complete the JSON document."""
+        if self.closed:
+            return
+        self.closed = True
+        self.end_calls(0)
+        self.lines.append('\n]}\n')
+        super().flush()
+
+"""Sink classes by format name, for command line options."""
+SINKS = {
+    'text': TextSink,
+    'csv': CsvSink,
+    'jsonl': JsonLinesSink,
+    'chrome': ChromeTraceSink,
+}